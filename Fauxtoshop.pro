@@ -10,6 +10,11 @@
 # - re-open and "Configure" your project again.
 #
 # @author Marty Stepp, Reid Watson, Rasmus Rygaard, Jess Fisher, etc.
+# @version 2026/10/17
+# - added the filter benchmark: "qmake CONFIG+=benchmark", or "make benchmark"
+# - release builds define SPL_UNCHECKED_GRID to skip Grid index checks
+# @version 2026/10/16
+# - link pthread on Mac/Linux for the library's back-end pipe flusher thread
 # @version 2015/04/09
 # - decreased Mac stack size to avoid sporatic crashes on Mac systems
 # @version 2014/11/29
@@ -78,6 +83,21 @@ exists($$PWD/*.h) {
     HEADERS += $$PWD/*.h
 }
 
+# "qmake CONFIG+=benchmark" builds the filter benchmark in bench/ instead of
+# the app.  The benchmark defines a plain main(argc, argv) and runs without
+# the Java back-end, so the library's main.cpp is left out along with the
+# app's main program.  bench/base64bench.cpp is a separate program with its
+# own main (see the build line in that file) and is not part of it.
+CONFIG(benchmark) {
+    TARGET = FauxtoshopBenchmark
+    SOURCES = $$files($$PWD/lib/StanfordCPPLib/*.cpp)
+    SOURCES -= $$PWD/lib/StanfordCPPLib/main.cpp
+    SOURCES += $$PWD/lib/StanfordCPPLib/stacktrace/*.cpp
+    SOURCES += $$files($$PWD/src/*.cpp)
+    SOURCES -= $$PWD/src/fauxtoshop.cpp
+    SOURCES += $$PWD/bench/benchmark.cpp
+}
+
 # set up flags for the C++ compiler
 # (In general, many warnings/errors are enabled to tighten compile-time checking.
 # A few overly pedantic/confusing errors are turned off for simplicity.)
@@ -101,6 +121,7 @@ unix:!macx {
     QMAKE_CXXFLAGS += -Wno-dangling-field
     QMAKE_CXXFLAGS += -Wno-unused-const-variable
     LIBS += -ldl
+    LIBS += -lpthread
 }
 
 # increase system stack size (helpful for recursive programs)
@@ -141,6 +162,10 @@ CONFIG(release, debug|release) {
     # make 'release' target be statically linked so it is a stand-alone executable
     # (this code comes from Rasmus Rygaard)
     QMAKE_CXXFLAGS += -O2
+
+    # grid[r][c] skips its range checks in release builds (see grid.h);
+    # debug builds keep them so that out-of-bounds bugs are still reported
+    DEFINES += SPL_UNCHECKED_GRID
     macx {
         QMAKE_POST_LINK += 'macdeployqt $${OUT_PWD}/$${TARGET}.app && rm $${OUT_PWD}/*.o && rm $${OUT_PWD}/Makefile'
     }
@@ -239,6 +264,20 @@ exists($$PWD/*.txt) {
 QMAKE_EXTRA_TARGETS += copyResources
 POST_TARGETDEPS += copyResources
 
+# "make benchmark" builds a release copy of the filter benchmark into the
+# benchmark/ folder next to the app; run it in that folder, which also gets
+# copies of the images in res/
+!CONFIG(benchmark) {
+    BENCHMARK_BUILD = $$QMAKE_QMAKE $$PWD/Fauxtoshop.pro CONFIG+=benchmark CONFIG+=release && $(MAKE)
+    !win32 {
+        benchmark.commands = mkdir -p benchmark && cd benchmark && $$BENCHMARK_BUILD
+    }
+    win32 {
+        benchmark.commands = (if not exist benchmark mkdir benchmark) && cd benchmark && $$BENCHMARK_BUILD
+    }
+    QMAKE_EXTRA_TARGETS += benchmark
+}
+
 # Platform-specific project settings to reduce warnings on Mac OS X systems
 macx {
     cache()
@@ -0,0 +1,136 @@
+/*
+ * File: base64bench.cpp
+ * ---------------------
+ * A microbenchmark for the base64 encoder and decoder in base64.h.
+ * It times the original C functions (Base64encode/Base64decode) and each
+ * buffer-based implementation this machine supports, and prints the
+ * throughput of each in GB/s of unencoded data.  It also times packing
+ * 0xRRGGBB pixels into RGB bytes and encoding them, both the old way
+ * (through a stream and a string) and with Base64::encodeRGB.
+ *
+ * This program has its own main function and does not use the graphics
+ * library, so it is built separately from the Fauxtoshop project:
+ *
+ *   g++ -std=c++11 -O2 -Ilib/StanfordCPPLib bench/base64bench.cpp \
+ *       lib/StanfordCPPLib/base64.cpp -o base64bench
+ *   ./base64bench [megabytes]
+ *
+ * @since 2026/10/17
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "base64.h"
+
+using namespace std;
+
+static const int DEFAULT_MEGABYTES = 16;
+static const double MIN_SECONDS = 0.5;
+
+/*
+ * Calls the given function repeatedly for at least MIN_SECONDS and returns
+ * the throughput in GB/s for the given number of bytes per call.
+ */
+template <typename Function>
+static double measure(Function fn, int bytes) {
+    fn();   // warm up caches and the implementation choice
+    int calls = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        calls++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < MIN_SECONDS);
+    return (double) bytes * calls / elapsed / 1e9;
+}
+
+static void printRow(const string& name, double encodeRate, double decodeRate) {
+    cout << left << setw(10) << name << right << fixed << setprecision(2)
+         << setw(12) << encodeRate << setw(12) << decodeRate << endl;
+}
+
+int main(int argc, char** argv) {
+    int megabytes = (argc > 1) ? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    if (megabytes <= 0) {
+        megabytes = DEFAULT_MEGABYTES;
+    }
+    int length = megabytes * 1024 * 1024;
+
+    vector<char> plain(length);
+    srand(106);
+    for (int i = 0; i < length; i++) {
+        plain[i] = (char) rand();
+    }
+    vector<char> encoded(Base64encode_len(length));
+    Base64encode(&encoded[0], &plain[0], length);
+    int encodedLength = Base64::encodedLength(length);
+    vector<char> decoded(Base64decode_len(&encoded[0]));
+
+    cout << "base64 throughput on " << megabytes << " MB (GB/s of decoded data)" << endl;
+    cout << left << setw(10) << "impl" << right << setw(12) << "encode" << setw(12) << "decode" << endl;
+
+    double encodeRate = measure([&]() {
+        Base64encode(&encoded[0], &plain[0], length);
+    }, length);
+    double decodeRate = measure([&]() {
+        Base64decode(&decoded[0], &encoded[0]);
+    }, length);
+    printRow("legacy", encodeRate, decodeRate);
+
+    const char* implementations[] = {"scalar", "sse4.1", "avx2"};
+    for (const char* name : implementations) {
+        if (!Base64::setImplementation(name)) {
+            cout << left << setw(10) << name << "  (not supported on this CPU)" << endl;
+            continue;
+        }
+        encodeRate = measure([&]() {
+            Base64::encode(&plain[0], length, &encoded[0]);
+        }, length);
+        decodeRate = measure([&]() {
+            Base64::decode(&encoded[0], encodedLength, &decoded[0]);
+        }, length);
+        if (memcmp(&decoded[0], &plain[0], length) != 0) {
+            cerr << name << ": decoded data does not match the input" << endl;
+            return 1;
+        }
+        printRow(name, encodeRate, decodeRate);
+    }
+
+    // pixels as GBufferedImage sends them: 3 bytes each, after a 4-byte header
+    int count = length / 3;
+    vector<int> pixels(count);
+    for (int i = 0; i < count; i++) {
+        pixels[i] = rand() & 0xffffff;
+    }
+    const char header[4] = {0, 0, 0, 0};
+    cout << endl << "pixel packing and encoding (GB/s of RGB bytes)" << endl;
+    double rate = measure([&]() {
+        ostringstream out;
+        out.write(header, 4);
+        for (int i = 0; i < count; i++) {
+            out << (char) ((pixels[i] >> 16) & 0xff);
+            out << (char) ((pixels[i] >> 8) & 0xff);
+            out << (char) (pixels[i] & 0xff);
+        }
+        string encodedPixels = Base64::encode(out.str());
+    }, 3 * count);
+    cout << left << setw(10) << "stream" << right << setw(12) << rate << endl;
+    vector<char> encodedPixels(Base64::encodedLength(4 + 3 * count));
+    for (const char* name : implementations) {
+        if (!Base64::setImplementation(name)) {
+            continue;
+        }
+        rate = measure([&]() {
+            Base64::encodeRGB(header, 4, &pixels[0], count, &encodedPixels[0]);
+        }, 3 * count);
+        cout << left << setw(10) << name << right << setw(12) << rate << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * File: benchmark.cpp
+ * -------------------
+ * Measures the speed of Fauxtoshop's filters, for tracking performance
+ * from one release to the next.  Built by "qmake CONFIG+=benchmark" (see
+ * Fauxtoshop.pro), it runs without the Java back-end:
+ *
+ *     FauxtoshopBenchmark [--reps N] [--threads N] [--images DIR]
+ *                         [--synthetic 1,12,48] [--only FILTER]
+ *
+ * Each filter runs at several settings over every image in DIR ("res" if
+ * that folder exists, otherwise the current folder) and over synthetic
+ * images of the given numbers of megapixels.  Green screen places each
+ * image in DIR whose name contains "-green" over every background.  The
+ * filters are timed through the kernels in filters.h that the interactive
+ * doScatter, doEdgeDetection, doGreenScreen, and doBlur call, and
+ * imagecompare::compare, which GBufferedImage::countDiffPixels uses.
+ *
+ * Each measurement is run once to warm up and then N times (5 by default).
+ * The results are written to standard output as one JSON object, whose
+ * "results" array has an entry per filter, setting, and image:
+ *
+ *     filter, setting, image, width, height, reps,
+ *     mean_ms, min_ms, max_ms, stddev_ms, variance_ms2,
+ *     megapixels_per_s        (from the mean time),
+ *     allocations, allocated_bytes   (per repetition)
+ *
+ * Progress is reported on standard error.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "filelib.h"
+#include "filters.h"
+#include "grid.h"
+#include "imagecodec.h"
+#include "imagecompare.h"
+#include "parallel.h"
+#include "strlib.h"
+
+using namespace std;
+
+/*
+ * Every allocation in the program goes through these, so that a
+ * measurement can report how many allocations its filter made.
+ */
+static atomic<long long> allocationCount(0);
+static atomic<long long> allocatedBytes(0);
+
+void* operator new(size_t size) {
+    allocationCount++;
+    allocatedBytes += size;
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (memory == NULL) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+// kept out of line so that GCC does not take the free for a mismatched delete
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+// the settings given on the command line
+struct BenchmarkSettings {
+    int reps;
+    string imageDir;
+    vector<int> syntheticMegapixels;
+    string only;
+};
+
+// an image to run the filters over
+struct BenchmarkImage {
+    string name;
+    Grid<int> pixels;
+};
+
+// the measurements of one filter at one setting on one image
+struct BenchmarkResult {
+    string filter;
+    string setting;
+    string image;
+    int width;
+    int height;
+    vector<double> times;   // milliseconds, one per repetition
+    long long allocations;
+    long long bytes;
+};
+
+static const unsigned long long SCATTER_SEED = 106;
+
+static void printUsage() {
+    cerr << "Usage: FauxtoshopBenchmark [--reps N] [--threads N] [--images DIR]"
+         << " [--synthetic 1,12,48] [--only FILTER]" << endl;
+}
+
+/*
+ * Reads the command-line arguments into settings.  Returns false, after
+ * saying what is wrong, if they are not valid.
+ */
+static bool parseArgs(int argc, char** argv, BenchmarkSettings& settings) {
+    settings.reps = 5;
+    settings.imageDir = isDirectory("res") ? "res" : ".";
+    settings.syntheticMegapixels = { 1, 12, 48 };
+    for (int i = 1; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 == argc) {
+            cerr << "Option " << option << " needs a value." << endl;
+            return false;
+        }
+        string value = argv[i + 1];
+        if (option == "--reps" || option == "--threads") {
+            if (!stringIsInteger(value) || stringToInteger(value) < 1) {
+                cerr << "The value of " << option << " must be a positive integer." << endl;
+                return false;
+            }
+            if (option == "--reps") {
+                settings.reps = stringToInteger(value);
+            } else {
+                parallel::setThreadCount(stringToInteger(value));
+            }
+        } else if (option == "--images") {
+            settings.imageDir = value;
+        } else if (option == "--synthetic") {
+            settings.syntheticMegapixels.clear();
+            for (const string& size : stringSplit(value, ",")) {
+                if (!stringIsInteger(size) || stringToInteger(size) < 1) {
+                    cerr << "Synthetic image sizes must be positive numbers of megapixels." << endl;
+                    return false;
+                }
+                settings.syntheticMegapixels.push_back(stringToInteger(size));
+            }
+        } else if (option == "--only") {
+            settings.only = value;
+        } else {
+            cerr << "Unknown option " << option << "." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Returns an image of about the given number of megapixels, 4:3, made of
+ * smooth gradients with some per-pixel noise, so that edge detection finds
+ * a realistic mix of edges and flat areas.  The same size always gives
+ * the same image.
+ */
+static Grid<int> makeSyntheticImage(int megapixels) {
+    int rows = (int) sqrt(megapixels * 1e6 * 3 / 4);
+    int cols = rows * 4 / 3;
+    Grid<int> image(rows, cols);
+    parallel::forEachRange(0, rows, 64, [&](int start, int end) {
+        for (int r = start; r < end; r++) {
+            int* row = image.rowPtr(r);
+            for (int c = 0; c < cols; c++) {
+                unsigned int noise = (unsigned int) (r * 2654435761u ^ c * 2246822519u);
+                noise = (noise ^ (noise >> 15)) * 2246822519u;
+                int red = (c * 255 / cols + (noise & 15)) & 0xFF;
+                int green = (r * 255 / rows + ((noise >> 8) & 15)) & 0xFF;
+                int blue = ((r + c) / 8 + ((noise >> 16) & 7)) & 0xFF;
+                row[c] = (red << 16) | (green << 8) | blue;
+            }
+        }
+    });
+    return image;
+}
+
+/* Returns the images in dir that the native decoder can read, by name. */
+static vector<BenchmarkImage> loadImages(const string& dir) {
+    vector<BenchmarkImage> images;
+    for (const string& name : listDirectory(dir)) {
+        BenchmarkImage image;
+        image.name = name;
+        if (isFile(dir + "/" + name) && imagecodec::decodeFile(dir + "/" + name, image.pixels)) {
+            images.push_back(image);
+        }
+    }
+    return images;
+}
+
+/*
+ * Runs filter once to warm up and then reps more times, timing each
+ * repetition and counting the allocations made.
+ */
+static BenchmarkResult measure(const string& filter, const string& setting,
+                               const BenchmarkImage& image, int reps,
+                               const function<void()>& run) {
+    BenchmarkResult result;
+    result.filter = filter;
+    result.setting = setting;
+    result.image = image.name;
+    result.width = image.pixels.numCols();
+    result.height = image.pixels.numRows();
+    result.times.reserve(reps);
+    run();
+    long long allocationsBefore = allocationCount;
+    long long bytesBefore = allocatedBytes;
+    for (int rep = 0; rep < reps; rep++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        run();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        result.times.push_back(elapsed.count());
+    }
+    result.allocations = (allocationCount - allocationsBefore) / reps;
+    result.bytes = (allocatedBytes - bytesBefore) / reps;
+    return result;
+}
+
+/* Returns str as a JSON string literal. */
+static string jsonString(const string& str) {
+    ostringstream out;
+    out << '"';
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\') {
+            out << '\\' << ch;
+        } else if ((unsigned char) ch < 0x20) {
+            out << "\\u00" << "0123456789abcdef"[(ch >> 4) & 0xF] << "0123456789abcdef"[ch & 0xF];
+        } else {
+            out << ch;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+static void writeResult(ostream& out, const BenchmarkResult& result) {
+    double sum = 0;
+    double minTime = result.times[0];
+    double maxTime = result.times[0];
+    for (double time : result.times) {
+        sum += time;
+        minTime = min(minTime, time);
+        maxTime = max(maxTime, time);
+    }
+    double mean = sum / result.times.size();
+    double variance = 0;
+    for (double time : result.times) {
+        variance += (time - mean) * (time - mean);
+    }
+    variance = result.times.size() > 1 ? variance / (result.times.size() - 1) : 0;
+    double megapixels = (double) result.width * result.height / 1e6;
+
+    out << "    {\"filter\": " << jsonString(result.filter)
+        << ", \"setting\": " << jsonString(result.setting)
+        << ", \"image\": " << jsonString(result.image)
+        << ", \"width\": " << result.width
+        << ", \"height\": " << result.height
+        << ", \"reps\": " << result.times.size()
+        << ", \"mean_ms\": " << mean
+        << ", \"min_ms\": " << minTime
+        << ", \"max_ms\": " << maxTime
+        << ", \"stddev_ms\": " << sqrt(variance)
+        << ", \"variance_ms2\": " << variance
+        << ", \"megapixels_per_s\": " << (mean > 0 ? megapixels * 1000 / mean : 0)
+        << ", \"allocations\": " << result.allocations
+        << ", \"allocated_bytes\": " << result.bytes << "}";
+}
+
+/*
+ * Runs every filter that settings.only selects over each image, and
+ * returns the measurements.
+ */
+static vector<BenchmarkResult> runFilters(const vector<BenchmarkImage>& images,
+                                          const vector<BenchmarkImage>& stickers,
+                                          const BenchmarkSettings& settings) {
+    vector<BenchmarkResult> results;
+    auto wanted = [&](const string& filter) {
+        return settings.only.empty() || settings.only == filter;
+    };
+    auto add = [&](const BenchmarkResult& result) {
+        results.push_back(result);
+        cerr << result.filter << " " << result.setting << " on " << result.image
+             << ": " << result.times.size() << " reps" << endl;
+    };
+    for (const BenchmarkImage& image : images) {
+        const Grid<int>& pixels = image.pixels;
+        if (wanted("scatter")) {
+            for (int radius : { 1, 5, 20, 100 }) {
+                add(measure("scatter", "radius=" + integerToString(radius), image, settings.reps,
+                            [&]() { scatterImage(pixels, radius, SCATTER_SEED); }));
+            }
+        }
+        if (wanted("edge")) {
+            for (int threshold : { 0, 10, 50, 150 }) {
+                add(measure("edge", "threshold=" + integerToString(threshold), image, settings.reps,
+                            [&]() { edgeDetectImage(pixels, threshold); }));
+            }
+        }
+        if (wanted("greenscreen")) {
+            for (const BenchmarkImage& sticker : stickers) {
+                for (int threshold : { 30, 100 }) {
+                    int row = pixels.numRows() / 4;
+                    int col = pixels.numCols() / 4;
+                    string setting = "sticker=" + sticker.name + " threshold=" + integerToString(threshold);
+                    add(measure("greenscreen", setting, image, settings.reps, [&]() {
+                        greenScreenImage(pixels, sticker.pixels, threshold, row, col);
+                    }));
+                }
+            }
+        }
+        if (wanted("blur")) {
+            for (int radius : { 2, 10, 50 }) {
+                Vector<double> kernel = gaussKernelForRadius(radius);
+                add(measure("blur", "radius=" + integerToString(radius), image, settings.reps,
+                            [&]() { blurImage(pixels, kernel); }));
+            }
+        }
+        if (wanted("compare")) {
+            // every 101st pixel is off by 8 in each channel
+            Grid<int> changed = pixels;
+            for (int i = 0; i < changed.numRows() * changed.numCols(); i += 101) {
+                int& pixel = changed.data()[i];
+                pixel = pixel ^ 0x080808;
+            }
+            for (int tolerance : { 0, 16 }) {
+                imagecompare::Options options;
+                options.tolerance = tolerance;
+                add(measure("compare", "tolerance=" + integerToString(tolerance), image, settings.reps,
+                            [&]() { imagecompare::compare(pixels, changed, options); }));
+            }
+        }
+    }
+    return results;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkSettings settings;
+    if (!parseArgs(argc, argv, settings)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    vector<BenchmarkImage> images = loadImages(settings.imageDir);
+    vector<BenchmarkImage> stickers;
+    for (const BenchmarkImage& image : images) {
+        if (image.name.find("-green") != string::npos) {
+            stickers.push_back(image);
+        }
+    }
+    for (int megapixels : settings.syntheticMegapixels) {
+        BenchmarkImage image;
+        image.name = "synthetic-" + integerToString(megapixels) + "MP";
+        image.pixels = makeSyntheticImage(megapixels);
+        images.push_back(image);
+    }
+    cerr << "Benchmarking " << images.size() << " images with " << parallel::getThreadCount()
+         << " threads." << endl;
+
+    vector<BenchmarkResult> results = runFilters(images, stickers, settings);
+    cout << "{\n  \"threads\": " << parallel::getThreadCount()
+         << ",\n  \"reps\": " << settings.reps
+         << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        writeResult(cout, results[i]);
+        cout << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    cout << "  ]\n}" << endl;
+    return 0;
+}
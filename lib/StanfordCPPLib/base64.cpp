@@ -6,6 +6,11 @@
  * http://en.wikipedia.org/wiki/Base64
  *
  * @author Marty Stepp, based upon open-source Apache Base64 en/decoder
+ * @version 2026/10/17
+ * - added buffer-based encode/decode with SSE4.1/AVX2 versions selected at
+ *   runtime; the string functions now use them and no longer copy through
+ *   temporary C buffers and streams
+ * - added encodeRGB to encode packed pixels without an intermediate buffer
  * @version 2014/10/08
  * - removed 'using namespace' statement
  * 2014/08/14
@@ -14,9 +19,16 @@
  */
 
 #include "base64.h"
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 
+// the vectorized versions use GCC/Clang target attributes and CPU detection
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SPL_BASE64_X86
+#  include <immintrin.h>
+#endif
+
 /* aaaack but it's fast and const should make it shared text page. */
 static const unsigned char pr2six[256] = {
     /* ASCII table */
@@ -135,40 +147,440 @@ int Base64encode(char *encoded, const char *string, int len) {
 }
 
 namespace Base64 {
+/*
+ * Portable implementations; also used for the tails left over by the
+ * vectorized versions below.
+ */
+static int encodeScalar(const char* src, int length, char* dst) {
+    const unsigned char* in = (const unsigned char*) src;
+    char* out = dst;
+    int i = 0;
+    for (; i + 2 < length; i += 3) {
+        unsigned int triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *out++ = basis_64[triple >> 18];
+        *out++ = basis_64[(triple >> 12) & 0x3F];
+        *out++ = basis_64[(triple >> 6) & 0x3F];
+        *out++ = basis_64[triple & 0x3F];
+    }
+    if (i < length) {
+        unsigned int triple = in[i] << 16;
+        if (i + 1 < length) {
+            triple |= in[i + 1] << 8;
+        }
+        *out++ = basis_64[triple >> 18];
+        *out++ = basis_64[(triple >> 12) & 0x3F];
+        *out++ = (i + 1 < length) ? basis_64[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+    return out - dst;
+}
+
+static int decodeScalar(const char* src, int length, char* dst) {
+    const unsigned char* in = (const unsigned char*) src;
+    unsigned char* out = (unsigned char*) dst;
+    int n = 0;
+    while (n < length && pr2six[in[n]] <= 63) {
+        n++;
+    }
+
+    int i = 0;
+    for (; i + 3 < n; i += 4) {
+        unsigned int quad = (pr2six[in[i]] << 18) | (pr2six[in[i + 1]] << 12)
+                | (pr2six[in[i + 2]] << 6) | pr2six[in[i + 3]];
+        *out++ = (unsigned char) (quad >> 16);
+        *out++ = (unsigned char) (quad >> 8);
+        *out++ = (unsigned char) quad;
+    }
+
+    // a leftover single character carries fewer than 8 bits; ignore it
+    int remaining = n - i;
+    if (remaining >= 2) {
+        *out++ = (unsigned char) (pr2six[in[i]] << 2 | pr2six[in[i + 1]] >> 4);
+    }
+    if (remaining >= 3) {
+        *out++ = (unsigned char) (pr2six[in[i + 1]] << 4 | pr2six[in[i + 2]] >> 2);
+    }
+    return out - (unsigned char*) dst;
+}
+
+#ifdef SPL_BASE64_X86
+/*
+ * Vectorized versions, after the techniques described by Wojciech Mula and
+ * Daniel Lemire in "Faster Base64 Encoding and Decoding Using AVX2
+ * Instructions" (2018).  Each loop handles as many whole blocks as it can
+ * without reading or writing out of bounds and leaves the rest to the
+ * scalar code.
+ */
+
+/*
+ * Spreads each group of 3 bytes in a 16-byte lane into 4 bytes that each
+ * hold one 6-bit index, given the lane's input already shuffled into place.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i encodeIndexes128(__m128i in) {
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+// maps 6-bit indexes to their ASCII characters
+__attribute__((target("ssse3")))
+static inline __m128i encodeTranslate128(__m128i indexes) {
+    const __m128i shiftLut = _mm_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0);
+    __m128i reduced = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indexes);
+    reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+    return _mm_add_epi8(indexes, _mm_shuffle_epi8(shiftLut, reduced));
+}
+
+__attribute__((target("ssse3,sse4.1")))
+static int encodeSse(const char* src, int length, char* dst) {
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    int i = 0;
+    char* out = dst;
+    // each block reads 16 bytes but consumes only 12
+    for (; i + 16 <= length; i += 12) {
+        __m128i in = _mm_loadu_si128((const __m128i*) (src + i));
+        in = _mm_shuffle_epi8(in, shuffle);
+        _mm_storeu_si128((__m128i*) out, encodeTranslate128(encodeIndexes128(in)));
+        out += 16;
+    }
+    return (out - dst) + encodeScalar(src + i, length - i, out);
+}
+
+/*
+ * Spreads and translates the two 16-byte lanes of an already-shuffled
+ * 256-bit input, as encodeIndexes128 and encodeTranslate128 do for one lane.
+ */
+__attribute__((target("avx2")))
+static inline __m256i encodeBlock256(__m256i in) {
+    const __m256i shiftLut = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0);
+    __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    __m256i indexes = _mm256_or_si256(t1, t3);
+
+    __m256i reduced = _mm256_subs_epu8(indexes, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indexes);
+    reduced = _mm256_or_si256(reduced, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(indexes, _mm256_shuffle_epi8(shiftLut, reduced));
+}
+
+__attribute__((target("avx2")))
+static int encodeAvx2(const char* src, int length, char* dst) {
+    const __m256i shuffle = _mm256_setr_epi8(
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    int i = 0;
+    char* out = dst;
+    // each block reads 28 bytes (12 per lane, loaded 16 at a time) but consumes 24
+    for (; i + 28 <= length; i += 24) {
+        __m128i lo = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*) (src + i + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i*) out, encodeBlock256(_mm256_shuffle_epi8(in, shuffle)));
+        out += 32;
+    }
+    return (out - dst) + encodeScalar(src + i, length - i, out);
+}
+
+/*
+ * Shuffle masks that gather 4 groups of 3 RGB bytes straight from 0xRRGGBB
+ * pixels into the layout encodeIndexes128 expects (bytes 1,0,2,1 of each
+ * group).  Row [c] is for streams that start at component c of the first
+ * pixel (0 = red); the first mask selects from pixels i..i+3 and the second
+ * from pixels i+1..i+4, since a group can straddle into a fifth pixel.
+ */
+static const signed char RGB_SHUFFLE[3][2][16] = {
+    {{1, 2, 0, 1, 5, 6, 4, 5, 9, 10, 8, 9, 13, 14, 12, 13},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}},
+    {{0, 1, 6, 0, 4, 5, 10, 4, 8, 9, 14, 8, 12, 13, -1, 12},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, -1}},
+    {{6, 0, 5, 6, 10, 4, 9, 10, 14, 8, 13, 14, -1, 12, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, -1, 13, 14}}
+};
+
+/*
+ * Encodes RGB bytes of whole pixels, starting at the given component of the
+ * first pixel, 4 pixels (16 characters) at a time.  Returns the number of
+ * pixels' worth of bytes encoded; the caller encodes the rest.
+ */
+__attribute__((target("ssse3,sse4.1")))
+static int encodeRGBSse(const int* pixels, int count, int component, char* dst) {
+    const __m128i first = _mm_loadu_si128((const __m128i*) RGB_SHUFFLE[component][0]);
+    const __m128i second = _mm_loadu_si128((const __m128i*) RGB_SHUFFLE[component][1]);
+    int i = 0;
+    for (; i + 5 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (pixels + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (pixels + i + 1));
+        __m128i in = _mm_or_si128(_mm_shuffle_epi8(a, first), _mm_shuffle_epi8(b, second));
+        _mm_storeu_si128((__m128i*) dst, encodeTranslate128(encodeIndexes128(in)));
+        dst += 16;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int encodeRGBAvx2(const int* pixels, int count, int component, char* dst) {
+    const __m256i first = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*) RGB_SHUFFLE[component][0]));
+    const __m256i second = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*) RGB_SHUFFLE[component][1]));
+    int i = 0;
+    for (; i + 9 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (pixels + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (pixels + i + 1));
+        __m256i in = _mm256_or_si256(_mm256_shuffle_epi8(a, first), _mm256_shuffle_epi8(b, second));
+        _mm256_storeu_si256((__m256i*) dst, encodeBlock256(in));
+        dst += 32;
+    }
+    return i;
+}
+
+__attribute__((target("ssse3,sse4.1")))
+static int decodeSse(const char* src, int length, char* dst) {
+    const __m128i lutLo = _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71,
+            0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int i = 0;
+    char* out = dst;
+    // each block writes 16 bytes but produces only 12; stop while at least
+    // 8 more characters (6 more bytes) are known to follow
+    for (; i + 24 <= length; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+        __m128i loNibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm_testz_si128(lo, hi)) {
+            break;   // padding or an invalid character; let scalar code stop there
+        }
+        __m128i eq2F = _mm_cmpeq_epi8(in, _mm_set1_epi8(0x2f));
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+        __m128i values = _mm_add_epi8(in, roll);
+
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(packed, pack));
+        out += 12;
+    }
+    return (out - dst) + decodeScalar(src + i, length - i, out);
+}
+
+__attribute__((target("avx2")))
+static int decodeAvx2(const char* src, int length, char* dst) {
+    const __m256i lutLo = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lutHi = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71,
+            0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71,
+            0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    int i = 0;
+    char* out = dst;
+    // each block writes 32 bytes but produces only 24; stop while at least
+    // 12 more characters (9 more bytes) are known to follow
+    for (; i + 44 <= length; i += 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0f));
+        __m256i loNibbles = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+        __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;   // padding or an invalid character; let scalar code stop there
+        }
+        __m256i eq2F = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(0x2f));
+        __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        __m256i values = _mm256_add_epi8(in, roll);
+
+        __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        packed = _mm256_shuffle_epi8(packed, pack);
+        _mm256_storeu_si256((__m256i*) out, _mm256_permutevar8x32_epi32(packed, gather));
+        out += 24;
+    }
+    return (out - dst) + decodeScalar(src + i, length - i, out);
+}
+#endif // SPL_BASE64_X86
+
+typedef int (*CodecFunction)(const char*, int, char*);
+typedef int (*PixelCodecFunction)(const int*, int, int, char*);
+
+struct Implementation {
+    std::string name;
+    CodecFunction encode;
+    CodecFunction decode;
+    PixelCodecFunction encodeRGB;   // NULL if there is no vectorized version
+};
+
+static bool isSupported(const std::string& name) {
+    if (name == "scalar") {
+        return true;
+    }
+#ifdef SPL_BASE64_X86
+    __builtin_cpu_init();
+    if (name == "avx2") {
+        return __builtin_cpu_supports("avx2");
+    } else if (name == "sse4.1") {
+        return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+    }
+#endif // SPL_BASE64_X86
+    return false;
+}
+
+static Implementation makeImplementation(const std::string& name) {
+    Implementation impl;
+    impl.name = name;
+    impl.encode = encodeScalar;
+    impl.decode = decodeScalar;
+    impl.encodeRGB = NULL;
+#ifdef SPL_BASE64_X86
+    if (name == "avx2") {
+        impl.encode = encodeAvx2;
+        impl.decode = decodeAvx2;
+        impl.encodeRGB = encodeRGBAvx2;
+    } else if (name == "sse4.1") {
+        impl.encode = encodeSse;
+        impl.decode = decodeSse;
+        impl.encodeRGB = encodeRGBSse;
+    }
+#endif // SPL_BASE64_X86
+    return impl;
+}
+
+// the implementation in use; picked the first time it is needed
+static Implementation& currentImplementation() {
+    static Implementation impl = makeImplementation(
+            isSupported("avx2") ? "avx2" : isSupported("sse4.1") ? "sse4.1" : "scalar");
+    return impl;
+}
+
+int encodedLength(int length) {
+    return (length + 2) / 3 * 4;
+}
+
+int encode(const char* src, int length, char* dst) {
+    return currentImplementation().encode(src, length, dst);
+}
+
+int decodedLength(int length) {
+    return (length + 3) / 4 * 3;
+}
+
+int decode(const char* src, int length, char* dst) {
+    return currentImplementation().decode(src, length, dst);
+}
+
+// number of pixels' bytes packed at a time when no vectorized version is used
+static const int RGB_STAGING_PIXELS = 256;
+
+// returns the given component (0 = red, 1 = green, 2 = blue) of a pixel
+static inline unsigned char pixelByte(int rgb, int component) {
+    return (unsigned char) (rgb >> (16 - 8 * component));
+}
+
+int encodeRGB(const char* header, int headerLength,
+              const int* pixels, int count, char* dst) {
+    char* out = dst;
+    int whole = headerLength / 3 * 3;
+    out += encodeScalar(header, whole, out);
+
+    // the rest of the header and the start of the first pixel make up a
+    // group of 3 bytes; after that the stream starts at 'component' of
+    // pixels[next]
+    unsigned char stage[3 * RGB_STAGING_PIXELS];
+    int staged = headerLength - whole;
+    memcpy(stage, header + whole, staged);
+    int next = 0;
+    int component = 0;
+    while (staged % 3 != 0 && next < count) {
+        stage[staged++] = pixelByte(pixels[next], component);
+        if (++component == 3) {
+            component = 0;
+            next++;
+        }
+    }
+    out += encodeScalar((const char*) stage, staged, out);
+
+    PixelCodecFunction kernel = currentImplementation().encodeRGB;
+    if (kernel && next < count) {
+        // every pixel's 3 bytes become exactly 4 characters
+        int encoded = kernel(pixels + next, count - next, component, out);
+        next += encoded;
+        out += 4 * encoded;
+    }
+
+    // pack what is left into a small buffer and encode that
+    while (next < count) {
+        staged = 0;
+        while (staged < (int) sizeof(stage) && next < count) {
+            stage[staged++] = pixelByte(pixels[next], component);
+            if (++component == 3) {
+                component = 0;
+                next++;
+            }
+        }
+        out += encodeScalar((const char*) stage, staged, out);
+    }
+    return out - dst;
+}
+
+std::string getImplementation() {
+    return currentImplementation().name;
+}
+
+bool setImplementation(const std::string& name) {
+    if (!isSupported(name)) {
+        return false;
+    }
+    currentImplementation() = makeImplementation(name);
+    return true;
+}
+
 std::string encode(const std::string& s) {
-    // make C char* buffer to store the encoded output (for compatibility)
-    int len = Base64encode_len(s.length());
-    char* buf = (char*) malloc(len);
-    memset(buf, 0, len);
-    Base64encode(buf, s.c_str(), s.length());
-    
-    // convert back into a C++ string, and return it
-    // (unlike below in decode(), I can just directly construct the C++
-    // string from the C one, because the Base64-encoded C string will
-    // not contain any intermediate null bytes by definition)
-    std::string result(buf);
-    free(buf);
+    std::string result(encodedLength(s.length()), '\0');
+    if (!result.empty()) {
+        encode(s.data(), s.length(), &result[0]);
+    }
     return result;
 }
 
 std::string decode(const std::string& s) {
-    // convert into C string and decode into that char* buffer
-    const char* cstr = s.c_str();
-    int len = Base64decode_len(cstr);
-    char* buf = (char*) malloc(len);
-    memset(buf, 0, len);
-    Base64decode(buf, cstr);
-    
-    // read bytes from that buffer into a C++ string
-    // (cannot just construct/assign C++ string from C char* buffer,
-    // because that will terminate the string at the first null \0 byte)
-    std::ostringstream out;
-    for (int i = 0; i < len; i++) {
-        out << (char) buf[i];
-    }
-    std::string result = out.str();
-    
-    free(buf);
+    std::string result(decodedLength(s.length()), '\0');
+    if (!result.empty()) {
+        result.resize(decode(s.data(), s.length(), &result[0]));
+    }
     return result;
 }
 }
@@ -6,6 +6,10 @@
  * http://en.wikipedia.org/wiki/Base64
  *
  * @author Marty Stepp, based upon open-source Apache Base64 en/decoder
+ * @version 2026/10/17
+ * - added buffer-based encode/decode with SSE4.1/AVX2 implementations chosen
+ *   at runtime, falling back to portable scalar code
+ * - added encodeRGB to encode packed pixels without an intermediate buffer
  * @version 2014/08/03
  * @since 2014/08/03
  */
@@ -40,6 +44,58 @@ std::string encode(const std::string& s);
  * original contents.
  */
 std::string decode(const std::string& s);
+
+/*
+ * Returns the number of characters that encode will write for the given
+ * number of input bytes, including any '=' padding (no null terminator).
+ */
+int encodedLength(int length);
+
+/*
+ * Encodes length bytes from src into dst, which must have room for at least
+ * encodedLength(length) characters.  No null terminator is written.
+ * Returns the number of characters written.
+ */
+int encode(const char* src, int length, char* dst);
+
+/*
+ * Returns the largest number of bytes that decode can write for the given
+ * number of Base64 characters.
+ */
+int decodedLength(int length);
+
+/*
+ * Decodes up to length Base64 characters from src into dst, which must have
+ * room for at least decodedLength(length) bytes.  Decoding stops early at
+ * the first character that is not part of the Base64 alphabet, such as
+ * '=' padding or a null terminator.
+ * Returns the number of bytes written.
+ */
+int decode(const char* src, int length, char* dst);
+
+/*
+ * Encodes headerLength bytes from header followed by the red, green, and
+ * blue bytes of each of count 0xRRGGBB pixels, as one continuous Base64
+ * stream.  The pixel bytes are packed and encoded in registers, so no
+ * intermediate RGB buffer is needed.  dst must have room for at least
+ * encodedLength(headerLength + 3 * count) characters.
+ * Returns the number of characters written.
+ */
+int encodeRGB(const char* header, int headerLength,
+              const int* pixels, int count, char* dst);
+
+/*
+ * Returns the name of the implementation used by the buffer-based encode
+ * and decode functions: "avx2", "sse4.1", or "scalar".
+ */
+std::string getImplementation();
+
+/*
+ * Forces the buffer-based functions to use the given implementation.
+ * Returns false and changes nothing if it is not supported by this CPU.
+ * Mostly useful for testing and benchmarking.
+ */
+bool setImplementation(const std::string& name);
 }
 #endif
 
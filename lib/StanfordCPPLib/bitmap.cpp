@@ -0,0 +1,255 @@
+/*
+ * File: bitmap.cpp
+ * ----------------
+ * This file implements the bitmap.h interface.
+ *
+ * @since 2026/10/17
+ */
+
+#include "bitmap.h"
+#include <algorithm>
+#include "error.h"
+#include "gbufferedimage.h"
+#include "strlib.h"
+
+// counting uses the POPCNT instruction when the CPU has it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SPL_BITMAP_X86
+#endif
+
+static const uint64_t ALL_ONES = ~0ULL;
+
+static inline int popcount64(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+typedef long long (*CountFunction)(const uint64_t*, size_t);
+
+static long long countScalar(const uint64_t* words, size_t n) {
+    long long total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += popcount64(words[i]);
+    }
+    return total;
+}
+
+#ifdef SPL_BITMAP_X86
+__attribute__((target("popcnt")))
+static long long countPopcnt(const uint64_t* words, size_t n) {
+    long long total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += __builtin_popcountll(words[i]);
+    }
+    return total;
+}
+#endif // SPL_BITMAP_X86
+
+static CountFunction chooseCount() {
+#ifdef SPL_BITMAP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt")) {
+        return countPopcnt;
+    }
+#endif // SPL_BITMAP_X86
+    return countScalar;
+}
+
+Bitmap::Bitmap()
+        : nRows(0), nCols(0), stride(0) {
+    /* Empty */
+}
+
+Bitmap::Bitmap(int nRows, int nCols)
+        : nRows(0), nCols(0), stride(0) {
+    resize(nRows, nCols);
+}
+
+Bitmap::Bitmap(const Grid<int>& grid, int color)
+        : nRows(0), nCols(0), stride(0) {
+    resize(grid.numRows(), grid.numCols());
+    setFromPixels(grid.data(), color);
+}
+
+Bitmap::Bitmap(const GBufferedImage& image, int color)
+        : nRows(0), nCols(0), stride(0) {
+    const Grid<int>& grid = image.toGridView();
+    resize(grid.numRows(), grid.numCols());
+    setFromPixels(grid.data(), color);
+}
+
+long long Bitmap::count() const {
+    static const CountFunction countWords = chooseCount();
+    return countWords(words.data(), words.size());
+}
+
+void Bitmap::fill(bool value) {
+    if (!value) {
+        std::fill(words.begin(), words.end(), 0);
+        return;
+    }
+    std::fill(words.begin(), words.end(), ALL_ONES);
+    int tailBits = nCols % 64;
+    if (tailBits != 0) {
+        for (int row = 0; row < nRows; row++) {
+            rowWords(row)[stride - 1] = (1ULL << tailBits) - 1;
+        }
+    }
+}
+
+bool Bitmap::get(int row, int col) const {
+    checkIndexes(row, col, "get");
+    return (rowWords(row)[col / 64] >> (col % 64)) & 1;
+}
+
+bool Bitmap::inBounds(int row, int col) const {
+    return row >= 0 && col >= 0 && row < nRows && col < nCols;
+}
+
+bool Bitmap::isEmpty() const {
+    return nRows == 0 || nCols == 0;
+}
+
+int Bitmap::numRows() const {
+    return nRows;
+}
+
+int Bitmap::numCols() const {
+    return nCols;
+}
+
+void Bitmap::resize(int nRows, int nCols) {
+    if (nRows < 0 || nCols < 0) {
+        error("Bitmap::resize: Attempt to resize bitmap to invalid size ("
+              + integerToString(nRows) + ", " + integerToString(nCols) + ")");
+    }
+    this->nRows = nRows;
+    this->nCols = nCols;
+    stride = (nCols + 63) / 64;
+    words.assign((size_t) nRows * stride, 0);
+}
+
+uint64_t* Bitmap::rowWords(int row) {
+    return words.data() + (size_t) row * stride;
+}
+
+const uint64_t* Bitmap::rowWords(int row) const {
+    return words.data() + (size_t) row * stride;
+}
+
+void Bitmap::set(int row, int col, bool value) {
+    checkIndexes(row, col, "set");
+    uint64_t bit = 1ULL << (col % 64);
+    uint64_t& word = rowWords(row)[col / 64];
+    word = value ? (word | bit) : (word & ~bit);
+}
+
+Grid<int> Bitmap::toGrid(int onColor, int offColor) const {
+    Grid<int> grid(nRows, nCols);
+    for (int row = 0; row < nRows; row++) {
+        const uint64_t* src = rowWords(row);
+        int* dst = grid.rowPtr(row);
+        for (int col = 0; col < nCols; col++) {
+            dst[col] = ((src[col / 64] >> (col % 64)) & 1) ? onColor : offColor;
+        }
+    }
+    return grid;
+}
+
+void Bitmap::toImage(GBufferedImage& image, int onColor, int offColor) const {
+    image.fromGrid(toGrid(onColor, offColor));
+}
+
+int Bitmap::wordsPerRow() const {
+    return stride;
+}
+
+Bitmap& Bitmap::operator &=(const Bitmap& other) {
+    checkSameSize(other, "operator &=");
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] &= other.words[i];
+    }
+    return *this;
+}
+
+Bitmap& Bitmap::operator |=(const Bitmap& other) {
+    checkSameSize(other, "operator |=");
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] |= other.words[i];
+    }
+    return *this;
+}
+
+Bitmap& Bitmap::operator ^=(const Bitmap& other) {
+    checkSameSize(other, "operator ^=");
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] ^= other.words[i];
+    }
+    return *this;
+}
+
+bool Bitmap::operator ==(const Bitmap& other) const {
+    return nRows == other.nRows && nCols == other.nCols && words == other.words;
+}
+
+bool Bitmap::operator !=(const Bitmap& other) const {
+    return !(*this == other);
+}
+
+void Bitmap::checkIndexes(int row, int col, const std::string& prefix) const {
+    if (!inBounds(row, col)) {
+        error("Bitmap::" + prefix + ": (" + integerToString(row) + ", "
+              + integerToString(col) + ") is outside a bitmap of "
+              + integerToString(nRows) + " rows and " + integerToString(nCols) + " columns");
+    }
+}
+
+void Bitmap::checkSameSize(const Bitmap& other, const std::string& prefix) const {
+    if (nRows != other.nRows || nCols != other.nCols) {
+        error("Bitmap::" + prefix + ": bitmaps are of different sizes");
+    }
+}
+
+/*
+ * Sets the bits whose pixels, nCols to a row, have the given color in
+ * their low 24 bits.
+ */
+void Bitmap::setFromPixels(const int* pixels, int color) {
+    color &= 0xFFFFFF;
+    for (int row = 0; row < nRows; row++) {
+        const int* src = pixels + (size_t) row * nCols;
+        uint64_t* dst = rowWords(row);
+        for (int word = 0; word < stride; word++) {
+            int colEnd = std::min(nCols - word * 64, 64);
+            uint64_t bits = 0;
+            for (int i = 0; i < colEnd; i++) {
+                bits |= (uint64_t) ((src[word * 64 + i] & 0xFFFFFF) == color) << i;
+            }
+            dst[word] = bits;
+        }
+    }
+}
+
+Bitmap operator &(const Bitmap& bitmap1, const Bitmap& bitmap2) {
+    Bitmap result = bitmap1;
+    result &= bitmap2;
+    return result;
+}
+
+Bitmap operator |(const Bitmap& bitmap1, const Bitmap& bitmap2) {
+    Bitmap result = bitmap1;
+    result |= bitmap2;
+    return result;
+}
+
+Bitmap operator ^(const Bitmap& bitmap1, const Bitmap& bitmap2) {
+    Bitmap result = bitmap1;
+    result ^= bitmap2;
+    return result;
+}
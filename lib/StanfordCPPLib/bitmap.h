@@ -0,0 +1,198 @@
+/*
+ * File: bitmap.h
+ * --------------
+ * This file exports the <code>Bitmap</code> class, a two-dimensional array
+ * of bits for black-and-white images and masks.
+ *
+ * @since 2026/10/17
+ */
+
+#ifndef _bitmap_h
+#define _bitmap_h
+
+#include <cstdint>
+#include <vector>
+#include "grid.h"
+
+class GBufferedImage;
+
+/*
+ * Class: Bitmap
+ * -------------
+ * This class stores one bit for each pixel of an image, packed 64 to a
+ * word, so it takes 1/32 of the memory of a <code>Grid&lt;int&gt;</code>
+ * of the same size.  Counting and combining bitmaps works a word at a
+ * time.  Each row starts on a new word, and the bits past the last column
+ * of a row are always 0, so whole rows can be processed independently,
+ * for instance by different threads.
+ */
+class Bitmap {
+public:
+    /*
+     * Constructor: Bitmap
+     * Usage: Bitmap bitmap;
+     *        Bitmap bitmap(nRows, nCols);
+     *        Bitmap bitmap(grid, color);
+     *        Bitmap bitmap(image, color);
+     * ---------------------------------------
+     * Creates a bitmap.  The default constructor creates an empty bitmap;
+     * the second form creates one of the given size with every bit 0.  The
+     * last two set exactly the bits whose pixels in the given grid or image
+     * have the given color, ignoring the bits above the low 24 (red, green,
+     * and blue).
+     */
+    Bitmap();
+    Bitmap(int nRows, int nCols);
+    Bitmap(const Grid<int>& grid, int color);
+    Bitmap(const GBufferedImage& image, int color);
+
+    /*
+     * Method: count
+     * Usage: long long n = bitmap.count();
+     * ------------------------------------
+     * Returns the number of bits that are 1, counted with the CPU's
+     * population-count instruction where it has one.
+     */
+    long long count() const;
+
+    /*
+     * Method: fill
+     * Usage: bitmap.fill(value);
+     * --------------------------
+     * Sets every bit to the given value.
+     */
+    void fill(bool value);
+
+    /*
+     * Method: get
+     * Usage: bool value = bitmap.get(row, col);
+     * -----------------------------------------
+     * Returns the bit at the given position.  Signals an error if the
+     * position is outside the bitmap.
+     */
+    bool get(int row, int col) const;
+
+    /*
+     * Method: inBounds
+     * Usage: if (bitmap.inBounds(row, col)) ...
+     * -----------------------------------------
+     * Returns <code>true</code> if the given position is inside the bitmap.
+     */
+    bool inBounds(int row, int col) const;
+
+    /*
+     * Method: isEmpty
+     * Usage: if (bitmap.isEmpty()) ...
+     * --------------------------------
+     * Returns <code>true</code> if the bitmap has 0 rows and/or 0 columns.
+     */
+    bool isEmpty() const;
+
+    /*
+     * Method: numRows
+     * Usage: int nRows = bitmap.numRows();
+     * ------------------------------------
+     * Returns the number of rows in the bitmap.
+     */
+    int numRows() const;
+
+    /*
+     * Method: numCols
+     * Usage: int nCols = bitmap.numCols();
+     * ------------------------------------
+     * Returns the number of columns in the bitmap.
+     */
+    int numCols() const;
+
+    /*
+     * Method: resize
+     * Usage: bitmap.resize(nRows, nCols);
+     * -----------------------------------
+     * Changes the size of the bitmap and sets every bit to 0.
+     */
+    void resize(int nRows, int nCols);
+
+    /*
+     * Method: rowWords
+     * Usage: uint64_t* words = bitmap.rowWords(row);
+     * ----------------------------------------------
+     * Returns a pointer to the wordsPerRow() words of the given row.  Column
+     * col is bit (col % 64) of word (col / 64), counting from the least
+     * significant bit.  Callers that write through the pointer must leave
+     * the bits past the last column 0.  No bounds checking is done.
+     */
+    uint64_t* rowWords(int row);
+    const uint64_t* rowWords(int row) const;
+
+    /*
+     * Method: set
+     * Usage: bitmap.set(row, col, value);
+     * -----------------------------------
+     * Sets the bit at the given position.  Signals an error if the position
+     * is outside the bitmap.
+     */
+    void set(int row, int col, bool value);
+
+    /*
+     * Method: toGrid
+     * Usage: Grid<int> grid = bitmap.toGrid(onColor, offColor);
+     * ---------------------------------------------------------
+     * Returns a grid of the same size holding onColor where the bitmap has
+     * a 1 and offColor where it has a 0.
+     */
+    Grid<int> toGrid(int onColor, int offColor) const;
+
+    /*
+     * Method: toImage
+     * Usage: bitmap.toImage(image, onColor, offColor);
+     * ------------------------------------------------
+     * Replaces the contents of the given image as toGrid would, resizing it
+     * to the size of the bitmap.
+     */
+    void toImage(GBufferedImage& image, int onColor, int offColor) const;
+
+    /*
+     * Method: wordsPerRow
+     * Usage: int n = bitmap.wordsPerRow();
+     * ------------------------------------
+     * Returns the number of 64-bit words that hold each row.
+     */
+    int wordsPerRow() const;
+
+    /*
+     * Operators: &=, |=, ^=, &, |, ^
+     * Usage: mask &= other;
+     *        Bitmap both = mask & other;
+     * ----------------------------------
+     * Combine two bitmaps of the same size bit by bit.  Signal an error if
+     * the sizes differ.
+     */
+    Bitmap& operator &=(const Bitmap& other);
+    Bitmap& operator |=(const Bitmap& other);
+    Bitmap& operator ^=(const Bitmap& other);
+
+    /*
+     * Operators: ==, !=
+     * Usage: if (bitmap1 == bitmap2) ...
+     * ----------------------------------
+     * Compare two bitmaps for equality of size and of every bit.
+     */
+    bool operator ==(const Bitmap& other) const;
+    bool operator !=(const Bitmap& other) const;
+
+private:
+    int nRows;
+    int nCols;
+    int stride;                   // words per row
+    std::vector<uint64_t> words;  // row-major, each row padded to whole words
+
+    void checkIndexes(int row, int col, const std::string& prefix) const;
+    void checkSameSize(const Bitmap& other, const std::string& prefix) const;
+    void setFromPixels(const int* pixels, int color);
+};
+
+Bitmap operator &(const Bitmap& bitmap1, const Bitmap& bitmap2);
+Bitmap operator |(const Bitmap& bitmap1, const Bitmap& bitmap2);
+Bitmap operator ^(const Bitmap& bitmap1, const Bitmap& bitmap2);
+
+#endif
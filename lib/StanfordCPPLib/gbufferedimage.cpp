@@ -5,6 +5,23 @@
  * See that file for documentation of each member.
  *
  * @author Marty Stepp
+ * @version 2026/10/17
+ * - load takes the pixels of files it has decoded before from the image
+ *   cache (see imagecache.h)
+ * - load, fromGrid, save, and sending pixels to the back-end are timed when
+ *   JBEPROFILE is set (see profiler.h)
+ * - added fromGrid(Grid<int>&&), toGridView to avoid copying whole images
+ * - added compare; countDiffPixels now uses its vectorized, parallel loop
+ * - bulk pixel loops work on whole rows via Grid::rowPtr
+ * - full-image updates pack and base64-encode pixels in one pass, without
+ *   building intermediate strings
+ * @version 2026/10/16
+ * - load decodes PNG/JPEG/GIF/PPM files natively (see imagecodec.h) and only
+ *   falls back to the Java back-end for other formats
+ * - pixel changes made while an image is not on screen are kept locally and
+ *   sent to the back-end in one update when the image is displayed or saved
+ * - displayed images send only the tiles that changed since the last update
+ * - added setRGBSpan, setRGBRect
  * @version 2015/10/08
  * - bug fixes and refactoring for pixel-based functions such as fromGrid, load
  *   to help fix bugs with Base64 encoding/decoding
@@ -26,18 +43,64 @@
  */
 
 #include "gbufferedimage.h"
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iomanip>
+#include <utility>
 #include "base64.h"
 #include "filelib.h"
 #include "gwindow.h"
+#include "imagecache.h"
 #include "platform.h"
+#include "profiler.h"
 #include "strlib.h"
+#include "vector.h"
 
 #define CHAR_TO_HEX(ch) ((ch >= '0' && ch <= '9') ? (ch - '0') : (ch - 'a' + 10))
 
 const int GBufferedImage::WIDTH_HEIGHT_MAX = 65535;
 
+// side length of the square tiles hashed when looking for changed pixels
+static const int DIRTY_TILE_SIZE = 32;
+
+// rough length in bytes of one setRGB/fillRegion command sent to the back-end;
+// used to decide whether a region update is cheaper than resending everything
+static const int REGION_COMMAND_COST = 48;
+
+/*
+ * Returns a hash of the tile whose top-left pixel is (x, y).  Pixels are
+ * mixed in one at a time with an FNV-1a step, so changing any single pixel
+ * always changes the hash.
+ */
+static unsigned long long hashTile(const Grid<int>& pixels, int x, int y) {
+    int right = std::min(x + DIRTY_TILE_SIZE, pixels.width());
+    int bottom = std::min(y + DIRTY_TILE_SIZE, pixels.height());
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for (int r = y; r < bottom; r++) {
+        const int* row = pixels.rowPtr(r);
+        for (int c = x; c < right; c++) {
+            hash = (hash ^ (unsigned int) row[c]) * 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+/*
+ * Returns the hash of every tile of the given pixels, indexed [row][col]
+ * by tile.
+ */
+static Grid<unsigned long long> hashTiles(const Grid<int>& pixels) {
+    Grid<unsigned long long> tiles((pixels.height() + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE,
+                                   (pixels.width() + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE);
+    for (int tr = 0; tr < tiles.numRows(); tr++) {
+        for (int tc = 0; tc < tiles.numCols(); tc++) {
+            tiles[tr][tc] = hashTile(pixels, tc * DIRTY_TILE_SIZE, tr * DIRTY_TILE_SIZE);
+        }
+    }
+    return tiles;
+}
+
 int GBufferedImage::createRgbPixel(int red, int green, int blue) {
     if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 || blue > 255) {
         error("RGB values must be between 0-255");
@@ -67,7 +130,8 @@ GBufferedImage::GBufferedImage()
         : GInteractor(),
           m_width(1),
           m_height(1),
-          m_backgroundColor(0) {
+          m_backgroundColor(0),
+          m_backendStale(false) {
     init(/* x */ 0, /* y */ 0, /* width */ 1, /* height */ 1, 0x000000);
 }
 
@@ -76,7 +140,8 @@ GBufferedImage::GBufferedImage(double width, double height,
     : GInteractor(),
       m_width(1),
       m_height(1),
-      m_backgroundColor(rgbBackground) {
+      m_backgroundColor(rgbBackground),
+      m_backendStale(false) {
     init(0, 0, width, height, rgbBackground);
 }
 
@@ -85,7 +150,8 @@ GBufferedImage::GBufferedImage(double x, double y, double width, double height,
     : GInteractor(),
       m_width(width),
       m_height(height),
-      m_backgroundColor(rgbBackground) {
+      m_backgroundColor(rgbBackground),
+      m_backendStale(false) {
     init(x, y, width, height, rgbBackground);
 }
 
@@ -94,7 +160,8 @@ GBufferedImage::GBufferedImage(double x, double y, double width, double height,
     : GInteractor(),
       m_width(width),
       m_height(height),
-      m_backgroundColor(0) {
+      m_backgroundColor(0),
+      m_backendStale(false) {
     init(x, y, width, height, convertColorToRGB(rgbBackground));
 }
 
@@ -115,28 +182,12 @@ void GBufferedImage::clear() {
 }
 
 int GBufferedImage::countDiffPixels(GBufferedImage& image) const {
-    int w1 = (int) getWidth();
-    int h1 = (int) getHeight();
-    int w2 = (int) image.getWidth();
-    int h2 = (int) image.getHeight();
-
-    int wmin = std::min(w1, w2);
-    int hmin = std::min(h1, h2);
-    
-    int overlap = std::min(w1, w2) * std::min(h1, h2);
-    int diffPxCount = (w1 * h1 - overlap) + (w2 * h2 - overlap);
-
-    for (int y = 0; y < hmin; y++) {
-        for (int x = 0; x < wmin; x++) {
-            int px1 = m_pixels[y][x];
-            int px2 = image.m_pixels[y][x];
-            if (px1 != px2) {
-                diffPxCount++;
-            }
-        }
-    }
+    return (int) imagecompare::compare(m_pixels, image.m_pixels).diffPixels;
+}
 
-    return diffPxCount;
+imagecompare::Result GBufferedImage::compare(const GBufferedImage& image,
+                                             const imagecompare::Options& options) const {
+    return imagecompare::compare(m_pixels, image.m_pixels, options);
 }
 
 GBufferedImage* GBufferedImage::diff(GBufferedImage& image, int diffPixelColor) const {
@@ -174,7 +225,10 @@ GBufferedImage* GBufferedImage::diff(GBufferedImage& image, int diffPixelColor)
 void GBufferedImage::fill(int rgb) {
     checkColor("fill", rgb);
     m_pixels.fill(rgb);
-    getPlatform()->gbufferedimage_fill(this, rgb);
+    if (!m_backendStale) {
+        rehashTiles(0, 0, m_pixels.width(), m_pixels.height());
+        getPlatform()->gbufferedimage_fill(this, rgb);
+    }
 }
 
 void GBufferedImage::fill(std::string rgb) {
@@ -186,11 +240,12 @@ void GBufferedImage::fillRegion(double x, double y, double width, double height,
     checkIndex("fillRegion", x + width - 1, y + height - 1);
     checkColor("fillRegion", rgb);
     for (int r = (int) y; r < y + height; r++) {
-        for (int c = (int) x; c < x + width; c++) {
-            m_pixels[r][c] = rgb;
-        }
+        std::fill_n(m_pixels.rowPtr(r) + (int) x, (int) width, rgb);
+    }
+    if (!m_backendStale) {
+        rehashTiles(x, y, width, height);
+        getPlatform()->gbufferedimage_fillRegion(this, x, y, width, height, rgb);
     }
-    getPlatform()->gbufferedimage_fillRegion(this, x, y, width, height, rgb);
 }
 
 void GBufferedImage::fillRegion(double x, double y, double width, double height, std::string rgb) {
@@ -198,37 +253,21 @@ void GBufferedImage::fillRegion(double x, double y, double width, double height,
 }
 
 void GBufferedImage::fromGrid(const Grid<int>& grid) {
+    profiler::StageTimer timer("GBufferedImage::fromGrid");
     checkSize("fromGrid", grid.width(), grid.height());
     m_pixels = grid;
     m_width = grid.width();
     m_height = grid.height();
-    
-    // output a base64-encoded version of the image pixels
-    std::ostringstream out;
-    
-    // output width as 2 bytes, then height as 2 bytes
-    out << (char) (((((int) m_width) & 0x0000ff00) >> 8) & 0x000000ff);
-    out << (char)  ((((int) m_width) & 0x000000ff));
-    out << (char) (((((int) m_height) & 0x0000ff00) >> 8) & 0x000000ff);
-    out << (char)  ((((int) m_height) & 0x000000ff));
-    
-    // output each pixel as 3 bytes (R,G,B)
-    for (int row = 0; row < m_height; row++) {
-        for (int col = 0; col < m_width; col++) {
-            int rgb = grid[row][col];
-            out << (char) (((rgb & 0x00ff0000) >> 16) & 0x000000ff);
-            out << (char) (((rgb & 0x0000ff00) >> 8) & 0x000000ff);
-            out << (char)   (rgb & 0x000000ff);
-        }
-    }
+    markBackendStale();
+}
 
-    // encode the bytes into a base64 string so it can go through
-    // the process pipe to the Java back-end
-    std::string result = out.str();
-    std::string encoded = Base64::encode(result);
-    
-    // update the back-end with all of the pretty new pixels
-    getPlatform()->gbufferedimage_updateAllPixels(this, encoded);
+void GBufferedImage::fromGrid(Grid<int>&& grid) {
+    profiler::StageTimer timer("GBufferedImage::fromGrid");
+    checkSize("fromGrid", grid.width(), grid.height());
+    m_pixels = std::move(grid);
+    m_width = m_pixels.width();
+    m_height = m_pixels.height();
+    markBackendStale();
 }
 
 double GBufferedImage::getHeight() const {
@@ -253,15 +292,37 @@ bool GBufferedImage::inBounds(double x, double y) const {
 }
 
 void GBufferedImage::load(const std::string& filename) {
+    profiler::StageTimer timer("GBufferedImage::load");
     // for efficiency, let's at least check whether the file exists
     // and throw error immediately rather than contacting the back-end
     if (!fileExists(filename)) {
         error("GBufferedImage::load: file not found: " + filename);
     }
-    
-    // read Base64-compressed pixel data from Java back-end
+
+    // decode common formats ourselves, or reuse the pixels of a file decoded
+    // before; the back-end only needs them once this image is actually displayed
+    bool decodedNatively;
+    {
+        profiler::StageTimer decodeTimer("GBufferedImage::load decodeFile");
+        decodedNatively = imagecache::decodeFile(filename, m_pixels);
+    }
+    if (decodedNatively) {
+        m_width = m_pixels.width();
+        m_height = m_pixels.height();
+        markBackendStale();
+        return;
+    }
+
+    // read Base64-compressed pixel data from Java back-end;
+    // this also replaces any pixels the back-end had not yet been sent
+    m_backendStale = false;
+    m_displayedTiles.resize(0, 0);
     std::string result = getPlatform()->gbufferedimage_load(this, filename);
-    std::string decoded = Base64::decode(result);
+    std::string decoded;
+    {
+        profiler::StageTimer decodeTimer("GBufferedImage::load Base64::decode");
+        decoded = Base64::decode(result);
+    }
     
     // read width (2-byte) and height (2-byte)
     int w = (((decoded[0] & 0x000000ff) << 8) & 0x0000ff00) | (decoded[1] & 0x000000ff);
@@ -283,6 +344,7 @@ void GBufferedImage::load(const std::string& filename) {
     }
     
     // read each pixel (3-byte: R,G,B)
+    profiler::StageTimer pixelTimer("GBufferedImage::load pixels");
     int i = 4;
     for (int y = 0; y < m_height; y++) {
         for (int x = 0; x < m_width; x++) {
@@ -296,6 +358,7 @@ void GBufferedImage::load(const std::string& filename) {
             }
         }
     }
+    imagecache::store(filename, m_pixels);
 }
 
 void GBufferedImage::resize(double width, double height, bool retain) {
@@ -310,7 +373,10 @@ void GBufferedImage::resize(double width, double height, bool retain) {
     } else {
         // was non-zero
         this->m_pixels.resize((int) this->m_height, (int) this->m_width, retain);
-        getPlatform()->gbufferedimage_resize(this, width, height, retain);
+        if (!m_backendStale) {
+            getPlatform()->gbufferedimage_resize(this, width, height, retain);
+        }
+        m_displayedTiles.resize(0, 0);
         if (!retain && m_backgroundColor != 0x0) {
             this->m_pixels.fill(m_backgroundColor);
         }
@@ -318,6 +384,8 @@ void GBufferedImage::resize(double width, double height, bool retain) {
 }
 
 void GBufferedImage::save(const std::string& filename) const {
+    profiler::StageTimer timer("GBufferedImage::save");
+    syncDisplay();
     getPlatform()->gbufferedimage_save(this, filename);
 }
 
@@ -325,13 +393,24 @@ void GBufferedImage::setRGB(double x, double y, int rgb) {
     checkIndex("setRGB", x, y);
     checkColor("setRGB", rgb);
     m_pixels[(int) y][(int) x] = rgb;
-    getPlatform()->gbufferedimage_setRGB(this, x, y, rgb);
+    if (!m_backendStale) {
+        rehashTiles(x, y, 1, 1);
+        getPlatform()->gbufferedimage_setRGB(this, x, y, rgb);
+    }
 }
 
 void GBufferedImage::setRGB(double x, double y, std::string rgb) {
     setRGB(x, y, convertColorToRGB(rgb));
 }
 
+void GBufferedImage::setRGBSpan(int row, int colStart, const int* px, int n) {
+    setRGBRegion("setRGBSpan", colStart, row, n, 1, px);
+}
+
+void GBufferedImage::setRGBRect(int x, int y, int width, int height, const int* px) {
+    setRGBRegion("setRGBRect", x, y, width, height, px);
+}
+
 Grid<int> GBufferedImage::toGrid() const {
     return m_pixels;
 }
@@ -340,6 +419,29 @@ void GBufferedImage::toGrid(Grid<int>& grid) const {
     grid = m_pixels;
 }
 
+const Grid<int>& GBufferedImage::toGridView() const {
+    return m_pixels;
+}
+
+void GBufferedImage::syncDisplay() const {
+    if (!m_backendStale) {
+        return;
+    }
+    m_backendStale = false;
+    profiler::StageTimer timer("GBufferedImage::syncDisplay");
+
+    // if the back-end already shows an earlier version of this image,
+    // it may be enough to send just the tiles whose hashes changed
+    Grid<unsigned long long> tiles = hashTiles(m_pixels);
+    bool sameSize = m_displayedSize.getWidth() == m_pixels.width()
+            && m_displayedSize.getHeight() == m_pixels.height();
+    if (!sameSize || m_displayedTiles.isEmpty() || !sendChangedRegions(tiles)) {
+        sendAllPixels();
+        m_displayedSize = GDimension(m_pixels.width(), m_pixels.height());
+    }
+    m_displayedTiles = tiles;
+}
+
 
 void GBufferedImage::checkColor(std::string member, int rgb) const {
     if (rgb < 0x0 || rgb > 0xffffff) {
@@ -370,6 +472,135 @@ void GBufferedImage::checkSize(std::string member, double width, double height)
     }
 }
 
+bool GBufferedImage::sendChangedRegions(const Grid<unsigned long long>& tiles) const {
+    int w = m_pixels.width();
+    int h = m_pixels.height();
+
+    // find changed tiles; merge adjacent ones in a tile row into a span,
+    // and spans that line up with the span above into a taller rectangle
+    Vector<GRectangle> regions;
+    for (int ty = 0; ty < h; ty += DIRTY_TILE_SIZE) {
+        int th = std::min(DIRTY_TILE_SIZE, h - ty);
+        int spanStart = -1;
+        // the step just past the last tile closes a span that reaches the edge
+        for (int tx = 0; tx < w + DIRTY_TILE_SIZE; tx += DIRTY_TILE_SIZE) {
+            bool changed = tx < w && tiles[ty / DIRTY_TILE_SIZE][tx / DIRTY_TILE_SIZE]
+                    != m_displayedTiles[ty / DIRTY_TILE_SIZE][tx / DIRTY_TILE_SIZE];
+            if (changed && spanStart < 0) {
+                spanStart = tx;
+            } else if (!changed && spanStart >= 0) {
+                int spanWidth = std::min(tx, w) - spanStart;
+                GRectangle above = regions.isEmpty() ? GRectangle() : regions[regions.size() - 1];
+                if (!regions.isEmpty() && above.getX() == spanStart && above.getWidth() == spanWidth
+                        && above.getY() + above.getHeight() == ty) {
+                    regions[regions.size() - 1] = GRectangle(spanStart, above.getY(),
+                                                             spanWidth, above.getHeight() + th);
+                } else {
+                    regions.add(GRectangle(spanStart, ty, spanWidth, th));
+                }
+                spanStart = -1;
+            }
+        }
+    }
+    if (regions.isEmpty()) {
+        return true;
+    }
+
+    // a region is sent as one command per run of same-colored pixels in a row;
+    // if that adds up to more than the full image's base64 text, send that instead
+    long long regionCost = 0;
+    long long fullCost = 4LL * w * h;
+    for (const GRectangle& region : regions) {
+        int rx = (int) region.getX();
+        int ry = (int) region.getY();
+        int rw = (int) region.getWidth();
+        int rh = (int) region.getHeight();
+        for (int r = ry; r < ry + rh; r++) {
+            const int* row = m_pixels.rowPtr(r);
+            int runs = 1;
+            for (int c = rx + 1; c < rx + rw; c++) {
+                if (row[c] != row[c - 1]) {
+                    runs++;
+                }
+            }
+            regionCost += runs * REGION_COMMAND_COST;
+        }
+        if (regionCost >= fullCost) {
+            return false;
+        }
+    }
+
+    for (const GRectangle& region : regions) {
+        int rx = (int) region.getX();
+        int ry = (int) region.getY();
+        int rw = (int) region.getWidth();
+        int rh = (int) region.getHeight();
+        getPlatform()->gbufferedimage_updateRegion(this, m_pixels, rx, ry, rw, rh);
+    }
+    return true;
+}
+
+void GBufferedImage::sendAllPixels() const {
+    // the pixels are packed as RGB bytes and base64-encoded together,
+    // directly into the command sent to the back-end
+    getPlatform()->gbufferedimage_updateAllPixels(this, m_pixels);
+}
+
+void GBufferedImage::rehashTiles(double x, double y, double width, double height) const {
+    if (m_displayedTiles.isEmpty()) {
+        return;
+    }
+    int firstRow = (int) y / DIRTY_TILE_SIZE;
+    int lastRow = std::min((int) std::ceil(y + height), m_pixels.height()) - 1;
+    int firstCol = (int) x / DIRTY_TILE_SIZE;
+    int lastCol = std::min((int) std::ceil(x + width), m_pixels.width()) - 1;
+    for (int tr = firstRow; tr <= lastRow / DIRTY_TILE_SIZE; tr++) {
+        for (int tc = firstCol; tc <= lastCol / DIRTY_TILE_SIZE; tc++) {
+            m_displayedTiles[tr][tc] = hashTile(m_pixels, tc * DIRTY_TILE_SIZE,
+                                                tr * DIRTY_TILE_SIZE);
+        }
+    }
+}
+
+void GBufferedImage::setRGBRegion(const std::string& member, int x, int y,
+                                  int width, int height, const int* px) {
+    if (width < 0 || height < 0) {
+        error("GBufferedImage::" + member + ": width/height cannot be negative");
+    }
+    if (width == 0 || height == 0) {
+        return;
+    }
+    checkIndex(member, x, y);
+    checkIndex(member, x + width - 1, y + height - 1);
+    for (int i = 0; i < width * height; i++) {
+        if (px[i] < 0x0 || px[i] > 0xffffff) {
+            checkColor(member, px[i]);
+        }
+    }
+
+    for (int r = 0; r < height; r++) {
+        memcpy(m_pixels.rowPtr(y + r) + x, px + r * width, width * sizeof(int));
+    }
+
+    // images that are not on screen (or are already out of date) are sent in
+    // full later; large rectangles are left to syncDisplay to compare/encode
+    if (parent == NULL || m_backendStale
+            || (long long) width * height * 8 > (long long) m_pixels.width() * m_pixels.height()) {
+        markBackendStale();
+        return;
+    }
+    rehashTiles(x, y, width, height);
+    getPlatform()->gbufferedimage_updateRegion(this, m_pixels, x, y, width, height);
+}
+
+void GBufferedImage::markBackendStale() {
+    m_backendStale = true;
+    if (parent != NULL) {
+        // already on screen; the window should show the new pixels now
+        syncDisplay();
+    }
+}
+
 void GBufferedImage::init(double x, double y, double width, double height,
                           int rgb) {
     checkSize("constructor", width, height);
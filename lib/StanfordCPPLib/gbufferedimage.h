@@ -4,6 +4,15 @@
  * This file exports the GBufferedImage class for per-pixel graphics.
  *
  * @author Marty Stepp
+ * @version 2026/10/17
+ * - load reuses the pixels of files it has already decoded
+ * - added fromGrid overload that adopts a grid's pixels, toGridView
+ * - added compare for tolerant, tiled comparisons; countDiffPixels uses it
+ * @version 2026/10/16
+ * - load decodes common formats natively; back-end updates are deferred
+ *   while the image is not displayed
+ * - updates to a displayed image send only the tiles that changed
+ * - added setRGBSpan, setRGBRect
  * @version 2015/10/08
  * - bug fixes and refactoring for pixel-based functions such as fromGrid, load
  *   to help fix bugs with Base64 encoding/decoding
@@ -23,6 +32,7 @@
 #define _gbufferedimage_h
 
 #include "grid.h"
+#include "imagecompare.h"
 #include "ginteractors.h"
 #include "gobjects.h"
 #include "gtypes.h"
@@ -157,6 +167,16 @@ public:
      * color (default purple) to highlight differences between the two.
      */
     GBufferedImage* diff(GBufferedImage& image, int diffPixelColor = GBUFFEREDIMAGE_DEFAULT_DIFF_PIXEL_COLOR) const;
+
+    /*
+     * Compares this image with the given other image and returns how many
+     * pixels differ and a count and bounding box for each tile that has
+     * differences.  The options allow a per-channel tolerance and stopping
+     * once too many differences are found; see imagecompare.h.
+     * Unlike diff, no diff image is built.
+     */
+    imagecompare::Result compare(const GBufferedImage& image,
+                                 const imagecompare::Options& options = imagecompare::Options()) const;
     
     /*
      * Sets the color of every pixel in the image to the given color value.
@@ -186,6 +206,13 @@ public:
      */
     void fromGrid(const Grid<int>& grid);
 
+    /*
+     * Like fromGrid above, but takes over the given grid's pixel array
+     * rather than copying it; the grid is left empty afterward.
+     * For example: img.fromGrid(std::move(grid)) or img.fromGrid(filter(...)).
+     */
+    void fromGrid(Grid<int>&& grid);
+
     /*
      * Returns the height of the image in pixels.
      */
@@ -221,6 +248,10 @@ public:
     
     /*
      * Reads the image's contents from the given image file.
+     * PNG, JPEG, GIF, and PBM/PGM/PPM files are decoded directly by the C++
+     * library; other formats are decoded by the Java back-end.
+     * Decoded pixels are cached (see imagecache.h), so loading a file again
+     * copies them instead of decoding it, unless the file has changed.
      * Throws an error if the given file is not a valid image file.
      */
     void load(const std::string& filename);
@@ -246,15 +277,38 @@ public:
     /*
      * Sets the color of the pixel at the given x/y coordinates of the image
      * to the given value.
-     * Implementation/performance note: Each call to this method produces a
-     * call to the Java graphical back-end.  Calling this method many times
-     * in a tight loop can lead to poor performance.  If you need to fill a
+     * Implementation/performance note: While the image is displayed, each
+     * call to this method produces a call to the Java graphical back-end.
+     * Calling this method many times in a tight loop can lead to poor
+     * performance.  Changes to an image that has not been added to a window
+     * are kept locally and sent to the back-end in one batch later.  If you need to fill a
      * large rectangular region, consider calling fill or fillRegion instead.
      * Throws an error if the given x/y values are out of bounds.
      * Throws an error if the given rgb value is not a valid color.
      */
     void setRGB(double x, double y, int rgb);
     void setRGB(double x, double y, std::string rgb);
+
+    /*
+     * Sets the colors of n consecutive pixels in the given row, starting at
+     * column colStart, to the values in the array px.
+     * This is much faster than calling setRGB once per pixel: the whole span
+     * is sent to the Java back-end as one update (or, if the image is not
+     * displayed, not sent until it is).
+     * Throws an error if any part of the span is out of bounds.
+     * Throws an error if any of the given rgb values is not a valid color.
+     */
+    void setRGBSpan(int row, int colStart, const int* px, int n);
+
+    /*
+     * Sets the colors of the pixels in the rectangle (x, y) through
+     * (x + width - 1, y + height - 1) to the values in the array px, which
+     * holds width * height colors in row-major order.
+     * Like setRGBSpan, the rectangle is sent to the back-end as one update.
+     * Throws an error if any part of the rectangle is out of bounds.
+     * Throws an error if any of the given rgb values is not a valid color.
+     */
+    void setRGBRect(int x, int y, int width, int height, const int* px);
     
     /*
      * Converts this image into a grid of RGB pixels.
@@ -266,11 +320,62 @@ public:
     Grid<int> toGrid() const;
     void toGrid(Grid<int>& grid) const;
 
+    /*
+     * Returns a read-only reference to this image's own grid of RGB pixels,
+     * indexed the same way as toGrid, without copying it.
+     * The reference reflects later changes to the image, and becomes invalid
+     * when the image is destroyed.  Copy the grid (or use toGrid) if you
+     * need a snapshot that stays the same while the image changes.
+     */
+    const Grid<int>& toGridView() const;
+
+protected:
+    /*
+     * Sends any locally modified pixels to the Java back-end.
+     * Called automatically before the image is displayed or saved.
+     */
+    virtual void syncDisplay() const;
+
 private:
     double m_width;          // really, these are treated as integers
     double m_height;
     int m_backgroundColor;
     Grid<int> m_pixels;      // row-major; [y][x]
+    mutable bool m_backendStale;   // true if back-end has not seen m_pixels
+    mutable Grid<unsigned long long> m_displayedTiles;   // hashes of the tiles the
+                                                         // back-end shows, if known
+    mutable GDimension m_displayedSize;   // size of the image the back-end shows
+
+    /*
+     * Records that the back-end's copy of the pixels is out of date.
+     * If the image is already on screen, the back-end is updated immediately;
+     * otherwise the update is deferred until syncDisplay is called.
+     */
+    void markBackendStale();
+
+    /*
+     * Sends the full contents of m_pixels to the back-end.
+     */
+    void sendAllPixels() const;
+
+    /*
+     * Compares the given hashes of the current tiles against m_displayedTiles
+     * and sends only the changed tiles to the back-end.  Returns false without
+     * sending anything if a full update would be cheaper.
+     *
+     * Only one 64-bit hash is kept per 32x32 tile, or 1/512 the size of the
+     * pixels, rather than a copy of what the back-end shows.  Changed tiles
+     * are therefore sent whole.  If a changed tile's hash happened to
+     * collide with the old one, that tile would stay out of date on screen
+     * until it next changes.
+     */
+    bool sendChangedRegions(const Grid<unsigned long long>& tiles) const;
+
+    /*
+     * Updates m_displayedTiles for the tiles that overlap the given rectangle,
+     * after a change to it has been sent to the back-end directly.
+     */
+    void rehashTiles(double x, double y, double width, double height) const;
 
     /*
      * Throws an error if the given rgb value is not a valid color.
@@ -287,6 +392,12 @@ private:
      */
     void checkSize(std::string member, double width, double height) const;
 
+    /*
+     * Shared implementation of setRGBSpan and setRGBRect.
+     */
+    void setRGBRegion(const std::string& member, int x, int y, int width, int height,
+                      const int* px);
+
     /*
      * Initializes private member variables; called by all constructors.
      */
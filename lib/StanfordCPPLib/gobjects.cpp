@@ -3,6 +3,8 @@
  * ------------------
  * This file implements the gobjects.h interface.
  * 
+ * @version 2026/10/16
+ * - added syncDisplay hook, called before an object is added or drawn
  * @version 2015/10/13
  * - replaced 'fabs' with 'std::fabs'
  * @version 2015/07/05
@@ -166,6 +168,10 @@ GObject::GObject() {
     parent = NULL;
 }
 
+void GObject::syncDisplay() const {
+    // empty
+}
+
 GObject::~GObject() {
     getPlatform()->gobject_delete(this);
 }
@@ -652,6 +658,7 @@ GCompound::GCompound() {
 }
 
 void GCompound::add(GObject *gobj) {
+    gobj->syncDisplay();
     getPlatform()->gcompound_add(this, gobj);
     contents.add(gobj);
     gobj->parent = this;
@@ -335,6 +335,13 @@ protected:
 protected:
     GObject();
 
+    /*
+     * Brings the back-end's copy of this object up to date with any state
+     * that is kept locally on the C++ side.  Called just before the object
+     * is added to a compound or drawn onto a window.  Does nothing by default.
+     */
+    virtual void syncDisplay() const;
+
     friend class GArc;
     friend class GButton;
     friend class GCheckBox;
@@ -351,6 +358,7 @@ protected:
     friend class GSlider;
     friend class GTextField;
     friend class G3DRect;
+    friend class GWindow;
 };
 
 /*
@@ -4,6 +4,12 @@
  * This file exports the <code>Grid</code> class, which offers a
  * convenient abstraction for representing a two-dimensional array.
  *
+ * @version 2026/10/17
+ * - added hashCode64
+ * - added move constructor and move assignment operator
+ * - added data, rowPtr, rowSpan, stride for direct access to the elements
+ * - operator [][] skips its range checks if SPL_UNCHECKED_GRID is defined
+ * - copying a grid copies its element array with std::copy
  * @version 2015/07/05
  * - using global hashing functions rather than global variables
  * @version 2014/11/20
@@ -25,6 +31,7 @@
 #ifndef _grid_h
 #define _grid_h
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -59,6 +66,46 @@ public:
     class GridRow;
     class GridRowConst;
 
+    /*
+     * Class: Grid<ValueType>::Span<ElementType>
+     * -----------------------------------------
+     * A view of a run of consecutive elements in a grid, such as one row,
+     * as returned by <code>rowSpan</code>.  It supports range-based for
+     * loops and unchecked <code>[]</code> indexing.  A span does not own
+     * its elements and becomes invalid if the grid is resized or destroyed.
+     */
+    template <typename ElementType>
+    class Span {
+    public:
+        Span(ElementType* first, int count) : first(first), count(count) {
+            /* Empty */
+        }
+
+        ElementType* begin() const {
+            return first;
+        }
+
+        ElementType* end() const {
+            return first + count;
+        }
+
+        ElementType* data() const {
+            return first;
+        }
+
+        int size() const {
+            return count;
+        }
+
+        ElementType& operator [](int index) const {
+            return first[index];
+        }
+
+    private:
+        ElementType* first;
+        int count;
+    };
+
     /*
      * Constructor: Grid
      * Usage: Grid<ValueType> grid;
@@ -77,6 +124,20 @@ public:
     Grid(int nRows, int nCols);
     Grid(int nRows, int nCols, const ValueType& value);
 
+    /*
+     * Method: data
+     * Usage: ValueType* p = grid.data();
+     * ----------------------------------
+     * Returns a pointer to the grid's elements, which are stored
+     * contiguously in row-major order: the element at
+     * <code>row</code>/<code>col</code> is at
+     * <code>p[row * grid.stride() + col]</code>.  No bounds checking is
+     * done through the pointer.  It becomes invalid if the grid is resized,
+     * assigned to, or destroyed.  Returns NULL for a grid with no elements.
+     */
+    ValueType* data();
+    const ValueType* data() const;
+
     /*
      * Destructor: ~Grid
      * -----------------
@@ -199,6 +260,31 @@ public:
      */
     void resize(int nRows, int nCols, bool retain = false);
 
+    /*
+     * Method: rowPtr
+     * Usage: ValueType* p = grid.rowPtr(row);
+     * ---------------------------------------
+     * Returns a pointer to the first element of the given row, which is
+     * followed by the rest of the row's <code>numCols()</code> elements.
+     * Lets inner loops walk a row without the per-element range checks
+     * of <code>grid[row][col]</code>.  The row index is checked (unless
+     * <code>SPL_UNCHECKED_GRID</code> is defined); the columns are not.
+     * The pointer is invalidated in the same ways as the one from
+     * <code>data</code>.
+     */
+    ValueType* rowPtr(int row);
+    const ValueType* rowPtr(int row) const;
+
+    /*
+     * Method: rowSpan
+     * Usage: for (ValueType& value : grid.rowSpan(row)) ...
+     * -----------------------------------------------------
+     * Returns a <code>Span</code> over the elements of the given row.
+     * The row index is checked as in <code>rowPtr</code>.
+     */
+    Span<ValueType> rowSpan(int row);
+    Span<const ValueType> rowSpan(int row) const;
+
     /*
      * Method: set
      * Usage: grid.set(row, col, value);
@@ -209,6 +295,16 @@ public:
      * the grid boundaries.
      */
     void set(int row, int col, const ValueType& value);
+
+    /*
+     * Method: stride
+     * Usage: int stride = grid.stride();
+     * ----------------------------------
+     * Returns the number of elements from the start of one row to the start
+     * of the next in the storage returned by <code>data</code>.
+     * Rows are not padded, so this is equal to <code>numCols()</code>.
+     */
+    int stride() const;
     
     /*
      * Method: toString
@@ -254,6 +350,9 @@ public:
      * get or set individual elements.  This method signals an error if
      * the <code>row</code> and <code>col</code> arguments are outside
      * the grid boundaries.
+     * If <code>SPL_UNCHECKED_GRID</code> is defined when this file is
+     * included, as in release builds, these checks are skipped and an
+     * out-of-range index has undefined behavior.
      */
     GridRow operator [](int row);
     const GridRowConst operator [](int row) const;
@@ -335,7 +434,8 @@ public:
      */
     void checkIndexes(int row, int col,
                       int rowMax, int colMax,
-                      std::string prefix) const;
+                      const char* prefix) const;
+    void checkRow(int row, const char* prefix) const;
     int gridCompare(const Grid& grid2) const;
 
     /*
@@ -363,9 +463,7 @@ public:
     void deepCopy(const Grid& grid) {
         int n = grid.nRows * grid.nCols;
         elements = new ValueType[n];
-        for (int i = 0; i < n; i++) {
-            elements[i] = grid.elements[i];
-        }
+        std::copy(grid.elements, grid.elements + n, elements);
         nRows = grid.nRows;
         nCols = grid.nCols;
     }
@@ -383,6 +481,35 @@ public:
         deepCopy(src);
     }
 
+    /*
+     * Move support
+     * ------------
+     * These take over the element array of a grid that is about to be
+     * destroyed, such as a grid returned by value from a function, rather
+     * than copying it.  The moved-from grid is left empty (0x0).
+     */
+    Grid(Grid&& src)
+            : elements(src.elements),
+              nRows(src.nRows),
+              nCols(src.nCols) {
+        src.elements = NULL;
+        src.nRows = 0;
+        src.nCols = 0;
+    }
+
+    Grid& operator =(Grid&& src) {
+        if (this != &src) {
+            delete[] elements;
+            elements = src.elements;
+            nRows = src.nRows;
+            nCols = src.nCols;
+            src.elements = NULL;
+            src.nRows = 0;
+            src.nCols = 0;
+        }
+        return *this;
+    }
+
     /*
      * Iterator support
      * ----------------
@@ -455,12 +582,16 @@ public:
         }
 
         ValueType& operator [](int col) {
+#ifndef SPL_UNCHECKED_GRID
             gp->checkIndexes(row, col, gp->nRows-1, gp->nCols-1, "operator [][]");
+#endif // SPL_UNCHECKED_GRID
             return gp->elements[(row * gp->nCols) + col];
         }
 
         ValueType operator [](int col) const {
+#ifndef SPL_UNCHECKED_GRID
             gp->checkIndexes(row, col, gp->nRows-1, gp->nCols-1, "operator [][]");
+#endif // SPL_UNCHECKED_GRID
             return gp->elements[(row * gp->nCols) + col];
         }
 
@@ -487,7 +618,9 @@ public:
         }
 
         const ValueType operator [](int col) const {
+#ifndef SPL_UNCHECKED_GRID
             gp->checkIndexes(row, col, gp->nRows-1, gp->nCols-1, "operator [][]");
+#endif // SPL_UNCHECKED_GRID
             return gp->elements[(row * gp->nCols) + col];
         }
 
@@ -530,6 +663,16 @@ Grid<ValueType>::Grid(int nRows, int nCols, const ValueType& value)
     fill(value);
 }
 
+template <typename ValueType>
+ValueType* Grid<ValueType>::data() {
+    return elements;
+}
+
+template <typename ValueType>
+const ValueType* Grid<ValueType>::data() const {
+    return elements;
+}
+
 template <typename ValueType>
 Grid<ValueType>::~Grid() {
     if (elements != NULL) {
@@ -702,12 +845,49 @@ void Grid<ValueType>::resize(int nRows, int nCols, bool retain) {
     }
 }
 
+template <typename ValueType>
+ValueType* Grid<ValueType>::rowPtr(int row) {
+#ifndef SPL_UNCHECKED_GRID
+    checkRow(row, "rowPtr");
+#endif // SPL_UNCHECKED_GRID
+    return elements + row * nCols;
+}
+
+template <typename ValueType>
+const ValueType* Grid<ValueType>::rowPtr(int row) const {
+#ifndef SPL_UNCHECKED_GRID
+    checkRow(row, "rowPtr");
+#endif // SPL_UNCHECKED_GRID
+    return elements + row * nCols;
+}
+
+template <typename ValueType>
+typename Grid<ValueType>::template Span<ValueType> Grid<ValueType>::rowSpan(int row) {
+#ifndef SPL_UNCHECKED_GRID
+    checkRow(row, "rowSpan");
+#endif // SPL_UNCHECKED_GRID
+    return Span<ValueType>(elements + row * nCols, nCols);
+}
+
+template <typename ValueType>
+typename Grid<ValueType>::template Span<const ValueType> Grid<ValueType>::rowSpan(int row) const {
+#ifndef SPL_UNCHECKED_GRID
+    checkRow(row, "rowSpan");
+#endif // SPL_UNCHECKED_GRID
+    return Span<const ValueType>(elements + row * nCols, nCols);
+}
+
 template <typename ValueType>
 void Grid<ValueType>::set(int row, int col, const ValueType& value) {
     checkIndexes(row, col, nRows-1, nCols-1, "set");
     elements[(row * nCols) + col] = value;
 }
 
+template <typename ValueType>
+int Grid<ValueType>::stride() const {
+    return nCols;
+}
+
 template <typename ValueType>
 std::string Grid<ValueType>::toString() const {
     std::ostringstream os;
@@ -789,7 +969,7 @@ bool Grid<ValueType>::operator >=(const Grid& grid2) const {
 template <typename ValueType>
 void Grid<ValueType>::checkIndexes(int row, int col,
                                    int rowMax, int colMax,
-                                   std::string prefix) const {
+                                   const char* prefix) const {
     const int rowMin = 0;
     const int colMin = 0;
     if (row < rowMin || row > rowMax || col < colMin || col > colMax) {
@@ -807,6 +987,16 @@ void Grid<ValueType>::checkIndexes(int row, int col,
     }
 }
 
+template <typename ValueType>
+void Grid<ValueType>::checkRow(int row, const char* prefix) const {
+    if (row < 0 || row >= nRows) {
+        std::ostringstream out;
+        out << "Grid::" << prefix << ": row " << row
+            << " is outside of valid range [0.." << (nRows - 1) << "]";
+        error(out.str());
+    }
+}
+
 template <typename ValueType>
 int Grid<ValueType>::gridCompare(const Grid& grid2) const {
     int h1 = height();
@@ -895,6 +1085,21 @@ int hashCode(const Grid<T>& g) {
     return int(code & hashMask());
 }
 
+/*
+ * Function: hashCode64
+ * Usage: unsigned long long hash = hashCode64(grid);
+ * --------------------------------------------------
+ * Returns a 64-bit hash of the grid's size and the bytes of its elements,
+ * read many at a time (see hashCode64 in hashcode.h).  Only meaningful for
+ * grids of plain numbers, such as the pixels of an image, whose equal
+ * values have equal bytes.
+ */
+template <typename T>
+unsigned long long hashCode64(const Grid<T>& g) {
+    return hashCode64(g.data(), (size_t) g.numRows() * g.numCols() * sizeof(T),
+                      (unsigned long long) g.numRows() << 32 | (unsigned int) g.numCols());
+}
+
 /*
  * Function: randomElement
  * Usage: element = randomElement(grid);
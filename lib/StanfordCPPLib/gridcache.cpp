@@ -0,0 +1,289 @@
+/*
+ * File: gridcache.cpp
+ * -------------------
+ * This file implements the gridcache.h interface.
+ *
+ * Entries live in a list in order of use, most recent first, with a hash
+ * map from key to list position; a hit moves its entry to the front and
+ * eviction takes entries from the back.  One lock guards both.  Grids are
+ * copied in and out under the lock, which costs far less than computing
+ * them; spill files are read and written outside it.
+ *
+ * A spill file holds a magic number, the lengths and bytes of the key and
+ * version, the grid's size, and its elements as raw 32-bit integers in the
+ * machine's byte order.
+ *
+ * @since 2026/10/17
+ */
+
+#include "gridcache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+#include "hashcode.h"
+#include "profiler.h"
+
+static const char SPILL_MAGIC[8] = { 'S', 'P', 'L', 'G', 'R', 'I', 'D', '1' };
+
+static long long gridBytes(const Grid<int>& grid) {
+    return (long long) grid.numRows() * grid.numCols() * sizeof(int);
+}
+
+/* Reads a length and that many bytes into str.  Returns false if they are not there. */
+static bool readString(std::istream& input, std::string& str) {
+    int length;
+    if (!input.read((char*) &length, sizeof(length)) || length < 0 || length > (1 << 20)) {
+        return false;
+    }
+    str.assign(length, '\0');
+    return length == 0 || input.read(&str[0], length);
+}
+
+static void writeString(std::ostream& output, const std::string& str) {
+    int length = (int) str.length();
+    output.write((const char*) &length, sizeof(length));
+    output.write(str.data(), length);
+}
+
+GridCache::GridCache(const std::string& name, long long budget, const std::string& spillDir)
+        : name(name), budget(budget < 0 ? 0 : budget), spillDir(spillDir) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool GridCache::lookup(const std::string& key, const std::string& version, Grid<int>& grid) {
+    std::string dir;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::unordered_map<std::string, std::list<Entry>::iterator>::iterator found = index.find(key);
+        if (found != index.end() && found->second->version == version) {
+            entries.splice(entries.begin(), entries, found->second);
+            grid = found->second->grid;
+            stats.hits++;
+            hit = true;
+        } else {
+            if (found != index.end()) {
+                removeEntry(found->second);   // what the key names has changed since
+            }
+            stats.misses++;
+            dir = spillDir;
+        }
+    }
+    if (hit) {
+        count("hits", 1);
+        return true;
+    }
+    count("misses", 1);
+
+    if (dir.empty() || !readSpill(dir, key, version, grid)) {
+        return false;
+    }
+    int evicted;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stats.spillHits++;
+        evicted = insertEntry(key, version, grid);
+    }
+    count("spill hits", 1);
+    count("evictions", evicted);
+    return true;
+}
+
+void GridCache::store(const std::string& key, const std::string& version, const Grid<int>& grid) {
+    std::string dir;
+    int evicted;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        evicted = insertEntry(key, version, grid);
+        dir = spillDir;
+    }
+    count("evictions", evicted);
+
+    if (!dir.empty()) {
+        profiler::StageTimer timer(name + " spill");
+        if (writeSpill(dir, key, version, grid)) {
+            std::lock_guard<std::mutex> guard(lock);
+            stats.spillWrites++;
+        }
+    }
+}
+
+void GridCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+    index.clear();
+    stats.bytes = 0;
+    stats.entries = 0;
+}
+
+long long GridCache::getBudget() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return budget;
+}
+
+void GridCache::setBudget(long long bytes) {
+    int evicted;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        budget = bytes < 0 ? 0 : bytes;
+        evicted = evictToBudget();
+    }
+    count("evictions", evicted);
+}
+
+std::string GridCache::getSpillDirectory() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return spillDir;
+}
+
+void GridCache::setSpillDirectory(const std::string& dir) {
+    std::lock_guard<std::mutex> guard(lock);
+    spillDir = dir;
+}
+
+GridCache::Stats GridCache::getStats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+/* Adds n to the profiler counter for the given event, as "<name> <counter>". */
+void GridCache::count(const std::string& counter, long long n) {
+    if (n > 0 && profiler::isEnabled()) {
+        profiler::countBytes(name + " " + counter, n);
+    }
+}
+
+/*
+ * Evicts the least recently used entries until the cache is within its
+ * budget, and returns how many were evicted.  The lock must be held by the
+ * caller.
+ */
+int GridCache::evictToBudget() {
+    int evicted = 0;
+    while (stats.bytes > budget && !entries.empty()) {
+        removeEntry(--entries.end());
+        evicted++;
+    }
+    stats.evictions += evicted;
+    return evicted;
+}
+
+/*
+ * Adds the grid as the most recently used entry, replacing any other
+ * version of key.  Returns how many entries were evicted to make room.
+ * The lock must be held by the caller.
+ */
+int GridCache::insertEntry(const std::string& key, const std::string& version,
+                           const Grid<int>& grid) {
+    std::unordered_map<std::string, std::list<Entry>::iterator>::iterator found = index.find(key);
+    if (found != index.end()) {
+        removeEntry(found->second);
+    }
+    if (gridBytes(grid) > budget) {
+        return 0;
+    }
+    entries.push_front(Entry());
+    Entry& entry = entries.front();
+    entry.key = key;
+    entry.version = version;
+    entry.grid = grid;
+    index[key] = entries.begin();
+    stats.bytes += gridBytes(grid);
+    stats.entries++;
+    return evictToBudget();
+}
+
+/* Removes the given entry.  The lock must be held by the caller. */
+void GridCache::removeEntry(std::list<Entry>::iterator it) {
+    stats.bytes -= gridBytes(it->grid);
+    stats.entries--;
+    index.erase(it->key);
+    entries.erase(it);
+}
+
+/* Returns the name of the spill file for the given key in dir. */
+std::string GridCache::spillPath(const std::string& dir, const std::string& key) const {
+    unsigned long long hash = hashCode64(key.data(), key.length(),
+                                         hashCode64(name.data(), name.length()));
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016llx.splgrid", hash);
+    std::string path = dir;
+    if (!path.empty() && path[path.length() - 1] != '/' && path[path.length() - 1] != '\\') {
+        path += '/';
+    }
+    return path + filename;
+}
+
+/*
+ * Reads the spill of the given version of key from dir into grid.  Returns
+ * false, leaving grid unmodified, if there is none or it is of another
+ * version.
+ */
+bool GridCache::readSpill(const std::string& dir, const std::string& key,
+                          const std::string& version, Grid<int>& grid) const {
+    std::ifstream input(spillPath(dir, key).c_str(), std::ios::binary);
+    char magic[8];
+    std::string spilledKey;
+    std::string spilledVersion;
+    int size[2];
+    if (!input.read(magic, sizeof(magic)) || memcmp(magic, SPILL_MAGIC, sizeof(magic)) != 0
+            || !readString(input, spilledKey) || spilledKey != key
+            || !readString(input, spilledVersion) || spilledVersion != version
+            || !input.read((char*) size, sizeof(size)) || size[0] < 0 || size[1] < 0) {
+        return false;
+    }
+    // check the elements are all there before allocating room for them
+    std::streamoff start = input.tellg();
+    input.seekg(0, std::ios::end);
+    if (input.tellg() - start != (long long) size[0] * size[1] * (long long) sizeof(int)) {
+        return false;
+    }
+    input.seekg(start);
+    Grid<int> spilled(size[0], size[1]);
+    if (!input.read((char*) spilled.data(), gridBytes(spilled))) {
+        return false;
+    }
+    grid = std::move(spilled);
+    return true;
+}
+
+/*
+ * Writes the spill of the given version of key to dir.  Returns false if
+ * it could not be written.
+ */
+bool GridCache::writeSpill(const std::string& dir, const std::string& key,
+                           const std::string& version, const Grid<int>& grid) const {
+    std::string path = spillPath(dir, key);
+#ifdef _WIN32
+    std::string temp = path + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    std::string temp = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    {
+        std::ofstream output(temp.c_str(), std::ios::binary);
+        int size[2] = { grid.numRows(), grid.numCols() };
+        output.write(SPILL_MAGIC, sizeof(SPILL_MAGIC));
+        writeString(output, key);
+        writeString(output, version);
+        output.write((const char*) size, sizeof(size));
+        output.write((const char*) grid.data(), gridBytes(grid));
+        if (!output.flush()) {
+            output.close();
+            remove(temp.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    remove(path.c_str());   // rename does not replace an existing file here
+#endif
+    if (rename(temp.c_str(), path.c_str()) != 0) {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,162 @@
+/*
+ * File: gridcache.h
+ * -----------------
+ * This file exports the <code>GridCache</code> class, a cache of grids of
+ * pixels (or other ints) kept within a memory budget, with an optional
+ * directory on disk that outlives the program.  It is the storage behind
+ * the image cache (see imagecache.h) and can hold any grids that are
+ * expensive to compute, such as the results of image filters.
+ *
+ * @since 2026/10/17
+ */
+
+#ifndef _gridcache_h
+#define _gridcache_h
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "grid.h"
+
+/*
+ * Class: GridCache
+ * ----------------
+ * This class maps string keys to grids.  Each entry also has a version
+ * string, and a lookup only succeeds if the versions match, so a key
+ * can name something that changes (a file, say) and its version can tell
+ * one state of it from another.  The least recently used entries are
+ * evicted to keep the grids within the budget.
+ *
+ * If a spill directory is set, every stored grid is also written there as
+ * a raw buffer, and lookups that miss in memory read it back from there,
+ * so separate runs of a program can share them.  Each spill is a file
+ * named after a 64-bit hash of the cache's name and the key, so storing a
+ * new version replaces the old one; it starts with the key and version,
+ * which are checked before it is used.  Files are written under a
+ * temporary name and renamed into place, so another process never reads
+ * a partly written one.  Files in the directory are never removed.
+ *
+ * Hits, misses, and evictions are counted (see getStats), and also
+ * reported as counters named after the cache when profiling is on (see
+ * profiler.h).  All members may be called from any thread.
+ */
+class GridCache {
+public:
+    /*
+     * Type: Stats
+     * -----------
+     * What the cache has done so far and what it holds.  Spill hits are
+     * lookups answered from the spill directory; they are counted as
+     * misses of the memory cache as well.
+     */
+    struct Stats {
+        long long hits;
+        long long misses;
+        long long evictions;
+        long long spillHits;
+        long long spillWrites;
+        long long bytes;     // bytes of grid elements held in memory
+        int entries;
+    };
+
+    /*
+     * Constructor: GridCache
+     * Usage: GridCache cache(name, budget);
+     *        GridCache cache(name, budget, spillDir);
+     * -----------------------------------------------
+     * Creates an empty cache that keeps up to budget bytes of grids in
+     * memory, and spills to the given directory if it is not "".  The
+     * name identifies the cache in profiler counters and spill files.
+     */
+    GridCache(const std::string& name, long long budget, const std::string& spillDir = "");
+
+    /*
+     * Method: lookup
+     * Usage: if (cache.lookup(key, version, grid)) ...
+     * ------------------------------------------------
+     * If the cache holds the given version of key's grid, copies it into
+     * the given grid, resizing it, and returns true.  Otherwise returns
+     * false and leaves the grid unmodified.  A different version held in
+     * memory is removed.
+     */
+    bool lookup(const std::string& key, const std::string& version, Grid<int>& grid);
+
+    /*
+     * Method: store
+     * Usage: cache.store(key, version, grid);
+     * ---------------------------------------
+     * Records the given grid as the given version of key's grid, replacing
+     * any other version and evicting older entries as needed.  Grids larger
+     * than the whole budget are not kept in memory, but are still spilled.
+     */
+    void store(const std::string& key, const std::string& version, const Grid<int>& grid);
+
+    /*
+     * Method: clear
+     * Usage: cache.clear();
+     * ---------------------
+     * Removes every entry from memory.  The counters and the spill
+     * directory are left alone.
+     */
+    void clear();
+
+    /*
+     * Methods: getBudget, setBudget
+     * Usage: cache.setBudget(bytes);
+     * ------------------------------
+     * Get or set the most bytes of grids kept in memory.  Lowering the
+     * budget evicts entries at once; 0 keeps nothing in memory.
+     */
+    long long getBudget() const;
+    void setBudget(long long bytes);
+
+    /*
+     * Methods: getSpillDirectory, setSpillDirectory
+     * Usage: cache.setSpillDirectory(dir);
+     * ------------------------------------
+     * Get or set the directory grids are spilled to, or "" for none.  The
+     * directory must already exist.
+     */
+    std::string getSpillDirectory() const;
+    void setSpillDirectory(const std::string& dir);
+
+    /*
+     * Method: getStats
+     * Usage: GridCache::Stats stats = cache.getStats();
+     * -------------------------------------------------
+     * Returns the counters and the current size of the cache.
+     */
+    Stats getStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::string version;
+        Grid<int> grid;
+    };
+
+    std::string name;
+    mutable std::mutex lock;
+    std::list<Entry> entries;   // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    long long budget;
+    std::string spillDir;
+    Stats stats;
+
+    void count(const std::string& counter, long long n);
+    int evictToBudget();
+    int insertEntry(const std::string& key, const std::string& version, const Grid<int>& grid);
+    void removeEntry(std::list<Entry>::iterator it);
+    std::string spillPath(const std::string& dir, const std::string& key) const;
+    bool readSpill(const std::string& dir, const std::string& key, const std::string& version,
+                   Grid<int>& grid) const;
+    bool writeSpill(const std::string& dir, const std::string& key, const std::string& version,
+                    const Grid<int>& grid) const;
+
+    // forbid copying; the entries are guarded by one lock
+    GridCache(const GridCache&);
+    GridCache& operator =(const GridCache&);
+};
+
+#endif
@@ -5,6 +5,10 @@
  * to the appropriate methods in the Platform class, which is implemented
  * separately for each architecture.
  * 
+ * @version 2026/10/16
+ * - draw brings an object's back-end state up to date before drawing it
+ * - repaint sends any graphics commands still queued for the back-end;
+ *   implemented free repaint function
  * @version 2015/07/05
  * - removed static global Platform variable, replaced by getPlatform as needed
  * @version 2014/11/20
@@ -210,6 +214,7 @@ void GWindow::clearCanvas() {
 void GWindow::repaint() {
     if (isOpen()) {
         getPlatform()->gwindow_repaint(*this);
+        getPlatform()->cpplib_flushPipe();
     }
 }
 
@@ -426,6 +431,7 @@ void GWindow::draw(const GObject& gobj) {
 
 void GWindow::draw(GObject *gobj) {
     if (isOpen()) {
+        gobj->syncDisplay();
         if (!gwd || gwd->repaintImmediately) {
             getPlatform()->gwindow_draw(*this, gobj);
         } else {
@@ -436,6 +442,7 @@ void GWindow::draw(GObject *gobj) {
 
 void GWindow::draw(const GObject *gobj) {
     if (isOpen()) {
+        gobj->syncDisplay();
         if (!gwd || gwd->repaintImmediately) {
             getPlatform()->gwindow_draw(*this, gobj);
         } else {
@@ -453,6 +460,7 @@ void GWindow::draw(GObject & gobj, double x, double y) {
 void GWindow::draw(GObject *gobj, double x, double y) {
     if (isOpen()) {
         gobj->setLocation(x, y);
+        gobj->syncDisplay();
         if (!gwd || gwd->repaintImmediately) {
             getPlatform()->gwindow_draw(*this, gobj);
         } else {
@@ -547,6 +555,10 @@ GWindow::GWindow(GWindowData *gwd) {
     this->gwd = gwd;
 }
 
+void repaint() {
+    getPlatform()->cpplib_flushPipe();
+}
+
 void pause(double milliseconds) {
     if (autograder::gwindow_pause_enabled) {
         getPlatform()->gtimer_pause(milliseconds);
@@ -4,6 +4,8 @@
  * This file defines the <code>GWindow</code> class which supports
  * drawing graphical objects on the screen.
  * 
+ * @version 2026/10/16
+ * - repaint flushes graphics commands queued for the back-end
  * @version 2014/11/20
  * - added clearCanvas method
  * @version 2014/11/18
@@ -570,6 +572,8 @@ private:
  * is called automatically when the program pauses, waits for an
  * event, waits for user input on the console, or terminates.  As
  * a result, most clients never need to call repaint explicitly.
+ * Graphics commands are sent to the back-end in batches, so calling
+ * repaint makes sure that every command issued so far has been sent.
  */
 void repaint();
 
@@ -5,6 +5,8 @@
  * These functions are used by the HashMap and HashSet collections, as well as
  * by other collections that wish to be used as elements within HashMaps/Sets.
  * 
+ * @version 2026/10/17
+ * - added hashCode64 for hashing large blocks of memory such as images
  * @version 2015/07/05
  * - using global hashing functions rather than global variables
  *   (hashSeed(), hashMultiplier(), and hashMask())
@@ -13,6 +15,7 @@
 #ifndef _hashcode_h
 #define _hashcode_h
 
+#include <cstddef>
 #include <string>
 
 /*
@@ -33,6 +36,18 @@ int hashCode(const char* str);
 int hashCode(const std::string& str);
 int hashCode(void* key);
 
+/*
+ * Function: hashCode64
+ * Usage: unsigned long long hash = hashCode64(data, length, seed);
+ * ----------------------------------------------------------------
+ * Returns a 64-bit hash of the given bytes, suitable for telling large
+ * blocks of data such as images apart (for example, as cache keys).  The
+ * bytes are read 64 at a time, with SSE2 or AVX2 where the CPU has them;
+ * every version gives the same hash.  Different seeds give unrelated
+ * hashes of the same bytes.  This is not a cryptographic hash.
+ */
+unsigned long long hashCode64(const void* data, size_t length, unsigned long long seed = 0);
+
 /*
  * Constants that are used to help implement these functions
  * (see hashcode.h for example usage)
@@ -0,0 +1,132 @@
+/*
+ * File: imagecache.cpp
+ * --------------------
+ * This file implements the imagecache.h interface.
+ *
+ * The storage is a GridCache (see gridcache.h) keyed on a file's canonical
+ * path, with its modification time and size as the version, so a file that
+ * changes on disk replaces its old entry and spill rather than adding
+ * another.
+ *
+ * @version 2026/10/17
+ * - entries, eviction, and spill files moved into GridCache
+ * @since 2026/10/17
+ */
+
+#include "imagecache.h"
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "imagecodec.h"
+
+namespace imagecache {
+
+static const long long DEFAULT_BUDGET_MB = 256;
+
+static GridCache* createCache() {
+    long long budget = DEFAULT_BUDGET_MB * 1024 * 1024;
+    char* budgetMB = getenv("SPL_IMAGE_CACHE_MB");
+    if (budgetMB != NULL && budgetMB[0] != '\0' && atoll(budgetMB) >= 0) {
+        budget = atoll(budgetMB) * 1024 * 1024;
+    }
+    char* dir = getenv("SPL_IMAGE_CACHE_DIR");
+    return new GridCache("image cache", budget, dir != NULL ? dir : "");
+}
+
+/*
+ * Returns the cache.  Like the profile (see profiler.cpp), it is never
+ * freed, so that images loaded during static destruction stay safe.
+ */
+static GridCache& getCache() {
+    static GridCache* cache = createCache();
+    return *cache;
+}
+
+/*
+ * Sets path to the named file's canonical path, and version to its
+ * modification time (in nanoseconds where the platform has them) and
+ * size.  Returns false if the file cannot be found.
+ */
+static bool getFileKey(const std::string& filename, std::string& path, std::string& version) {
+    long long mtime;
+#ifdef _WIN32
+    struct _stat64 info;
+    char fullPath[_MAX_PATH];
+    if (_stat64(filename.c_str(), &info) != 0
+            || _fullpath(fullPath, filename.c_str(), _MAX_PATH) == NULL) {
+        return false;
+    }
+    path = fullPath;
+    mtime = (long long) info.st_mtime * 1000000000LL;
+#else
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return false;
+    }
+    char* fullPath = realpath(filename.c_str(), NULL);
+    if (fullPath == NULL) {
+        return false;
+    }
+    path = fullPath;
+    free(fullPath);
+    mtime = (long long) info.st_mtime * 1000000000LL;
+#  if defined(__APPLE__)
+    mtime += info.st_mtimespec.tv_nsec;
+#  elif defined(__linux__)
+    mtime += info.st_mtim.tv_nsec;
+#  endif
+#endif // _WIN32
+    version = std::to_string(mtime) + ":" + std::to_string((long long) info.st_size);
+    return true;
+}
+
+bool lookup(const std::string& filename, Grid<int>& pixels) {
+    std::string path;
+    std::string version;
+    return getFileKey(filename, path, version) && getCache().lookup(path, version, pixels);
+}
+
+void store(const std::string& filename, const Grid<int>& pixels) {
+    std::string path;
+    std::string version;
+    if (getFileKey(filename, path, version)) {
+        getCache().store(path, version, pixels);
+    }
+}
+
+bool decodeFile(const std::string& filename, Grid<int>& pixels) {
+    if (lookup(filename, pixels)) {
+        return true;
+    }
+    if (!imagecodec::decodeFile(filename, pixels)) {
+        return false;
+    }
+    store(filename, pixels);
+    return true;
+}
+
+void clear() {
+    getCache().clear();
+}
+
+long long getBudget() {
+    return getCache().getBudget();
+}
+
+void setBudget(long long bytes) {
+    getCache().setBudget(bytes);
+}
+
+std::string getSpillDirectory() {
+    return getCache().getSpillDirectory();
+}
+
+void setSpillDirectory(const std::string& dir) {
+    getCache().setSpillDirectory(dir);
+}
+
+Stats getStats() {
+    return getCache().getStats();
+}
+
+} // namespace imagecache
@@ -0,0 +1,115 @@
+/*
+ * File: imagecache.h
+ * ------------------
+ * This file exports a cache of decoded images, so that a program that
+ * opens the same file again and again (a sticker placed on several images,
+ * say) decodes it only once.  GBufferedImage::load consults it.
+ *
+ * Entries are keyed on a file's canonical path together with its
+ * modification time and size, so a file that changes on disk is decoded
+ * again.  The least recently used entries are evicted to keep the cached
+ * pixels within a memory budget, 256 MB by default, which can be changed
+ * with the SPL_IMAGE_CACHE_MB environment variable or setBudget; a budget
+ * of 0 turns the cache off.
+ *
+ * If the SPL_IMAGE_CACHE_DIR environment variable (or setSpillDirectory)
+ * names a directory, every decoded image is also written there as a raw
+ * pixel buffer, and images missing from memory are looked for there before
+ * being decoded, so separate runs of a program can share them.  Files in
+ * that directory are never removed by the cache.
+ *
+ * Hits, misses, and evictions are counted (see getStats), and are also
+ * reported as counters when profiling is on (see profiler.h).  The cache
+ * is a GridCache (see gridcache.h) named "image cache".
+ *
+ * @version 2026/10/17
+ * - Stats is GridCache::Stats
+ * @since 2026/10/17
+ */
+
+#ifndef _imagecache_h
+#define _imagecache_h
+
+#include <string>
+#include "grid.h"
+#include "gridcache.h"
+
+namespace imagecache {
+
+/*
+ * Type: Stats
+ * -----------
+ * What the cache has done so far and what it holds (see GridCache::Stats).
+ */
+typedef GridCache::Stats Stats;
+
+/*
+ * Function: lookup
+ * Usage: if (imagecache::lookup(filename, pixels)) ...
+ * ----------------------------------------------------
+ * If the cache holds the pixels of the named file as it is now on disk,
+ * copies them into the given grid, resizing it, and returns true.
+ * Otherwise returns false and leaves the grid unmodified.
+ */
+bool lookup(const std::string& filename, Grid<int>& pixels);
+
+/*
+ * Function: store
+ * Usage: imagecache::store(filename, pixels);
+ * -------------------------------------------
+ * Records the given grid as the decoded pixels of the named file, evicting
+ * older entries as needed.  Grids larger than the whole budget are not
+ * kept in memory, but are still written to the spill directory.
+ */
+void store(const std::string& filename, const Grid<int>& pixels);
+
+/*
+ * Function: decodeFile
+ * Usage: if (imagecache::decodeFile(filename, pixels)) ...
+ * --------------------------------------------------------
+ * Like imagecodec::decodeFile, but takes the pixels from the cache if it
+ * has them and stores them there if it did not.
+ */
+bool decodeFile(const std::string& filename, Grid<int>& pixels);
+
+/*
+ * Function: clear
+ * Usage: imagecache::clear();
+ * ---------------------------
+ * Removes every entry from memory.  The counters and the spill directory
+ * are left alone.
+ */
+void clear();
+
+/*
+ * Functions: getBudget, setBudget
+ * Usage: long long bytes = imagecache::getBudget();
+ *        imagecache::setBudget(bytes);
+ * ------------------------------------------------
+ * Get or set the most bytes of pixels kept in memory.  Lowering the budget
+ * evicts entries at once; 0 turns the cache off.
+ */
+long long getBudget();
+void setBudget(long long bytes);
+
+/*
+ * Functions: getSpillDirectory, setSpillDirectory
+ * Usage: imagecache::setSpillDirectory(dir);
+ * ------------------------------------------
+ * Get or set the directory decoded images are spilled to, or "" for none.
+ * The directory must already exist.
+ */
+std::string getSpillDirectory();
+void setSpillDirectory(const std::string& dir);
+
+/*
+ * Function: getStats
+ * Usage: imagecache::Stats stats = imagecache::getStats();
+ * --------------------------------------------------------
+ * Returns the counters and the current size of the cache.
+ */
+Stats getStats();
+
+} // namespace imagecache
+
+#endif
@@ -0,0 +1,2957 @@
+/*
+ * File: imagecodec.cpp
+ * --------------------
+ * This file implements the imagecodec.h interface.
+ * See that file for documentation of each member.
+ *
+ * Each decoder converts its input into a flat row-major buffer of
+ * 0xRRGGBB ints, which is then copied into the caller's grid.
+ * Malformed input is reported internally by throwing DecodeError,
+ * which the public entry points translate into a false return value.
+ *
+ * @version 2026/10/17
+ * - added RowReader and RowWriter; inflating can stop and resume, and the
+ *   DEFLATE compressor can write a stream in several blocks
+ * - added PNG and PPM encoders, with a fixed-Huffman DEFLATE compressor
+ * - decoded pixels are copied into the grid with a single memcpy
+ * @since 2026/10/16
+ */
+
+#include "imagecodec.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace imagecodec {
+
+typedef unsigned char byte;
+
+/* largest width/height accepted; matches GBufferedImage::WIDTH_HEIGHT_MAX */
+static const int MAX_DIMENSION = 65535;
+
+/* largest total number of pixels accepted, to guard against bogus headers */
+static const long long MAX_PIXELS = 1LL << 28;
+
+struct DecodeError {
+    /* empty */
+};
+
+/*
+ * A decoded image as a flat row-major array of 0xRRGGBB pixels.
+ */
+struct RawImage {
+    int width;
+    int height;
+    std::vector<int> pixels;
+
+    RawImage() : width(0), height(0) {}
+
+    void allocate(int w, int h) {
+        if (w <= 0 || h <= 0 || w > MAX_DIMENSION || h > MAX_DIMENSION
+                || (long long) w * h > MAX_PIXELS) {
+            throw DecodeError();
+        }
+        width = w;
+        height = h;
+        pixels.assign((size_t) w * h, 0);
+    }
+};
+
+static inline int rgb(int r, int g, int b) {
+    return (r << 16) | (g << 8) | b;
+}
+
+static inline int clampByte(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline int readBE16(const byte* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline unsigned int readBE32(const byte* p) {
+    return ((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16)
+            | ((unsigned int) p[2] << 8) | p[3];
+}
+
+static inline int readLE16(const byte* p) {
+    return p[0] | (p[1] << 8);
+}
+
+
+/*
+ * ===== zlib / DEFLATE decompression (RFC 1950/1951), used by PNG =====
+ */
+
+static const int INFLATE_FAST_BITS = 9;
+
+/* base values and extra bits of the length and distance codes, shared with the encoder */
+static const short LBASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short LEXT[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short DBASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577 };
+static const short DEXT[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/*
+ * Canonical Huffman decoding table.  count/symbol follow the layout used by
+ * zlib's reference 'puff' decoder; fast[] resolves codes of up to
+ * INFLATE_FAST_BITS bits with one lookup as (length << 9) | symbol.
+ */
+struct InflateHuffman {
+    short count[16];
+    short symbol[288];
+    unsigned short fast[1 << INFLATE_FAST_BITS];
+};
+
+static void buildHuffman(InflateHuffman& h, const short* lengths, int n);
+
+/*
+ * The tables for fixed-Huffman blocks, built once on first use.
+ */
+struct InflateFixedTables {
+    InflateHuffman lencode;
+    InflateHuffman distcode;
+
+    InflateFixedTables() {
+        short lengths[288];
+        int sym = 0;
+        for (; sym < 144; sym++) lengths[sym] = 8;
+        for (; sym < 256; sym++) lengths[sym] = 9;
+        for (; sym < 280; sym++) lengths[sym] = 7;
+        for (; sym < 288; sym++) lengths[sym] = 8;
+        buildHuffman(lencode, lengths, 288);
+        for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+        buildHuffman(distcode, lengths, 30);
+    }
+};
+
+/*
+ * Decompresses a DEFLATE stream, either all at once with inflate or a
+ * piece at a time with inflateSome.  The compressed input may also arrive
+ * in pieces, from the function given to setInputSource.
+ */
+class InflateStream {
+public:
+    InflateStream(const byte* data, size_t length)
+        : p(data), end(data + length), bitbuf(0), bitcnt(0), overrun(0),
+          blockType(-1), lastBlock(false), storedLeft(0), lencode(NULL), distcode(NULL) {
+        /* empty */
+    }
+
+    /*
+     * Sets the function called when the input given so far has been used
+     * up.  It should point p and end at the next piece of input and return
+     * true, or return false if there is no more.
+     */
+    void setInputSource(const std::function<bool(const byte*& p, const byte*& end)>& source) {
+        this->source = source;
+    }
+
+    void inflate(std::vector<byte>& out);
+
+    /*
+     * Appends decompressed bytes to out until it holds at least want bytes,
+     * and returns true; or returns false if the stream ends first.  Bytes
+     * may be removed from the front of out between calls, as long as the
+     * last 32K are kept for the back-references that follow.
+     */
+    bool inflateSome(std::vector<byte>& out, size_t want);
+
+private:
+    const byte* p;
+    const byte* end;
+    unsigned long long bitbuf;
+    int bitcnt;
+    int overrun;   // zero bytes fed into bitbuf after the end of input
+    std::function<bool(const byte*&, const byte*&)> source;
+
+    // the block being decompressed, kept between calls to inflateSome
+    int blockType;   // -1 between blocks
+    bool lastBlock;
+    int storedLeft;  // bytes of a stored block not yet copied
+    const InflateHuffman* lencode;
+    const InflateHuffman* distcode;
+    InflateHuffman dynamicLencode;
+    InflateHuffman dynamicDistcode;
+
+    /* Makes p < end if there is any input left, and returns whether there is. */
+    bool haveInput() {
+        while (p == end) {
+            if (!source || !source(p, end)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void refill() {
+        while (bitcnt <= 56) {
+            unsigned long long b = 0;
+            if (p < end || haveInput()) {
+                b = *p++;
+            } else if (++overrun > 16) {
+                throw DecodeError();   // read far past end of stream
+            }
+            bitbuf |= b << bitcnt;
+            bitcnt += 8;
+        }
+    }
+
+    int bits(int n) {
+        if (bitcnt < n) {
+            refill();
+        }
+        int v = (int) (bitbuf & ((1ULL << n) - 1));
+        bitbuf >>= n;
+        bitcnt -= n;
+        return v;
+    }
+
+    int decodeSymbol(const InflateHuffman& h);
+    void startBlock();
+    bool storedBlock(std::vector<byte>& out, size_t want);
+    bool codesBlock(std::vector<byte>& out, size_t want);
+    void dynamicTables();
+};
+
+static void buildHuffman(InflateHuffman& h, const short* lengths, int n) {
+    memset(h.count, 0, sizeof(h.count));
+    memset(h.fast, 0, sizeof(h.fast));
+    for (int sym = 0; sym < n; sym++) {
+        h.count[lengths[sym]]++;
+    }
+    if (h.count[0] == n) {
+        return;   // no codes; any attempt to decode will fail
+    }
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0) {
+            throw DecodeError();   // over-subscribed
+        }
+    }
+    short offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) {
+        offs[len + 1] = offs[len] + h.count[len];
+    }
+    for (int sym = 0; sym < n; sym++) {
+        if (lengths[sym] != 0) {
+            h.symbol[offs[lengths[sym]]++] = (short) sym;
+        }
+    }
+
+    // fill the fast table with bit-reversed codes (DEFLATE is LSB-first)
+    int code = 0;
+    int index = 0;
+    for (int len = 1; len < 16; len++) {
+        for (int k = 0; k < h.count[len]; k++) {
+            if (len <= INFLATE_FAST_BITS) {
+                int rev = 0;
+                for (int b = 0; b < len; b++) {
+                    rev |= ((code >> b) & 1) << (len - 1 - b);
+                }
+                unsigned short entry = (unsigned short) ((len << 9) | h.symbol[index]);
+                for (int j = rev; j < (1 << INFLATE_FAST_BITS); j += 1 << len) {
+                    h.fast[j] = entry;
+                }
+            }
+            code++;
+            index++;
+        }
+        code <<= 1;
+    }
+}
+
+int InflateStream::decodeSymbol(const InflateHuffman& h) {
+    if (bitcnt < 16) {
+        refill();
+    }
+    unsigned short entry = h.fast[bitbuf & ((1 << INFLATE_FAST_BITS) - 1)];
+    if (entry != 0) {
+        int len = entry >> 9;
+        bitbuf >>= len;
+        bitcnt -= len;
+        return entry & 0x1ff;
+    }
+
+    // slow path: walk the canonical code one bit at a time
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= bits(1);
+        int count = h.count[len];
+        if (code - count < first) {
+            return h.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    throw DecodeError();   // ran out of codes
+}
+
+/*
+ * Reads the header of the next block, and its code tables if it has any.
+ */
+void InflateStream::startBlock() {
+    static const InflateFixedTables fixed;
+    lastBlock = bits(1) != 0;
+    blockType = bits(2);
+    if (blockType == 0) {
+        // discard remaining bits in current byte
+        bits(bitcnt & 7);
+        int len = bits(16);
+        int nlen = bits(16);
+        if (len != (~nlen & 0xffff)) {
+            throw DecodeError();
+        }
+        storedLeft = len;
+    } else if (blockType == 1) {
+        lencode = &fixed.lencode;
+        distcode = &fixed.distcode;
+    } else if (blockType == 2) {
+        dynamicTables();
+        lencode = &dynamicLencode;
+        distcode = &dynamicDistcode;
+    } else {
+        throw DecodeError();
+    }
+}
+
+/*
+ * Copies the current stored block to out until out holds want bytes.
+ * Returns true once the whole block has been copied.
+ */
+bool InflateStream::storedBlock(std::vector<byte>& out, size_t want) {
+    // the block starts with the whole bytes still held in the bit buffer
+    // (other than zero padding past the end of input)
+    int buffered = std::max(0, std::min(bitcnt / 8 - overrun, storedLeft));
+    for (int i = 0; i < buffered; i++) {
+        out.push_back((byte) bits(8));
+    }
+    storedLeft -= buffered;
+    if (storedLeft == 0) {
+        return true;
+    }
+
+    // the rest is copied directly from the input
+    bitbuf = 0;
+    bitcnt = 0;
+    overrun = 0;
+    while (storedLeft > 0 && out.size() < want) {
+        if (!haveInput()) {
+            throw DecodeError();
+        }
+        size_t length = std::min((size_t) storedLeft, (size_t) (end - p));
+        out.insert(out.end(), p, p + length);
+        p += length;
+        storedLeft -= (int) length;
+    }
+    return storedLeft == 0;
+}
+
+/*
+ * Decodes the current Huffman-coded block into out until out holds want
+ * bytes.  Returns true once the end of the block has been reached.
+ */
+bool InflateStream::codesBlock(std::vector<byte>& out, size_t want) {
+    while (out.size() < want) {
+        int sym = decodeSymbol(*lencode);
+        if (sym < 256) {
+            out.push_back((byte) sym);
+        } else if (sym == 256) {
+            return true;
+        } else {
+            sym -= 257;
+            if (sym >= 29) {
+                throw DecodeError();
+            }
+            int len = LBASE[sym] + bits(LEXT[sym]);
+            int dsym = decodeSymbol(*distcode);
+            if (dsym >= 30) {
+                throw DecodeError();
+            }
+            size_t dist = DBASE[dsym] + bits(DEXT[dsym]);
+            if (dist > out.size()) {
+                throw DecodeError();
+            }
+            size_t from = out.size() - dist;
+            for (int i = 0; i < len; i++) {
+                out.push_back(out[from + i]);
+            }
+        }
+    }
+    return false;
+}
+
+void InflateStream::dynamicTables() {
+    static const short ORDER[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    int nlen = bits(5) + 257;
+    int ndist = bits(5) + 1;
+    int ncode = bits(4) + 4;
+    if (nlen > 286 || ndist > 30) {
+        throw DecodeError();
+    }
+
+    short lengths[286 + 30];
+    memset(lengths, 0, sizeof(lengths));
+    for (int i = 0; i < ncode; i++) {
+        lengths[ORDER[i]] = (short) bits(3);
+    }
+    InflateHuffman lencodeLengths;
+    buildHuffman(lencodeLengths, lengths, 19);
+
+    int index = 0;
+    while (index < nlen + ndist) {
+        int sym = decodeSymbol(lencodeLengths);
+        if (sym < 16) {
+            lengths[index++] = (short) sym;
+        } else {
+            short len = 0;
+            int repeat;
+            if (sym == 16) {
+                if (index == 0) {
+                    throw DecodeError();
+                }
+                len = lengths[index - 1];
+                repeat = 3 + bits(2);
+            } else if (sym == 17) {
+                repeat = 3 + bits(3);
+            } else {
+                repeat = 11 + bits(7);
+            }
+            if (index + repeat > nlen + ndist) {
+                throw DecodeError();
+            }
+            while (repeat-- > 0) {
+                lengths[index++] = len;
+            }
+        }
+    }
+    if (lengths[256] == 0) {
+        throw DecodeError();   // no end-of-block code
+    }
+    buildHuffman(dynamicLencode, lengths, nlen);
+    buildHuffman(dynamicDistcode, lengths + nlen, ndist);
+}
+
+bool InflateStream::inflateSome(std::vector<byte>& out, size_t want) {
+    while (out.size() < want) {
+        if (blockType < 0) {
+            if (lastBlock) {
+                return false;
+            }
+            startBlock();
+        }
+        bool blockDone = blockType == 0 ? storedBlock(out, want) : codesBlock(out, want);
+        if (blockDone) {
+            blockType = -1;
+        }
+    }
+    return true;
+}
+
+void InflateStream::inflate(std::vector<byte>& out) {
+    while (inflateSome(out, (size_t) -1)) {
+        /* empty */
+    }
+}
+
+/*
+ * Checks the 2-byte header of a zlib stream (RFC 1950).
+ */
+static void checkZlibHeader(int cmf, int flg) {
+    if ((cmf & 0x0f) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20) != 0) {
+        throw DecodeError();   // not DEFLATE, bad check bits, or preset dictionary
+    }
+}
+
+/*
+ * Decompresses a zlib stream (2-byte header, DEFLATE data, Adler-32 trailer).
+ * The checksum is not verified.
+ */
+static void zlibDecompress(const byte* data, size_t length, std::vector<byte>& out) {
+    if (length < 2) {
+        throw DecodeError();
+    }
+    checkZlibHeader(data[0], data[1]);
+    InflateStream stream(data + 2, length - 2);
+    stream.inflate(out);
+}
+
+
+/*
+ * ===== PNG =====
+ */
+
+static const byte PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+/*
+ * What the IHDR and PLTE chunks say about a PNG image.
+ */
+struct PngHeader {
+    int width;
+    int height;
+    int depth;
+    int colorType;
+    int interlace;
+    int channels;
+    int palette[256];
+    int paletteSize;
+
+    PngHeader() : width(0), height(0), depth(0), colorType(-1), interlace(0),
+                  channels(0), paletteSize(0) {}
+};
+
+/*
+ * Reads a chunk that comes before the image data into header.  Returns
+ * false for an IDAT or IEND chunk, which the caller must handle.
+ */
+static bool readPngHeaderChunk(const byte* type, const byte* body, unsigned int chunkLength,
+                               PngHeader& header) {
+    if (memcmp(type, "IHDR", 4) == 0) {
+        if (chunkLength < 13) {
+            throw DecodeError();
+        }
+        header.width = (int) readBE32(body);
+        header.height = (int) readBE32(body + 4);
+        header.depth = body[8];
+        header.colorType = body[9];
+        header.interlace = body[12];
+        if (body[10] != 0 || body[11] != 0 || header.interlace > 1) {
+            throw DecodeError();
+        }
+    } else if (memcmp(type, "PLTE", 4) == 0) {
+        header.paletteSize = std::min(256, (int) chunkLength / 3);
+        for (int i = 0; i < header.paletteSize; i++) {
+            header.palette[i] = rgb(body[i * 3], body[i * 3 + 1], body[i * 3 + 2]);
+        }
+    } else if (memcmp(type, "IDAT", 4) == 0 || memcmp(type, "IEND", 4) == 0) {
+        return false;
+    } else if (!(type[0] & 0x20)) {
+        throw DecodeError();   // unknown critical chunk
+    }
+    return true;
+}
+
+/*
+ * Checks that the header describes an image that can be decoded, and sets
+ * its number of channels.
+ */
+static void checkPngHeader(PngHeader& header) {
+    switch (header.colorType) {
+    case 0: header.channels = 1; break;
+    case 2: header.channels = 3; break;
+    case 3: header.channels = 1; break;
+    case 4: header.channels = 2; break;
+    case 6: header.channels = 4; break;
+    default: throw DecodeError();
+    }
+    int depth = header.depth;
+    int colorType = header.colorType;
+    bool validDepth = (depth == 8 || depth == 16)
+            || ((colorType == 0 || colorType == 3) && (depth == 1 || depth == 2 || depth == 4));
+    if (!validDepth || (colorType == 3 && (depth == 16 || header.paletteSize == 0))) {
+        throw DecodeError();
+    }
+}
+
+/* Returns the number of bytes in a row of pw pixels, not counting the filter byte. */
+static int pngRowBytes(const PngHeader& header, int pw) {
+    return (int) (((long long) pw * header.channels * header.depth + 7) / 8);
+}
+
+static inline int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    } else if (pb <= pc) {
+        return b;
+    } else {
+        return c;
+    }
+}
+
+/*
+ * Reverses the given PNG row filter in place on one row, 'rowBytes' long;
+ * prev is the row above after unfiltering, or NULL for the first row.
+ */
+static void pngUnfilterRow(byte* cur, const byte* prev, int filter, int rowBytes, int bpp) {
+    switch (filter) {
+    case 0:
+        break;
+    case 1:
+        for (int i = bpp; i < rowBytes; i++) {
+            cur[i] = (byte) (cur[i] + cur[i - bpp]);
+        }
+        break;
+    case 2:
+        if (prev) {
+            for (int i = 0; i < rowBytes; i++) {
+                cur[i] = (byte) (cur[i] + prev[i]);
+            }
+        }
+        break;
+    case 3:
+        for (int i = 0; i < rowBytes; i++) {
+            int left = i >= bpp ? cur[i - bpp] : 0;
+            int up = prev ? prev[i] : 0;
+            cur[i] = (byte) (cur[i] + ((left + up) >> 1));
+        }
+        break;
+    case 4:
+        for (int i = 0; i < rowBytes; i++) {
+            int left = i >= bpp ? cur[i - bpp] : 0;
+            int up = prev ? prev[i] : 0;
+            int upLeft = (prev && i >= bpp) ? prev[i - bpp] : 0;
+            cur[i] = (byte) (cur[i] + paeth(left, up, upLeft));
+        }
+        break;
+    default:
+        throw DecodeError();
+    }
+}
+
+/*
+ * Reverses the PNG row filters in place for one (sub-)image of the given
+ * number of rows, each 'rowBytes' long and preceded by a filter-type byte.
+ */
+static void pngUnfilter(byte* data, int rows, int rowBytes, int bpp) {
+    byte* prev = NULL;
+    for (int y = 0; y < rows; y++) {
+        byte* line = data + (size_t) y * (rowBytes + 1);
+        pngUnfilterRow(line + 1, prev, line[0], rowBytes, bpp);
+        prev = line + 1;
+    }
+}
+
+/*
+ * Returns sample number 'index' from an unfiltered PNG row, scaled to 0-255.
+ */
+static inline int pngSample(const byte* row, int index, int depth, bool scale) {
+    switch (depth) {
+    case 8:
+        return row[index];
+    case 16:
+        return row[index * 2];
+    default: {
+        int bit = index * depth;
+        int v = (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+        return scale ? v * 255 / ((1 << depth) - 1) : v;
+    }
+    }
+}
+
+/*
+ * Converts the pw pixels of an unfiltered row to 0xRRGGBB, storing pixel
+ * px at out[x0 + px * dx].
+ */
+static void pngRowToPixels(const PngHeader& header, const byte* row, int pw,
+                           int x0, int dx, int* out) {
+    int channels = header.channels;
+    int depth = header.depth;
+    for (int px = 0; px < pw; px++) {
+        int value;
+        if (header.colorType == 3) {
+            int index = pngSample(row, px, depth, false);
+            value = index < header.paletteSize ? header.palette[index] : 0;
+        } else if (header.colorType == 0 || header.colorType == 4) {
+            int g = pngSample(row, px * channels, depth, true);
+            value = rgb(g, g, g);
+        } else {
+            value = rgb(pngSample(row, px * channels, depth, true),
+                        pngSample(row, px * channels + 1, depth, true),
+                        pngSample(row, px * channels + 2, depth, true));
+        }
+        out[x0 + px * dx] = value;
+    }
+}
+
+static void decodePng(const byte* data, size_t length, RawImage& img) {
+    if (length < 8 || memcmp(data, PNG_SIGNATURE, 8) != 0) {
+        throw DecodeError();
+    }
+    PngHeader header;
+    std::vector<byte> compressed;
+
+    size_t pos = 8;
+    bool sawEnd = false;
+    while (!sawEnd && pos + 8 <= length) {
+        unsigned int chunkLength = readBE32(data + pos);
+        const byte* type = data + pos + 4;
+        const byte* body = data + pos + 8;
+        if (chunkLength > length - pos - 8) {
+            throw DecodeError();
+        }
+        if (!readPngHeaderChunk(type, body, chunkLength, header)) {
+            if (memcmp(type, "IDAT", 4) == 0) {
+                compressed.insert(compressed.end(), body, body + chunkLength);
+            } else {
+                sawEnd = true;
+            }
+        }
+        pos += 12 + chunkLength;
+    }
+
+    checkPngHeader(header);
+    int width = header.width;
+    int height = header.height;
+    img.allocate(width, height);
+
+    if (compressed.empty()) {
+        throw DecodeError();
+    }
+    std::vector<byte> raw;
+    raw.reserve((size_t) height * ((size_t) pngRowBytes(header, width) + 1));
+    zlibDecompress(&compressed[0], compressed.size(), raw);
+
+    int bpp = std::max(1, header.channels * header.depth / 8);
+    static const int PASS_X0[7] = { 0, 4, 0, 2, 0, 1, 0 };
+    static const int PASS_Y0[7] = { 0, 0, 4, 0, 2, 0, 1 };
+    static const int PASS_DX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+    static const int PASS_DY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+    bool interlace = header.interlace != 0;
+    int passes = interlace ? 7 : 1;
+    size_t offset = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        int x0 = interlace ? PASS_X0[pass] : 0;
+        int y0 = interlace ? PASS_Y0[pass] : 0;
+        int dx = interlace ? PASS_DX[pass] : 1;
+        int dy = interlace ? PASS_DY[pass] : 1;
+        int pw = (width - x0 + dx - 1) / dx;
+        int ph = (height - y0 + dy - 1) / dy;
+        if (pw <= 0 || ph <= 0) {
+            continue;
+        }
+        int rowBytes = pngRowBytes(header, pw);
+        size_t passBytes = (size_t) ph * (rowBytes + 1);
+        if (offset + passBytes > raw.size()) {
+            throw DecodeError();
+        }
+        byte* passData = &raw[offset];
+        pngUnfilter(passData, ph, rowBytes, bpp);
+        offset += passBytes;
+
+        for (int py = 0; py < ph; py++) {
+            const byte* row = passData + (size_t) py * (rowBytes + 1) + 1;
+            pngRowToPixels(header, row, pw, x0, dx, &img.pixels[(size_t) (y0 + py * dy) * width]);
+        }
+    }
+}
+
+
+/*
+ * ===== JPEG =====
+ */
+
+/* zig-zag position -> natural (row-major) position; padded for overruns */
+static const int JPEG_NATURAL_ORDER[64 + 16] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+};
+
+static const int JPEG_FAST_BITS = 9;
+
+struct JpegHuffman {
+    bool defined;
+    byte values[256];
+    int maxcode[18];     // largest code of each length, or -1
+    int valptr[17];      // index in values[] of first code of each length
+    int mincode[17];     // smallest code of each length
+    unsigned short fast[1 << JPEG_FAST_BITS];   // (length << 8) | value, 0 = miss
+
+    JpegHuffman() : defined(false) {}
+};
+
+struct JpegComponent {
+    int id;
+    int h;               // horizontal sampling factor
+    int v;               // vertical sampling factor
+    int tq;              // quantization table index
+    int td;              // DC Huffman table index
+    int ta;              // AC Huffman table index
+    int width;           // component size in samples (unpadded)
+    int height;
+    int blocksWide;      // component size in blocks, padded to whole MCUs
+    int blocksHigh;
+    int dcPred;
+    std::vector<byte> plane;       // decoded samples, stride blocksWide * 8
+    std::vector<short> coeffs;     // progressive mode only; 64 per block
+};
+
+class JpegDecoder {
+public:
+    JpegDecoder(const byte* data, size_t length)
+        : data(data), length(length), pos(0), p(NULL), end(NULL),
+          bitbuf(0), bitcnt(0), hitMarker(false),
+          progressive(false), frameSeen(false), restartInterval(0),
+          adobeTransform(-1), width(0), height(0), hmax(1), vmax(1),
+          mcusWide(0), mcusHigh(0), eobrun(0) {
+        memset(qtableDefined, 0, sizeof(qtableDefined));
+    }
+
+    void decode(RawImage& img);
+
+private:
+    const byte* data;
+    size_t length;
+    size_t pos;
+
+    // entropy-coded segment bit reader
+    const byte* p;
+    const byte* end;
+    unsigned int bitbuf;
+    int bitcnt;
+    bool hitMarker;
+
+    bool progressive;
+    bool frameSeen;
+    int restartInterval;
+    int adobeTransform;
+    int width;
+    int height;
+    int hmax;
+    int vmax;
+    int mcusWide;
+    int mcusHigh;
+    int eobrun;
+
+    float qtables[4][64];          // natural order, pre-scaled for the AAN IDCT
+    unsigned short qraw[4][64];    // zig-zag order, as stored in the file
+    bool qtableDefined[4];
+    JpegHuffman dcTables[4];
+    JpegHuffman acTables[4];
+    std::vector<JpegComponent> comps;
+
+    // scan parameters
+    std::vector<int> scanComps;
+    int ss;
+    int se;
+    int ah;
+    int al;
+
+    int readByte() {
+        if (pos >= length) {
+            throw DecodeError();
+        }
+        return data[pos++];
+    }
+
+    int readWord() {
+        int hi = readByte();
+        return (hi << 8) | readByte();
+    }
+
+    void fillBits() {
+        while (bitcnt <= 24) {
+            unsigned int b = 0;
+            if (!hitMarker && p < end) {
+                b = *p;
+                if (b == 0xff) {
+                    int next = (p + 1 < end) ? p[1] : 0xd9;
+                    if (next == 0x00) {
+                        p += 2;
+                    } else {
+                        hitMarker = true;
+                        b = 0;
+                    }
+                } else {
+                    p++;
+                }
+            }
+            bitbuf |= b << (24 - bitcnt);
+            bitcnt += 8;
+        }
+    }
+
+    int getBits(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        if (bitcnt < n) {
+            fillBits();
+        }
+        int v = (int) (bitbuf >> (32 - n));
+        bitbuf <<= n;
+        bitcnt -= n;
+        return v;
+    }
+
+    int getBit() {
+        return getBits(1);
+    }
+
+    /* reads an n-bit magnitude category value and sign-extends it (F.2.2.1) */
+    int receiveExtend(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        int v = getBits(n);
+        if (v < (1 << (n - 1))) {
+            v -= (1 << n) - 1;
+        }
+        return v;
+    }
+
+    int decodeHuffman(const JpegHuffman& h) {
+        if (!h.defined) {
+            throw DecodeError();
+        }
+        if (bitcnt < 16) {
+            fillBits();
+        }
+        unsigned short entry = h.fast[bitbuf >> (32 - JPEG_FAST_BITS)];
+        if (entry != 0) {
+            int len = entry >> 8;
+            bitbuf <<= len;
+            bitcnt -= len;
+            return entry & 0xff;
+        }
+        int code = 0;
+        for (int len = 1; len <= 16; len++) {
+            code = (code << 1) | getBit();
+            if (code <= h.maxcode[len]) {
+                return h.values[h.valptr[len] + code - h.mincode[len]];
+            }
+        }
+        throw DecodeError();
+    }
+
+    void resetBits() {
+        bitbuf = 0;
+        bitcnt = 0;
+        hitMarker = false;
+    }
+
+    void readFrame(int marker);
+    void readHuffmanTables(int segmentLength);
+    void readQuantizationTables(int segmentLength);
+    void readScanHeader();
+    void decodeScan();
+    void handleRestart();
+    void decodeBaselineBlock(JpegComponent& c, int bx, int by);
+    void decodeProgressiveBlock(JpegComponent& c, short* coef);
+    void idctBlock(const short* coef, const float* qt, byte* out, int stride);
+    void finishProgressive();
+    const byte* upsampleRow(const JpegComponent& c, int y, std::vector<byte>& buffer) const;
+    void convertColors(RawImage& img);
+};
+
+void JpegDecoder::readFrame(int marker) {
+    if (frameSeen) {
+        throw DecodeError();
+    }
+    frameSeen = true;
+    progressive = marker == 0xc2;
+    int segmentLength = readWord();
+    int precision = readByte();
+    height = readWord();
+    width = readWord();
+    int ncomp = readByte();
+    if (precision != 8 || (ncomp != 1 && ncomp != 3) || segmentLength != 8 + 3 * ncomp
+            || width == 0 || height == 0) {
+        throw DecodeError();   // 12-bit, CMYK, or DNL-defined height
+    }
+    comps.resize(ncomp);
+    for (int i = 0; i < ncomp; i++) {
+        JpegComponent& c = comps[i];
+        c.id = readByte();
+        int hv = readByte();
+        c.h = hv >> 4;
+        c.v = hv & 0x0f;
+        c.tq = readByte();
+        if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.tq > 3) {
+            throw DecodeError();
+        }
+        hmax = std::max(hmax, c.h);
+        vmax = std::max(vmax, c.v);
+    }
+    mcusWide = (width + 8 * hmax - 1) / (8 * hmax);
+    mcusHigh = (height + 8 * vmax - 1) / (8 * vmax);
+    for (int i = 0; i < ncomp; i++) {
+        JpegComponent& c = comps[i];
+        c.width = (width * c.h + hmax - 1) / hmax;
+        c.height = (height * c.v + vmax - 1) / vmax;
+        c.blocksWide = mcusWide * c.h;
+        c.blocksHigh = mcusHigh * c.v;
+        c.plane.assign((size_t) c.blocksWide * 8 * c.blocksHigh * 8, 0);
+        if (progressive) {
+            c.coeffs.assign((size_t) c.blocksWide * c.blocksHigh * 64, 0);
+        }
+    }
+}
+
+void JpegDecoder::readHuffmanTables(int segmentLength) {
+    int remaining = segmentLength - 2;
+    while (remaining > 0) {
+        int tc = readByte();
+        int cls = tc >> 4;
+        int id = tc & 0x0f;
+        if (cls > 1 || id > 3) {
+            throw DecodeError();
+        }
+        JpegHuffman& h = cls == 0 ? dcTables[id] : acTables[id];
+        int counts[17];
+        int total = 0;
+        for (int len = 1; len <= 16; len++) {
+            counts[len] = readByte();
+            total += counts[len];
+        }
+        if (total > 256) {
+            throw DecodeError();
+        }
+        for (int i = 0; i < total; i++) {
+            h.values[i] = (byte) readByte();
+            // 8-bit samples have DC categories of at most 11 and AC magnitudes
+            // of at most 10 (F.1.2); receiveExtend cannot shift by more
+            int magnitude = cls == 0 ? h.values[i] : (h.values[i] & 0x0f);
+            if (magnitude > (cls == 0 ? 11 : 10)) {
+                throw DecodeError();
+            }
+        }
+        remaining -= 17 + total;
+
+        // derive decoding tables (JPEG spec Annex C and F.2.2.3)
+        memset(h.fast, 0, sizeof(h.fast));
+        int code = 0;
+        int k = 0;
+        for (int len = 1; len <= 16; len++) {
+            h.valptr[len] = k;
+            h.mincode[len] = code;
+            if (code + counts[len] > (1 << len)) {
+                throw DecodeError();   // over-subscribed code lengths
+            }
+            for (int i = 0; i < counts[len]; i++) {
+                if (len <= JPEG_FAST_BITS) {
+                    int shift = JPEG_FAST_BITS - len;
+                    for (int j = 0; j < (1 << shift); j++) {
+                        h.fast[(code << shift) | j] = (unsigned short) ((len << 8) | h.values[k]);
+                    }
+                }
+                code++;
+                k++;
+            }
+            h.maxcode[len] = counts[len] ? code - 1 : -1;
+            code <<= 1;
+        }
+        h.maxcode[17] = 0x7fffffff;
+        h.defined = true;
+    }
+}
+
+void JpegDecoder::readQuantizationTables(int segmentLength) {
+    static const double AAN_SCALE[8] = {
+        1.0, 1.387039845, 1.306562965, 1.175875602,
+        1.0, 0.785694958, 0.541196100, 0.275899379 };
+    int remaining = segmentLength - 2;
+    while (remaining > 0) {
+        int pq = readByte();
+        int id = pq & 0x0f;
+        bool sixteenBit = (pq >> 4) != 0;
+        if (id > 3) {
+            throw DecodeError();
+        }
+        for (int i = 0; i < 64; i++) {
+            qraw[id][i] = (unsigned short) (sixteenBit ? readWord() : readByte());
+        }
+        for (int i = 0; i < 64; i++) {
+            int n = JPEG_NATURAL_ORDER[i];
+            qtables[id][n] = (float) (qraw[id][i] * AAN_SCALE[n >> 3] * AAN_SCALE[n & 7] / 8.0);
+        }
+        qtableDefined[id] = true;
+        remaining -= 1 + (sixteenBit ? 128 : 64);
+    }
+}
+
+void JpegDecoder::readScanHeader() {
+    int segmentLength = readWord();
+    int ns = readByte();
+    if (ns < 1 || ns > 4 || segmentLength != 6 + 2 * ns) {
+        throw DecodeError();
+    }
+    scanComps.clear();
+    for (int i = 0; i < ns; i++) {
+        int id = readByte();
+        int tables = readByte();
+        int index = -1;
+        for (int j = 0; j < (int) comps.size(); j++) {
+            if (comps[j].id == id) {
+                index = j;
+            }
+        }
+        if (index < 0) {
+            throw DecodeError();
+        }
+        comps[index].td = tables >> 4;
+        comps[index].ta = tables & 0x0f;
+        if (comps[index].td > 3 || comps[index].ta > 3) {
+            throw DecodeError();
+        }
+        scanComps.push_back(index);
+    }
+    ss = readByte();
+    se = readByte();
+    int a = readByte();
+    ah = a >> 4;
+    al = a & 0x0f;
+    if (progressive) {
+        if (ss > 63 || se > 63 || ss > se || al > 13 || (ss == 0 && se != 0)
+                || (ss > 0 && ns != 1)) {
+            throw DecodeError();
+        }
+    } else {
+        ss = 0;
+        se = 63;
+    }
+}
+
+void JpegDecoder::handleRestart() {
+    // locate the RSTn marker and continue after it
+    while (p + 1 < end && !(p[0] == 0xff && p[1] >= 0xd0 && p[1] <= 0xd7)) {
+        p++;
+    }
+    if (p + 1 < end) {
+        p += 2;
+    }
+    resetBits();
+    for (size_t i = 0; i < comps.size(); i++) {
+        comps[i].dcPred = 0;
+    }
+    eobrun = 0;
+}
+
+void JpegDecoder::decodeScan() {
+    p = data + pos;
+    end = data + length;
+    resetBits();
+    eobrun = 0;
+    for (size_t i = 0; i < comps.size(); i++) {
+        comps[i].dcPred = 0;
+    }
+
+    int restartsLeft = restartInterval;
+    if (scanComps.size() == 1) {
+        // non-interleaved: one block per MCU, covering only the real samples
+        JpegComponent& c = comps[scanComps[0]];
+        int bw = (c.width + 7) / 8;
+        int bh = (c.height + 7) / 8;
+        for (int by = 0; by < bh; by++) {
+            for (int bx = 0; bx < bw; bx++) {
+                if (restartInterval && restartsLeft == 0) {
+                    handleRestart();
+                    restartsLeft = restartInterval;
+                }
+                if (progressive) {
+                    decodeProgressiveBlock(c, &c.coeffs[((size_t) by * c.blocksWide + bx) * 64]);
+                } else {
+                    decodeBaselineBlock(c, bx, by);
+                }
+                restartsLeft--;
+            }
+        }
+    } else {
+        for (int my = 0; my < mcusHigh; my++) {
+            for (int mx = 0; mx < mcusWide; mx++) {
+                if (restartInterval && restartsLeft == 0) {
+                    handleRestart();
+                    restartsLeft = restartInterval;
+                }
+                for (size_t i = 0; i < scanComps.size(); i++) {
+                    JpegComponent& c = comps[scanComps[i]];
+                    for (int v = 0; v < c.v; v++) {
+                        for (int h = 0; h < c.h; h++) {
+                            int bx = mx * c.h + h;
+                            int by = my * c.v + v;
+                            if (progressive) {
+                                decodeProgressiveBlock(c, &c.coeffs[((size_t) by * c.blocksWide + bx) * 64]);
+                            } else {
+                                decodeBaselineBlock(c, bx, by);
+                            }
+                        }
+                    }
+                }
+                restartsLeft--;
+            }
+        }
+    }
+
+    // skip to the marker that follows the entropy-coded data
+    while (p + 1 < end && !(p[0] == 0xff && p[1] != 0x00 && p[1] != 0xff
+                            && !(p[1] >= 0xd0 && p[1] <= 0xd7))) {
+        p++;
+    }
+    pos = p - data;
+}
+
+void JpegDecoder::decodeBaselineBlock(JpegComponent& c, int bx, int by) {
+    short coef[64];
+    memset(coef, 0, sizeof(coef));
+    int t = decodeHuffman(dcTables[c.td]);
+    c.dcPred += receiveExtend(t);
+    coef[0] = (short) c.dcPred;
+    const JpegHuffman& ac = acTables[c.ta];
+    for (int k = 1; k < 64; k++) {
+        int rs = decodeHuffman(ac);
+        int r = rs >> 4;
+        int s = rs & 0x0f;
+        if (s == 0) {
+            if (r != 15) {
+                break;   // end of block
+            }
+            k += 15;
+        } else {
+            k += r;
+            coef[JPEG_NATURAL_ORDER[k]] = (short) receiveExtend(s);
+        }
+    }
+    if (!qtableDefined[c.tq]) {
+        throw DecodeError();
+    }
+    int stride = c.blocksWide * 8;
+    idctBlock(coef, qtables[c.tq], &c.plane[(size_t) by * 8 * stride + bx * 8], stride);
+}
+
+void JpegDecoder::decodeProgressiveBlock(JpegComponent& c, short* coef) {
+    if (ss == 0) {
+        // DC scan
+        if (ah == 0) {
+            int t = decodeHuffman(dcTables[c.td]);
+            c.dcPred += receiveExtend(t);
+            coef[0] = (short) (c.dcPred * (1 << al));
+        } else if (getBit()) {
+            coef[0] |= (short) (1 << al);
+        }
+        return;
+    }
+
+    const JpegHuffman& ac = acTables[c.ta];
+    if (ah == 0) {
+        // AC first pass
+        if (eobrun > 0) {
+            eobrun--;
+            return;
+        }
+        for (int k = ss; k <= se; k++) {
+            int rs = decodeHuffman(ac);
+            int r = rs >> 4;
+            int s = rs & 0x0f;
+            if (s == 0) {
+                if (r < 15) {
+                    eobrun = (1 << r) - 1;
+                    if (r) {
+                        eobrun += getBits(r);
+                    }
+                    break;
+                }
+                k += 15;
+            } else {
+                k += r;
+                coef[JPEG_NATURAL_ORDER[k]] = (short) (receiveExtend(s) * (1 << al));
+            }
+        }
+        return;
+    }
+
+    // AC refinement pass (JPEG spec G.1.2.3)
+    short p1 = (short) (1 << al);
+    short m1 = (short) -(1 << al);
+    int k = ss;
+    if (eobrun == 0) {
+        for (; k <= se; k++) {
+            int rs = decodeHuffman(ac);
+            int r = rs >> 4;
+            int s = rs & 0x0f;
+            short value = 0;
+            if (s != 0) {
+                value = getBit() ? p1 : m1;
+            } else if (r != 15) {
+                eobrun = 1 << r;
+                if (r) {
+                    eobrun += getBits(r);
+                }
+                break;
+            }
+            while (k <= se) {
+                short* z = &coef[JPEG_NATURAL_ORDER[k]];
+                if (*z != 0) {
+                    if (getBit() && (*z & p1) == 0) {
+                        *z = (short) (*z >= 0 ? *z + p1 : *z + m1);
+                    }
+                } else {
+                    if (r == 0) {
+                        break;
+                    }
+                    r--;
+                }
+                k++;
+            }
+            if (value != 0 && k <= se) {
+                coef[JPEG_NATURAL_ORDER[k]] = value;
+            }
+        }
+    }
+    if (eobrun > 0) {
+        for (; k <= se; k++) {
+            short* z = &coef[JPEG_NATURAL_ORDER[k]];
+            if (*z != 0 && getBit() && (*z & p1) == 0) {
+                *z = (short) (*z >= 0 ? *z + p1 : *z + m1);
+            }
+        }
+        eobrun--;
+    }
+}
+
+/*
+ * Dequantizes and inverse-transforms one 8x8 block of coefficients
+ * (natural order) into 8-bit samples, using the AAN floating-point
+ * algorithm as in the IJG library's jidctflt.c.
+ */
+void JpegDecoder::idctBlock(const short* coef, const float* qt, byte* out, int stride) {
+    float ws[64];
+    for (int col = 0; col < 8; col++) {
+        const short* in = coef + col;
+        const float* q = qt + col;
+        float* w = ws + col;
+        if (in[8] == 0 && in[16] == 0 && in[24] == 0 && in[32] == 0
+                && in[40] == 0 && in[48] == 0 && in[56] == 0) {
+            float dc = in[0] * q[0];
+            for (int i = 0; i < 8; i++) {
+                w[i * 8] = dc;
+            }
+            continue;
+        }
+        float tmp0 = in[0] * q[0];
+        float tmp1 = in[16] * q[16];
+        float tmp2 = in[32] * q[32];
+        float tmp3 = in[48] * q[48];
+        float tmp10 = tmp0 + tmp2;
+        float tmp11 = tmp0 - tmp2;
+        float tmp13 = tmp1 + tmp3;
+        float tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+        tmp0 = tmp10 + tmp13;
+        tmp3 = tmp10 - tmp13;
+        tmp1 = tmp11 + tmp12;
+        tmp2 = tmp11 - tmp12;
+
+        float tmp4 = in[8] * q[8];
+        float tmp5 = in[24] * q[24];
+        float tmp6 = in[40] * q[40];
+        float tmp7 = in[56] * q[56];
+        float z13 = tmp6 + tmp5;
+        float z10 = tmp6 - tmp5;
+        float z11 = tmp4 + tmp7;
+        float z12 = tmp4 - tmp7;
+        tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+        tmp6 = tmp12 - tmp7;
+        tmp5 = tmp11 - tmp6;
+        tmp4 = tmp10 + tmp5;
+
+        w[0] = tmp0 + tmp7;
+        w[56] = tmp0 - tmp7;
+        w[8] = tmp1 + tmp6;
+        w[48] = tmp1 - tmp6;
+        w[16] = tmp2 + tmp5;
+        w[40] = tmp2 - tmp5;
+        w[32] = tmp3 + tmp4;
+        w[24] = tmp3 - tmp4;
+    }
+
+    for (int row = 0; row < 8; row++) {
+        const float* w = ws + row * 8;
+        byte* o = out + row * stride;
+        float tmp10 = w[0] + w[4];
+        float tmp11 = w[0] - w[4];
+        float tmp13 = w[2] + w[6];
+        float tmp12 = (w[2] - w[6]) * 1.414213562f - tmp13;
+        float tmp0 = tmp10 + tmp13;
+        float tmp3 = tmp10 - tmp13;
+        float tmp1 = tmp11 + tmp12;
+        float tmp2 = tmp11 - tmp12;
+
+        float z13 = w[5] + w[3];
+        float z10 = w[5] - w[3];
+        float z11 = w[1] + w[7];
+        float z12 = w[1] - w[7];
+        float tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+        float tmp6 = tmp12 - tmp7;
+        float tmp5 = tmp11 - tmp6;
+        float tmp4 = tmp10 + tmp5;
+
+        o[0] = (byte) clampByte((int) lrintf(tmp0 + tmp7 + 128.0f));
+        o[7] = (byte) clampByte((int) lrintf(tmp0 - tmp7 + 128.0f));
+        o[1] = (byte) clampByte((int) lrintf(tmp1 + tmp6 + 128.0f));
+        o[6] = (byte) clampByte((int) lrintf(tmp1 - tmp6 + 128.0f));
+        o[2] = (byte) clampByte((int) lrintf(tmp2 + tmp5 + 128.0f));
+        o[5] = (byte) clampByte((int) lrintf(tmp2 - tmp5 + 128.0f));
+        o[4] = (byte) clampByte((int) lrintf(tmp3 + tmp4 + 128.0f));
+        o[3] = (byte) clampByte((int) lrintf(tmp3 - tmp4 + 128.0f));
+    }
+}
+
+void JpegDecoder::finishProgressive() {
+    for (size_t i = 0; i < comps.size(); i++) {
+        JpegComponent& c = comps[i];
+        if (!qtableDefined[c.tq]) {
+            throw DecodeError();
+        }
+        int stride = c.blocksWide * 8;
+        for (int by = 0; by < c.blocksHigh; by++) {
+            for (int bx = 0; bx < c.blocksWide; bx++) {
+                const short* coef = &c.coeffs[((size_t) by * c.blocksWide + bx) * 64];
+                idctBlock(coef, qtables[c.tq], &c.plane[(size_t) by * 8 * stride + bx * 8], stride);
+            }
+        }
+        std::vector<short>().swap(c.coeffs);
+    }
+}
+
+/*
+ * Returns row y of the component's samples at the full size of the image,
+ * upsampling them into buffer (which holds at least twice the component's
+ * width) if the component is subsampled.  Components at half the width
+ * (4:2:2), or half the width and height (4:2:0), are interpolated with the
+ * triangle filter of the IJG library's default "fancy" upsampling, as in
+ * its jdsample.c, so that images look as they do when decoded by libjpeg
+ * (as Java's ImageIO does); like that code, components at most 2 samples
+ * wide and other subsampling factors are upsampled by replication.
+ */
+const byte* JpegDecoder::upsampleRow(const JpegComponent& c, int y, std::vector<byte>& buffer) const {
+    int stride = c.blocksWide * 8;
+    const byte* in = &c.plane[(size_t) (y * c.v / vmax) * stride];
+    if (c.h == hmax && c.v == vmax) {
+        return in;
+    }
+    byte* out = &buffer[0];
+    int n = c.width;
+    if (c.h * 2 == hmax && c.v == vmax && n > 2) {
+        // each output sample is 3/4 the nearer input sample, 1/4 the farther
+        out[0] = in[0];
+        out[1] = (byte) ((in[0] * 3 + in[1] + 2) >> 2);
+        for (int i = 1; i < n - 1; i++) {
+            int near = in[i] * 3;
+            out[2 * i] = (byte) ((near + in[i - 1] + 1) >> 2);
+            out[2 * i + 1] = (byte) ((near + in[i + 1] + 2) >> 2);
+        }
+        out[2 * n - 2] = (byte) ((in[n - 1] * 3 + in[n - 2] + 1) >> 2);
+        out[2 * n - 1] = in[n - 1];
+    } else if (c.h * 2 == hmax && c.v * 2 == vmax && n > 2) {
+        // the same across, after weighting the nearer input row 3/4 and the
+        // farther 1/4; rows past the top and bottom repeat the edge rows
+        int farY = (y & 1) ? y / 2 + 1 : y / 2 - 1;
+        farY = std::max(0, std::min(c.height - 1, farY));
+        const byte* far = &c.plane[(size_t) farY * stride];
+        int sum = in[0] * 3 + far[0];
+        int next = in[1] * 3 + far[1];
+        out[0] = (byte) ((sum * 4 + 8) >> 4);
+        out[1] = (byte) ((sum * 3 + next + 7) >> 4);
+        for (int i = 1; i < n - 1; i++) {
+            int last = sum;
+            sum = next;
+            next = in[i + 1] * 3 + far[i + 1];
+            out[2 * i] = (byte) ((sum * 3 + last + 8) >> 4);
+            out[2 * i + 1] = (byte) ((sum * 3 + next + 7) >> 4);
+        }
+        out[2 * n - 2] = (byte) ((next * 3 + sum + 8) >> 4);
+        out[2 * n - 1] = (byte) ((next * 4 + 7) >> 4);
+    } else {
+        for (int x = 0; x < width; x++) {
+            out[x] = in[x * c.h / hmax];
+        }
+    }
+    return out;
+}
+
+void JpegDecoder::convertColors(RawImage& img) {
+    img.allocate(width, height);
+    if (comps.size() == 1) {
+        const JpegComponent& c = comps[0];
+        int stride = c.blocksWide * 8;
+        for (int y = 0; y < height; y++) {
+            const byte* src = &c.plane[(size_t) y * stride];
+            int* out = &img.pixels[(size_t) y * width];
+            for (int x = 0; x < width; x++) {
+                out[x] = rgb(src[x], src[x], src[x]);
+            }
+        }
+        return;
+    }
+
+    // three components: YCbCr unless an Adobe marker says otherwise
+    bool isRgb = adobeTransform == 0
+            || (comps[0].id == 'R' && comps[1].id == 'G' && comps[2].id == 'B');
+    std::vector<byte> buffer0(std::max(width, 2 * comps[0].width));
+    std::vector<byte> buffer1(std::max(width, 2 * comps[1].width));
+    std::vector<byte> buffer2(std::max(width, 2 * comps[2].width));
+    for (int y = 0; y < height; y++) {
+        const byte* row0 = upsampleRow(comps[0], y, buffer0);
+        const byte* row1 = upsampleRow(comps[1], y, buffer1);
+        const byte* row2 = upsampleRow(comps[2], y, buffer2);
+        int* out = &img.pixels[(size_t) y * width];
+        for (int x = 0; x < width; x++) {
+            int a = row0[x];
+            int b = row1[x];
+            int c = row2[x];
+            if (isRgb) {
+                out[x] = rgb(a, b, c);
+            } else {
+                // JFIF YCbCr -> RGB in 16.16 fixed point
+                int cb = b - 128;
+                int cr = c - 128;
+                int yy = (a << 16) + 32768;
+                int r = (yy + 91881 * cr) >> 16;
+                int g = (yy - 22554 * cb - 46802 * cr) >> 16;
+                int bl = (yy + 116130 * cb) >> 16;
+                out[x] = rgb(clampByte(r), clampByte(g), clampByte(bl));
+            }
+        }
+    }
+}
+
+void JpegDecoder::decode(RawImage& img) {
+    if (length < 4 || data[0] != 0xff || data[1] != 0xd8) {
+        throw DecodeError();
+    }
+    pos = 2;
+    bool sawScan = false;
+    while (pos + 1 < length) {
+        // find next marker, skipping any fill bytes
+        if (data[pos] != 0xff || data[pos + 1] == 0xff) {
+            pos++;
+            continue;
+        }
+        int marker = data[pos + 1];
+        pos += 2;
+        if (marker == 0x00 || (marker >= 0xd0 && marker <= 0xd7) || marker == 0x01) {
+            continue;   // stray stuffed byte / restart / TEM: no segment
+        }
+        if (marker == 0xd9) {
+            break;      // EOI
+        }
+        if (marker == 0xc0 || marker == 0xc1 || marker == 0xc2) {
+            readFrame(marker);
+        } else if ((marker >= 0xc3 && marker <= 0xcf) && marker != 0xc4 && marker != 0xc8
+                   && marker != 0xcc) {
+            throw DecodeError();   // lossless, hierarchical or arithmetic-coded
+        } else if (marker == 0xc4) {
+            readHuffmanTables(readWord());
+        } else if (marker == 0xdb) {
+            readQuantizationTables(readWord());
+        } else if (marker == 0xdd) {
+            readWord();
+            restartInterval = readWord();
+        } else if (marker == 0xda) {
+            if (!frameSeen) {
+                throw DecodeError();
+            }
+            readScanHeader();
+            decodeScan();
+            sawScan = true;
+        } else if (marker == 0xee) {
+            int segmentLength = readWord();
+            size_t start = pos;
+            if (segmentLength >= 14 && pos + 12 <= length
+                    && memcmp(data + pos, "Adobe", 5) == 0) {
+                adobeTransform = data[pos + 11];
+            }
+            pos = start + segmentLength - 2;
+        } else {
+            // APPn, COM, DNL, etc.: skip the segment
+            int segmentLength = readWord();
+            if (segmentLength < 2) {
+                throw DecodeError();
+            }
+            pos += segmentLength - 2;
+        }
+    }
+    if (!sawScan) {
+        throw DecodeError();
+    }
+    if (progressive) {
+        finishProgressive();
+    }
+    convertColors(img);
+}
+
+
+/*
+ * ===== GIF =====
+ */
+
+static void decodeGif(const byte* data, size_t length, RawImage& img) {
+    if (length < 13 || (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0)) {
+        throw DecodeError();
+    }
+    int globalColors[256];
+    int globalCount = 0;
+    int flags = data[10];
+    size_t pos = 13;
+    if (flags & 0x80) {
+        globalCount = 1 << ((flags & 0x07) + 1);
+        if (pos + globalCount * 3 > length) {
+            throw DecodeError();
+        }
+        for (int i = 0; i < globalCount; i++) {
+            globalColors[i] = rgb(data[pos], data[pos + 1], data[pos + 2]);
+            pos += 3;
+        }
+    }
+
+    while (pos < length) {
+        int block = data[pos++];
+        if (block == 0x21) {
+            // extension: label, then data sub-blocks
+            pos++;
+            while (pos < length && data[pos] != 0) {
+                pos += data[pos] + 1;
+            }
+            pos++;
+        } else if (block == 0x2c) {
+            if (pos + 9 > length) {
+                throw DecodeError();
+            }
+            int w = readLE16(data + pos + 4);
+            int h = readLE16(data + pos + 6);
+            int imageFlags = data[pos + 8];
+            pos += 9;
+            int localColors[256];
+            int* colors = globalColors;
+            int colorCount = globalCount;
+            if (imageFlags & 0x80) {
+                colorCount = 1 << ((imageFlags & 0x07) + 1);
+                if (pos + colorCount * 3 > length) {
+                    throw DecodeError();
+                }
+                for (int i = 0; i < colorCount; i++) {
+                    localColors[i] = rgb(data[pos], data[pos + 1], data[pos + 2]);
+                    pos += 3;
+                }
+                colors = localColors;
+            }
+            if (colorCount == 0 || pos >= length) {
+                throw DecodeError();
+            }
+            img.allocate(w, h);
+            bool interlaced = (imageFlags & 0x40) != 0;
+
+            // gather the LZW data sub-blocks
+            int minCodeSize = data[pos++];
+            if (minCodeSize < 1 || minCodeSize > 11) {
+                throw DecodeError();
+            }
+            std::vector<byte> lzw;
+            while (pos < length && data[pos] != 0) {
+                int n = data[pos];
+                if (pos + 1 + n > length) {
+                    n = (int) (length - pos - 1);
+                }
+                lzw.insert(lzw.end(), data + pos + 1, data + pos + 1 + n);
+                pos += n + 1;
+            }
+
+            // LZW decode into a flat index buffer
+            std::vector<byte> indices((size_t) w * h, 0);
+            size_t outCount = 0;
+            unsigned short prefix[4096];
+            byte suffix[4096];
+            byte firstChar[4096];
+            byte stack[4097];
+            int clearCode = 1 << minCodeSize;
+            int endCode = clearCode + 1;
+            for (int i = 0; i < clearCode; i++) {
+                prefix[i] = 0;
+                suffix[i] = (byte) i;
+                firstChar[i] = (byte) i;
+            }
+            int codeSize = minCodeSize + 1;
+            int nextCode = clearCode + 2;
+            int prev = -1;
+            unsigned int bitbuf = 0;
+            int bitcnt = 0;
+            size_t in = 0;
+            while (outCount < indices.size()) {
+                while (bitcnt < codeSize && in < lzw.size()) {
+                    bitbuf |= (unsigned int) lzw[in++] << bitcnt;
+                    bitcnt += 8;
+                }
+                if (bitcnt < codeSize) {
+                    break;   // truncated data; leave remaining pixels at index 0
+                }
+                int code = bitbuf & ((1 << codeSize) - 1);
+                bitbuf >>= codeSize;
+                bitcnt -= codeSize;
+                if (code == clearCode) {
+                    codeSize = minCodeSize + 1;
+                    nextCode = clearCode + 2;
+                    prev = -1;
+                    continue;
+                } else if (code == endCode) {
+                    break;
+                }
+                int sp = 0;
+                int cur = code;
+                if (prev < 0) {
+                    if (code >= clearCode) {
+                        throw DecodeError();
+                    }
+                } else if (code >= nextCode) {
+                    if (code > nextCode) {
+                        throw DecodeError();
+                    }
+                    stack[sp++] = firstChar[prev];   // KwKwK case
+                    cur = prev;
+                }
+                while (cur >= clearCode) {
+                    stack[sp++] = suffix[cur];
+                    cur = prefix[cur];
+                }
+                stack[sp++] = (byte) cur;
+                if (prev >= 0 && nextCode < 4096) {
+                    prefix[nextCode] = (unsigned short) prev;
+                    suffix[nextCode] = (byte) cur;
+                    firstChar[nextCode] = firstChar[prev];
+                    nextCode++;
+                    if (nextCode == (1 << codeSize) && codeSize < 12) {
+                        codeSize++;
+                    }
+                }
+                prev = code;
+                while (sp > 0 && outCount < indices.size()) {
+                    indices[outCount++] = stack[--sp];
+                }
+            }
+
+            // map indices to colors, undoing the 4-pass interlace if needed
+            static const int START[4] = { 0, 4, 2, 1 };
+            static const int STEP[4] = { 8, 8, 4, 2 };
+            int srcRow = 0;
+            for (int pass = 0; pass < (interlaced ? 4 : 1); pass++) {
+                int y0 = interlaced ? START[pass] : 0;
+                int dy = interlaced ? STEP[pass] : 1;
+                for (int y = y0; y < h; y += dy) {
+                    const byte* src = &indices[(size_t) srcRow * w];
+                    int* out = &img.pixels[(size_t) y * w];
+                    for (int x = 0; x < w; x++) {
+                        out[x] = src[x] < colorCount ? colors[src[x]] : 0;
+                    }
+                    srcRow++;
+                }
+            }
+            return;   // only the first frame is decoded
+        } else if (block == 0x3b) {
+            break;
+        } else {
+            throw DecodeError();
+        }
+    }
+    throw DecodeError();   // no image found
+}
+
+
+/*
+ * ===== PBM / PGM / PPM =====
+ */
+
+static int pnmReadInt(const byte* data, size_t length, size_t& pos) {
+    while (pos < length) {
+        if (data[pos] == '#') {
+            while (pos < length && data[pos] != '\n' && data[pos] != '\r') {
+                pos++;
+            }
+        } else if (isspace(data[pos])) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    if (pos >= length || !isdigit(data[pos])) {
+        throw DecodeError();
+    }
+    long long value = 0;
+    while (pos < length && isdigit(data[pos])) {
+        value = value * 10 + (data[pos++] - '0');
+        if (value > 0x7fffffff) {
+            throw DecodeError();
+        }
+    }
+    return (int) value;
+}
+
+static void decodePnm(const byte* data, size_t length, RawImage& img) {
+    if (length < 3 || data[0] != 'P' || data[1] < '1' || data[1] > '6') {
+        throw DecodeError();
+    }
+    int kind = data[1] - '0';
+    size_t pos = 2;
+    int w = pnmReadInt(data, length, pos);
+    int h = pnmReadInt(data, length, pos);
+    int maxval = (kind == 1 || kind == 4) ? 1 : pnmReadInt(data, length, pos);
+    if (maxval < 1 || maxval > 65535) {
+        throw DecodeError();
+    }
+    img.allocate(w, h);
+    int channels = (kind == 3 || kind == 6) ? 3 : 1;
+    bool ascii = kind <= 3;
+    if (!ascii) {
+        pos++;   // single whitespace byte after header
+    }
+    size_t count = (size_t) w * h;
+
+    if (kind == 4) {
+        size_t rowBytes = (w + 7) / 8;
+        if (pos + rowBytes * h > length) {
+            throw DecodeError();
+        }
+        for (int y = 0; y < h; y++) {
+            const byte* row = data + pos + rowBytes * y;
+            for (int x = 0; x < w; x++) {
+                bool black = (row[x >> 3] >> (7 - (x & 7))) & 1;
+                img.pixels[(size_t) y * w + x] = black ? 0 : 0xffffff;
+            }
+        }
+        return;
+    }
+
+    int bytesPerSample = maxval > 255 ? 2 : 1;
+    if (!ascii && pos + count * channels * bytesPerSample > length) {
+        throw DecodeError();
+    }
+    for (size_t i = 0; i < count; i++) {
+        int s[3];
+        for (int c = 0; c < channels; c++) {
+            int v;
+            if (kind == 1) {
+                // plain PBM digits may be packed without whitespace
+                while (pos < length && (isspace(data[pos]) || data[pos] == '#')) {
+                    if (data[pos] == '#') {
+                        while (pos < length && data[pos] != '\n') pos++;
+                    } else {
+                        pos++;
+                    }
+                }
+                if (pos >= length) {
+                    throw DecodeError();
+                }
+                v = data[pos++] == '1' ? 0 : 255;
+            } else if (ascii) {
+                v = pnmReadInt(data, length, pos);
+                v = std::min(v, maxval) * 255 / maxval;
+            } else if (bytesPerSample == 2) {
+                v = readBE16(data + pos) * 255 / maxval;
+                pos += 2;
+            } else {
+                v = data[pos++] * 255 / maxval;
+            }
+            s[c] = v;
+        }
+        img.pixels[i] = channels == 3 ? rgb(s[0], s[1], s[2]) : rgb(s[0], s[0], s[0]);
+    }
+}
+
+
+/*
+ * ===== zlib / DEFLATE compression, used by the PNG encoder =====
+ */
+
+static const int DEFLATE_WINDOW = 32768;
+static const int DEFLATE_HASH_BITS = 15;
+static const int DEFLATE_MAX_CHAIN = 32;   // candidates tried per position
+static const int DEFLATE_MIN_MATCH = 3;
+static const int DEFLATE_MAX_MATCH = 258;
+
+/*
+ * The fixed Huffman codes of RFC 1951 section 3.2.6, already bit-reversed
+ * for LSB-first output, and lookup tables from match lengths and distances
+ * to their indexes in LBASE and DBASE.
+ */
+struct DeflateCodes {
+    unsigned short litCode[288];
+    byte litBits[288];
+    unsigned short distCode[30];
+    byte lengthIndex[DEFLATE_MAX_MATCH + 1];
+    byte distIndex[512];   // see distanceIndex
+
+    DeflateCodes() {
+        for (int sym = 0; sym < 288; sym++) {
+            int code;
+            int bits;
+            if (sym < 144) {
+                code = 0x30 + sym;
+                bits = 8;
+            } else if (sym < 256) {
+                code = 0x190 + sym - 144;
+                bits = 9;
+            } else if (sym < 280) {
+                code = sym - 256;
+                bits = 7;
+            } else {
+                code = 0xc0 + sym - 280;
+                bits = 8;
+            }
+            litCode[sym] = (unsigned short) reverse(code, bits);
+            litBits[sym] = (byte) bits;
+        }
+        for (int sym = 0; sym < 30; sym++) {
+            distCode[sym] = (unsigned short) reverse(sym, 5);
+        }
+        for (int index = 0; index < 29; index++) {
+            int end = index + 1 < 29 ? LBASE[index + 1] : DEFLATE_MAX_MATCH + 1;
+            for (int len = LBASE[index]; len < end; len++) {
+                lengthIndex[len] = (byte) index;
+            }
+        }
+        for (int index = 0; index < 30; index++) {
+            int end = index + 1 < 30 ? DBASE[index + 1] : DEFLATE_WINDOW + 1;
+            for (int dist = DBASE[index]; dist < end; dist++) {
+                distIndex[slot(dist)] = (byte) index;
+            }
+        }
+    }
+
+    int distanceIndex(int dist) const {
+        return distIndex[slot(dist)];
+    }
+
+private:
+    // distances up to 256 have a slot each; longer ones share 128 per slot,
+    // which never straddles a code boundary
+    static int slot(int dist) {
+        return dist <= 256 ? dist - 1 : 256 + ((dist - 1) >> 7);
+    }
+
+    static int reverse(int code, int bits) {
+        int rev = 0;
+        for (int b = 0; b < bits; b++) {
+            rev |= ((code >> b) & 1) << (bits - 1 - b);
+        }
+        return rev;
+    }
+};
+
+/*
+ * Appends bits to a byte vector LSB-first, as DEFLATE stores them.
+ */
+class BitWriter {
+public:
+    BitWriter(std::vector<byte>& out)
+        : out(out), bitbuf(0), bitcnt(0) {
+        /* empty */
+    }
+
+    void put(unsigned int value, int n) {
+        bitbuf |= (unsigned long long) value << bitcnt;
+        bitcnt += n;
+        while (bitcnt >= 8) {
+            out.push_back((byte) bitbuf);
+            bitbuf >>= 8;
+            bitcnt -= 8;
+        }
+    }
+
+    void flush() {
+        if (bitcnt > 0) {
+            out.push_back((byte) bitbuf);
+            bitbuf = 0;
+            bitcnt = 0;
+        }
+    }
+
+private:
+    std::vector<byte>& out;
+    unsigned long long bitbuf;
+    int bitcnt;
+};
+
+static inline unsigned int deflateHash(const byte* p) {
+    unsigned int key = ((unsigned int) p[0] << 16) | (p[1] << 8) | p[2];
+    return (key * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+/*
+ * Compresses data[start, length) as one fixed-Huffman DEFLATE block,
+ * finding matches with hash chains over the last 32K of input, which may
+ * reach back before start into data that earlier blocks already hold.
+ * PNG-filtered image rows are mostly short repeats and small values, for
+ * which the fixed codes come close to dynamic ones without the cost of
+ * building them.
+ */
+static void deflateFixed(const byte* data, size_t start, size_t length, bool last,
+                         BitWriter& writer) {
+    static const DeflateCodes codes;
+    writer.put(last ? 1 : 0, 1);
+    writer.put(1, 2);   // fixed Huffman codes
+
+    std::vector<int> head(1 << DEFLATE_HASH_BITS, -1);
+    std::vector<int> prev(DEFLATE_WINDOW, -1);
+    size_t pos = start > (size_t) DEFLATE_WINDOW ? start - DEFLATE_WINDOW : 0;
+    for (; pos < start; pos++) {
+        if (pos + DEFLATE_MIN_MATCH <= length) {
+            unsigned int hash = deflateHash(data + pos);
+            prev[pos & (DEFLATE_WINDOW - 1)] = head[hash];
+            head[hash] = (int) pos;
+        }
+    }
+    while (pos < length) {
+        int bestLen = 0;
+        int bestDist = 0;
+        if (pos + DEFLATE_MIN_MATCH <= length) {
+            int maxLen = (int) std::min((size_t) DEFLATE_MAX_MATCH, length - pos);
+            const byte* current = data + pos;
+            int candidate = head[deflateHash(current)];
+            for (int chain = 0; chain < DEFLATE_MAX_CHAIN && candidate >= 0
+                    && pos - candidate <= (size_t) DEFLATE_WINDOW; chain++) {
+                const byte* match = data + candidate;
+                if (match[bestLen] == current[bestLen]) {
+                    int len = 0;
+                    while (len < maxLen && match[len] == current[len]) {
+                        len++;
+                    }
+                    if (len > bestLen) {
+                        bestLen = len;
+                        bestDist = (int) (pos - candidate);
+                        if (len == maxLen) {
+                            break;
+                        }
+                    }
+                }
+                int next = prev[candidate & (DEFLATE_WINDOW - 1)];
+                if (next >= candidate) {
+                    break;   // the slot has been reused by a newer position
+                }
+                candidate = next;
+            }
+        }
+
+        size_t advance = 1;
+        if (bestLen >= DEFLATE_MIN_MATCH) {
+            int lenIndex = codes.lengthIndex[bestLen];
+            writer.put(codes.litCode[257 + lenIndex], codes.litBits[257 + lenIndex]);
+            writer.put(bestLen - LBASE[lenIndex], LEXT[lenIndex]);
+            int distIndex = codes.distanceIndex(bestDist);
+            writer.put(codes.distCode[distIndex], 5);
+            writer.put(bestDist - DBASE[distIndex], DEXT[distIndex]);
+            advance = bestLen;
+        } else {
+            writer.put(codes.litCode[data[pos]], codes.litBits[data[pos]]);
+        }
+        // index every position passed over; the current one only after its search
+        for (size_t end = pos + advance; pos < end; pos++) {
+            if (pos + DEFLATE_MIN_MATCH <= length) {
+                unsigned int hash = deflateHash(data + pos);
+                prev[pos & (DEFLATE_WINDOW - 1)] = head[hash];
+                head[hash] = (int) pos;
+            }
+        }
+    }
+    writer.put(codes.litCode[256], codes.litBits[256]);   // end of block
+}
+
+static void writeBE32(std::vector<byte>& out, unsigned int value) {
+    out.push_back((byte) (value >> 24));
+    out.push_back((byte) (value >> 16));
+    out.push_back((byte) (value >> 8));
+    out.push_back((byte) value);
+}
+
+/*
+ * Returns the Adler-32 checksum of data appended to data whose checksum
+ * is adler (1 for no data).
+ */
+static unsigned int adler32(unsigned int adler, const byte* data, size_t length) {
+    unsigned int a = adler & 0xffff;
+    unsigned int b = adler >> 16;
+    while (length > 0) {
+        size_t run = std::min(length, (size_t) 5552);   // longest run that cannot overflow
+        length -= run;
+        while (run-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/*
+ * Appends data to out as a zlib stream (2-byte header, DEFLATE data,
+ * Adler-32 trailer).
+ */
+static void zlibCompress(const byte* data, size_t length, std::vector<byte>& out) {
+    out.push_back(0x78);   // DEFLATE with a 32K window
+    out.push_back(0x01);   // fastest level, no dictionary; check bits make 0x7801 % 31 == 0
+    BitWriter writer(out);
+    deflateFixed(data, 0, length, true, writer);
+    writer.flush();
+    writeBE32(out, adler32(1, data, length));
+}
+
+
+/*
+ * ===== PNG and PPM encoding =====
+ */
+
+struct CrcTable {
+    unsigned int entries[256];
+
+    CrcTable() {
+        for (unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+static unsigned int crc32(const byte* data, size_t length) {
+    static const CrcTable table;
+    unsigned int crc = 0xffffffffu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void writePngChunk(std::vector<byte>& out, const char* type,
+                          const std::vector<byte>& data) {
+    writeBE32(out, (unsigned int) data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    writeBE32(out, crc32(&out[start], out.size() - start));
+}
+
+/*
+ * Chooses a filter for each row of an 8-bit RGB PNG: whichever of the five
+ * PNG filters gives the smallest sum of absolute byte values, the
+ * heuristic suggested by the PNG specification.  Rows must be given in
+ * order, since each is filtered against the one before it.
+ */
+class PngRowFilter {
+public:
+    PngRowFilter(int width)
+        : width(width), rowBytes((size_t) width * 3), previous(rowBytes, 0), current(rowBytes) {
+        for (int filter = 0; filter < 5; filter++) {
+            candidates[filter].resize(rowBytes);
+        }
+    }
+
+    /*
+     * Appends the filter-type byte and the filtered bytes of the next row
+     * to out.
+     */
+    void filterRow(const int* row, std::vector<byte>& out) {
+        for (int x = 0; x < width; x++) {
+            current[3 * x] = (byte) (row[x] >> 16);
+            current[3 * x + 1] = (byte) (row[x] >> 8);
+            current[3 * x + 2] = (byte) row[x];
+        }
+        int bestFilter = 0;
+        long long bestCost = -1;
+        for (int filter = 0; filter < 5; filter++) {
+            byte* dst = &candidates[filter][0];
+            long long cost = 0;
+            for (size_t i = 0; i < rowBytes; i++) {
+                int a = i >= 3 ? current[i - 3] : 0;
+                int b = previous[i];
+                int c = i >= 3 ? previous[i - 3] : 0;
+                int predicted = 0;
+                switch (filter) {
+                    case 1: predicted = a; break;
+                    case 2: predicted = b; break;
+                    case 3: predicted = (a + b) >> 1; break;
+                    case 4: predicted = paeth(a, b, c); break;
+                }
+                dst[i] = (byte) (current[i] - predicted);
+                cost += std::abs((int) (signed char) dst[i]);
+            }
+            if (bestCost < 0 || cost < bestCost) {
+                bestCost = cost;
+                bestFilter = filter;
+            }
+        }
+        out.push_back((byte) bestFilter);
+        out.insert(out.end(), candidates[bestFilter].begin(), candidates[bestFilter].end());
+        previous.swap(current);
+    }
+
+private:
+    int width;
+    size_t rowBytes;
+    std::vector<byte> previous;
+    std::vector<byte> current;
+    std::vector<byte> candidates[5];
+};
+
+/*
+ * Appends the signature and IHDR chunk of an 8-bit RGB PNG to out.
+ */
+static void writePngHeader(std::vector<byte>& out, int width, int height) {
+    std::vector<byte> header;
+    writeBE32(header, width);
+    writeBE32(header, height);
+    header.push_back(8);   // bit depth
+    header.push_back(2);   // color type: RGB
+    header.push_back(0);   // compression method
+    header.push_back(0);   // filter method
+    header.push_back(0);   // no interlacing
+    out.insert(out.end(), PNG_SIGNATURE, PNG_SIGNATURE + 8);
+    writePngChunk(out, "IHDR", header);
+}
+
+/*
+ * Writes an 8-bit RGB PNG, its rows filtered by PngRowFilter.
+ */
+static void encodePng(const Grid<int>& pixels, std::vector<byte>& out) {
+    int width = pixels.numCols();
+    int height = pixels.numRows();
+    PngRowFilter rowFilter(width);
+    std::vector<byte> filtered;
+    filtered.reserve(((size_t) width * 3 + 1) * height);
+    for (int y = 0; y < height; y++) {
+        rowFilter.filterRow(pixels.rowPtr(y), filtered);
+    }
+
+    std::vector<byte> compressed;
+    zlibCompress(&filtered[0], filtered.size(), compressed);
+    writePngHeader(out, width, height);
+    writePngChunk(out, "IDAT", compressed);
+    writePngChunk(out, "IEND", std::vector<byte>());
+}
+
+/* Appends the header of a binary ("P6") PPM with a maximum value of 255 to out. */
+static void writePpmHeader(std::vector<byte>& out, int width, int height) {
+    std::string header = "P6\n" + std::to_string(width) + " "
+            + std::to_string(height) + "\n255\n";
+    out.insert(out.end(), header.begin(), header.end());
+}
+
+/* Appends the bytes of count rows of width pixels to a PPM's data in out. */
+static void writePpmRows(std::vector<byte>& out, const int* pixels, int width, int count) {
+    size_t length = (size_t) width * count;
+    for (size_t i = 0; i < length; i++) {
+        out.push_back((byte) (pixels[i] >> 16));
+        out.push_back((byte) (pixels[i] >> 8));
+        out.push_back((byte) pixels[i]);
+    }
+}
+
+/*
+ * Writes a binary ("P6") PPM with a maximum value of 255.
+ */
+static void encodePpm(const Grid<int>& pixels, std::vector<byte>& out) {
+    int width = pixels.numCols();
+    int height = pixels.numRows();
+    writePpmHeader(out, width, height);
+    for (int y = 0; y < height; y++) {
+        writePpmRows(out, pixels.rowPtr(y), width, 1);
+    }
+}
+
+
+/*
+ * ===== row-by-row reading and writing =====
+ */
+
+// size of the pieces in which compressed PNG data is read
+static const size_t PNG_READ_PIECE_SIZE = 64 * 1024;
+
+// filtered bytes compressed into each DEFLATE block of a PNG written row by row
+static const size_t PNG_WRITE_BLOCK_SIZE = 256 * 1024;
+
+// longest PBM/PGM/PPM header that is decoded row by row
+static const size_t PNM_MAX_HEADER = 4096;
+
+/*
+ * Checks the size of an image that is read a band at a time.  There is
+ * no limit on its number of pixels, since it is never held whole.
+ */
+static void checkStreamedSize(int width, int height) {
+    if (width <= 0 || height <= 0 || width > MAX_DIMENSION || height > MAX_DIMENSION) {
+        throw DecodeError();
+    }
+}
+
+/*
+ * Reads the rows of an image in order for RowReader.  open returns false
+ * if the file cannot be read this way, and errors are thrown as
+ * DecodeError.
+ */
+class RowSource {
+public:
+    RowSource() : width(0), height(0), rowsRead(0) {}
+    virtual ~RowSource() {}
+    virtual bool open(const std::string& filename) = 0;
+    virtual void readRows(int* pixels, int count) = 0;
+
+    int width;
+    int height;
+    int rowsRead;   // kept up to date by RowReader
+};
+
+/*
+ * Decodes the whole file when it is opened, for formats that are not
+ * decoded row by row.
+ */
+class WholeImageSource : public RowSource {
+public:
+    virtual bool open(const std::string& filename);
+
+    virtual void readRows(int* pixels, int count) {
+        memcpy(pixels, &img.pixels[(size_t) rowsRead * width], (size_t) count * width * sizeof(int));
+    }
+
+private:
+    RawImage img;
+};
+
+/*
+ * Reads binary PBM, PGM, and PPM files ("P4" through "P6") a row at a time.
+ */
+class PnmRowSource : public RowSource {
+public:
+    virtual bool open(const std::string& filename) {
+        input.open(filename.c_str(), std::ios::in | std::ios::binary);
+        byte head[PNM_MAX_HEADER];
+        input.read((char*) head, sizeof(head));
+        size_t length = (size_t) input.gcount();
+        input.clear();
+        if (length < 3 || head[0] != 'P' || head[1] < '4' || head[1] > '6' || !isspace(head[2])) {
+            return false;
+        }
+        kind = head[1] - '0';
+        size_t pos = 2;
+        width = pnmReadInt(head, length, pos);
+        height = pnmReadInt(head, length, pos);
+        maxval = kind == 4 ? 1 : pnmReadInt(head, length, pos);
+        if (pos >= length) {
+            return false;   // the header might go on past what was read
+        }
+        if (maxval < 1 || maxval > 65535) {
+            throw DecodeError();
+        }
+        checkStreamedSize(width, height);
+        bytesPerSample = maxval > 255 ? 2 : 1;
+        if (kind == 4) {
+            row.resize((width + 7) / 8);
+        } else {
+            row.resize((size_t) width * (kind == 6 ? 3 : 1) * bytesPerSample);
+        }
+        input.seekg(pos + 1);   // single whitespace byte after header
+        return (bool) input;
+    }
+
+    virtual void readRows(int* pixels, int count) {
+        for (int y = 0; y < count; y++) {
+            if (!input.read((char*) &row[0], row.size())) {
+                throw DecodeError();
+            }
+            int* out = pixels + (size_t) y * width;
+            if (kind == 4) {
+                for (int x = 0; x < width; x++) {
+                    bool black = (row[x >> 3] >> (7 - (x & 7))) & 1;
+                    out[x] = black ? 0 : 0xffffff;
+                }
+                continue;
+            }
+            int channels = kind == 6 ? 3 : 1;
+            const byte* sample = &row[0];
+            for (int x = 0; x < width; x++) {
+                int s[3];
+                for (int c = 0; c < channels; c++) {
+                    int v = bytesPerSample == 2 ? readBE16(sample) : sample[0];
+                    s[c] = v * 255 / maxval;
+                    sample += bytesPerSample;
+                }
+                out[x] = channels == 3 ? rgb(s[0], s[1], s[2]) : rgb(s[0], s[0], s[0]);
+            }
+        }
+    }
+
+private:
+    std::ifstream input;
+    int kind;
+    int maxval;
+    int bytesPerSample;
+    std::vector<byte> row;
+};
+
+/*
+ * Reads non-interlaced PNGs a row at a time.  The image data is inflated
+ * only as far as the rows asked for, keeping the last 32K of it for the
+ * back-references that may follow.
+ */
+class PngRowSource : public RowSource {
+public:
+    PngRowSource() : chunkLeft(0), sawLastChunk(false), next(0) {}
+
+    virtual bool open(const std::string& filename) {
+        input.open(filename.c_str(), std::ios::in | std::ios::binary);
+        byte signature[8];
+        if (!input.read((char*) signature, 8) || memcmp(signature, PNG_SIGNATURE, 8) != 0) {
+            return false;
+        }
+        while (true) {
+            unsigned int length;
+            byte type[4];
+            if (!readChunkHeader(length, type) || memcmp(type, "IEND", 4) == 0) {
+                return false;
+            }
+            if (memcmp(type, "IDAT", 4) == 0) {
+                chunkLeft = length;
+                break;
+            }
+            std::vector<byte> body;
+            if (memcmp(type, "IHDR", 4) == 0 || memcmp(type, "PLTE", 4) == 0) {
+                if (length > 3 * 256) {
+                    throw DecodeError();
+                }
+                body.resize(length);
+                if (length > 0 && !input.read((char*) &body[0], length)) {
+                    return false;
+                }
+            } else {
+                input.seekg(length, std::ios::cur);
+            }
+            readPngHeaderChunk(type, body.empty() ? NULL : &body[0], length, header);
+            input.seekg(4, std::ios::cur);   // CRC
+        }
+        checkPngHeader(header);
+        if (header.interlace) {
+            return false;
+        }
+        checkStreamedSize(header.width, header.height);
+        width = header.width;
+        height = header.height;
+        rowBytes = pngRowBytes(header, width);
+        bpp = std::max(1, header.channels * header.depth / 8);
+        previous.resize(rowBytes);
+        current.resize(rowBytes);
+
+        // skip the zlib header; the rest of the data is inflated as it is needed
+        piece.resize(PNG_READ_PIECE_SIZE);
+        const byte* p = NULL;
+        const byte* end = NULL;
+        byte zlibHeader[2];
+        for (int i = 0; i < 2; i++) {
+            while (p == end) {
+                if (!nextPiece(p, end)) {
+                    throw DecodeError();
+                }
+            }
+            zlibHeader[i] = *p++;
+        }
+        checkZlibHeader(zlibHeader[0], zlibHeader[1]);
+        stream.reset(new InflateStream(p, end - p));
+        stream->setInputSource([this](const byte*& p, const byte*& end) {
+            return nextPiece(p, end);
+        });
+        return true;
+    }
+
+    virtual void readRows(int* pixels, int count) {
+        for (int y = 0; y < count; y++) {
+            size_t want = next + rowBytes + 1;
+            if (inflated.size() < want && !stream->inflateSome(inflated, want)) {
+                throw DecodeError();   // image data ended early
+            }
+            memcpy(&current[0], &inflated[next + 1], rowBytes);
+            pngUnfilterRow(&current[0], rowsRead + y > 0 ? &previous[0] : NULL,
+                           inflated[next], rowBytes, bpp);
+            pngRowToPixels(header, &current[0], width, 0, 1, pixels + (size_t) y * width);
+            previous.swap(current);
+            next += rowBytes + 1;
+        }
+
+        // let go of rows that back-references can no longer reach
+        size_t drop = std::min(next, inflated.size() - std::min(inflated.size(),
+                                                                (size_t) DEFLATE_WINDOW));
+        if (drop >= PNG_READ_PIECE_SIZE) {
+            inflated.erase(inflated.begin(), inflated.begin() + drop);
+            next -= drop;
+        }
+    }
+
+private:
+    std::ifstream input;
+    PngHeader header;
+    int rowBytes;
+    int bpp;
+    unsigned int chunkLeft;          // bytes of the current IDAT chunk not yet read
+    bool sawLastChunk;
+    std::vector<byte> piece;         // compressed data being inflated
+    std::unique_ptr<InflateStream> stream;
+    std::vector<byte> inflated;      // filtered rows, starting at most 32K before next
+    size_t next;                     // index in inflated of the next row's filter byte
+    std::vector<byte> previous;      // the last row read, unfiltered
+    std::vector<byte> current;
+
+    bool readChunkHeader(unsigned int& length, byte* type) {
+        byte bytes[8];
+        if (!input.read((char*) bytes, 8)) {
+            return false;
+        }
+        length = readBE32(bytes);
+        memcpy(type, bytes + 4, 4);
+        return true;
+    }
+
+    /*
+     * Points p and end at the next piece of compressed data, moving on to
+     * the next IDAT chunk when this one is used up.  Returns false after
+     * the last IDAT chunk.
+     */
+    bool nextPiece(const byte*& p, const byte*& end) {
+        while (chunkLeft == 0) {
+            if (sawLastChunk) {
+                return false;
+            }
+            unsigned int length;
+            byte type[4];
+            input.seekg(4, std::ios::cur);   // CRC of the chunk just finished
+            if (!readChunkHeader(length, type) || memcmp(type, "IDAT", 4) != 0) {
+                sawLastChunk = true;
+                return false;
+            }
+            chunkLeft = length;
+        }
+        size_t size = std::min((size_t) chunkLeft, PNG_READ_PIECE_SIZE);
+        if (!input.read((char*) &piece[0], size)) {
+            throw DecodeError();
+        }
+        chunkLeft -= (unsigned int) size;
+        p = &piece[0];
+        end = p + size;
+        return true;
+    }
+};
+
+/*
+ * Writes the rows of an image in order for RowWriter.
+ */
+class RowSink {
+public:
+    RowSink(int width, int height) : width(width), height(height), rowsWritten(0) {}
+    virtual ~RowSink() {}
+
+    /* Creates the file and writes whatever comes before the rows. */
+    virtual bool open(const std::string& filename) {
+        output.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        return (bool) output;
+    }
+
+    virtual void writeRows(const int* pixels, int count) = 0;
+
+    /* Writes whatever comes after the last row. */
+    virtual void finish() = 0;
+
+    std::ofstream output;
+    int width;
+    int height;
+    int rowsWritten;   // kept up to date by RowWriter
+
+protected:
+    void write(const std::vector<byte>& bytes) {
+        if (!bytes.empty()) {
+            output.write((const char*) &bytes[0], bytes.size());
+        }
+    }
+};
+
+class PpmRowSink : public RowSink {
+public:
+    PpmRowSink(int width, int height) : RowSink(width, height) {}
+
+    virtual bool open(const std::string& filename) {
+        if (!RowSink::open(filename)) {
+            return false;
+        }
+        std::vector<byte> header;
+        writePpmHeader(header, width, height);
+        write(header);
+        return (bool) output;
+    }
+
+    virtual void writeRows(const int* pixels, int count) {
+        std::vector<byte> bytes;
+        bytes.reserve((size_t) width * count * 3);
+        writePpmRows(bytes, pixels, width, count);
+        write(bytes);
+    }
+
+    virtual void finish() {
+        /* empty */
+    }
+};
+
+/*
+ * Writes an 8-bit RGB PNG like encodePng, compressing its filtered rows
+ * in blocks of PNG_WRITE_BLOCK_SIZE bytes.  Each block can refer back
+ * into the 32K before it, so the file comes out almost as small as if the
+ * rows were compressed all at once, and is written out as IDAT chunks as
+ * it goes.
+ */
+class PngRowSink : public RowSink {
+public:
+    PngRowSink(int width, int height)
+        : RowSink(width, height), rowFilter(width), compressedUpTo(0),
+          writer(compressed), adler(1) {
+        /* empty */
+    }
+
+    virtual bool open(const std::string& filename) {
+        if (!RowSink::open(filename)) {
+            return false;
+        }
+        std::vector<byte> header;
+        writePngHeader(header, width, height);
+        write(header);
+        compressed.push_back(0x78);   // zlib header, as in zlibCompress
+        compressed.push_back(0x01);
+        return (bool) output;
+    }
+
+    virtual void writeRows(const int* pixels, int count) {
+        for (int y = 0; y < count; y++) {
+            rowFilter.filterRow(pixels + (size_t) y * width, filtered);
+            if (filtered.size() - compressedUpTo >= PNG_WRITE_BLOCK_SIZE) {
+                compressBlock(false);
+            }
+        }
+    }
+
+    virtual void finish() {
+        compressBlock(true);
+        std::vector<byte> end;
+        writePngChunk(end, "IEND", std::vector<byte>());
+        write(end);
+    }
+
+private:
+    PngRowFilter rowFilter;
+    std::vector<byte> filtered;     // rows to compress, after up to 32K already compressed
+    size_t compressedUpTo;          // filtered[0, compressedUpTo) is already compressed
+    std::vector<byte> compressed;   // compressed data not yet written
+    BitWriter writer;               // appends to compressed
+    unsigned int adler;             // checksum of every filtered byte so far
+
+    void compressBlock(bool last) {
+        adler = adler32(adler, filtered.data() + compressedUpTo, filtered.size() - compressedUpTo);
+        deflateFixed(filtered.data(), compressedUpTo, filtered.size(), last, writer);
+        if (last) {
+            writer.flush();
+            writeBE32(compressed, adler);
+        }
+        size_t keep = std::min(filtered.size(), (size_t) DEFLATE_WINDOW);
+        filtered.erase(filtered.begin(), filtered.end() - keep);
+        compressedUpTo = filtered.size();
+
+        std::vector<byte> chunk;
+        writePngChunk(chunk, "IDAT", compressed);
+        write(chunk);
+        compressed.clear();
+    }
+};
+
+
+/*
+ * ===== public interface =====
+ */
+
+static void copyToGrid(const RawImage& img, Grid<int>& pixels) {
+    pixels.resize(img.height, img.width);
+    if (!img.pixels.empty()) {
+        memcpy(pixels.data(), &img.pixels[0], img.pixels.size() * sizeof(int));
+    }
+}
+
+/*
+ * Decodes an image file in any supported format into img.  Returns false
+ * if it is not in a supported format or is damaged.
+ */
+static bool decodeRaw(const byte* data, int length, RawImage& img) {
+    if (data == NULL || length < 4) {
+        return false;
+    }
+    try {
+        if (length >= 8 && memcmp(data, PNG_SIGNATURE, 8) == 0) {
+            decodePng(data, length, img);
+        } else if (data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff) {
+            JpegDecoder decoder(data, length);
+            decoder.decode(img);
+        } else if (memcmp(data, "GIF8", 4) == 0) {
+            decodeGif(data, length, img);
+        } else if (data[0] == 'P' && data[1] >= '1' && data[1] <= '6' && isspace(data[2])) {
+            decodePnm(data, length, img);
+        } else {
+            return false;
+        }
+    } catch (const DecodeError&) {
+        return false;
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    return true;
+}
+
+/* Reads the whole file with the given name into bytes, returning true on success. */
+static bool readFile(const std::string& filename, std::vector<byte>& bytes) {
+    std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!input) {
+        return false;
+    }
+    input.seekg(0, std::ios::end);
+    std::streamoff size = input.tellg();
+    if (size <= 0 || size > 0x7fffffff) {
+        return false;
+    }
+    input.seekg(0, std::ios::beg);
+    bytes.resize((size_t) size);
+    return (bool) input.read((char*) &bytes[0], size);
+}
+
+/*
+ * Returns the lowercase extension of filename, without its dot, or "" if
+ * it has none.
+ */
+static std::string getFormat(const std::string& filename) {
+    size_t dot = filename.rfind('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return "";
+    }
+    std::string format = filename.substr(dot + 1);
+    for (size_t i = 0; i < format.length(); i++) {
+        format[i] = (char) tolower(format[i]);
+    }
+    return format;
+}
+
+bool WholeImageSource::open(const std::string& filename) {
+    std::vector<byte> bytes;
+    if (!readFile(filename, bytes) || !decodeRaw(&bytes[0], (int) bytes.size(), img)) {
+        return false;
+    }
+    width = img.width;
+    height = img.height;
+    return true;
+}
+
+bool decode(const unsigned char* data, int length, Grid<int>& pixels) {
+    RawImage img;
+    if (!decodeRaw(data, length, img)) {
+        return false;
+    }
+    copyToGrid(img, pixels);
+    return true;
+}
+
+bool decodeFile(const std::string& filename, Grid<int>& pixels) {
+    std::vector<byte> bytes;
+    return readFile(filename, bytes) && decode(&bytes[0], (int) bytes.size(), pixels);
+}
+
+bool encode(const Grid<int>& pixels, const std::string& format,
+            std::vector<unsigned char>& out) {
+    if (pixels.isEmpty()) {
+        return false;
+    }
+    std::string lower = format;
+    for (size_t i = 0; i < lower.length(); i++) {
+        lower[i] = (char) tolower(lower[i]);
+    }
+    std::vector<byte> bytes;
+    try {
+        if (lower == "png") {
+            encodePng(pixels, bytes);
+        } else if (lower == "ppm" || lower == "pnm") {
+            encodePpm(pixels, bytes);
+        } else {
+            return false;
+        }
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    out.insert(out.end(), bytes.begin(), bytes.end());
+    return true;
+}
+
+bool encodeFile(const std::string& filename, const Grid<int>& pixels) {
+    std::string format = getFormat(filename);
+    std::vector<byte> bytes;
+    if (format.empty() || !encode(pixels, format, bytes)) {
+        return false;
+    }
+    std::ofstream output(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!output) {
+        return false;
+    }
+    output.write((const char*) &bytes[0], bytes.size());
+    return (bool) output.flush();
+}
+
+/*
+ * Returns the given source if it can open the file, or else deletes it
+ * and returns NULL.
+ */
+static RowSource* tryOpen(RowSource* source, const std::string& filename) {
+    bool opened;
+    try {
+        opened = source->open(filename);
+    } catch (const DecodeError&) {
+        opened = false;
+    } catch (const std::bad_alloc&) {
+        opened = false;
+    }
+    if (!opened) {
+        delete source;
+        return NULL;
+    }
+    return source;
+}
+
+RowReader::RowReader()
+        : source(NULL) {
+    /* empty */
+}
+
+RowReader::~RowReader() {
+    close();
+}
+
+bool RowReader::open(const std::string& filename) {
+    close();
+    source = tryOpen(new PngRowSource(), filename);
+    if (!source) {
+        source = tryOpen(new PnmRowSource(), filename);
+    }
+    if (!source) {
+        source = tryOpen(new WholeImageSource(), filename);
+    }
+    return source != NULL;
+}
+
+int RowReader::getWidth() const {
+    return source ? source->width : 0;
+}
+
+int RowReader::getHeight() const {
+    return source ? source->height : 0;
+}
+
+bool RowReader::readRows(int* pixels, int count) {
+    if (!source || count < 0 || count > source->height - source->rowsRead) {
+        return false;
+    }
+    try {
+        source->readRows(pixels, count);
+    } catch (const DecodeError&) {
+        return false;
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    source->rowsRead += count;
+    return true;
+}
+
+void RowReader::close() {
+    delete source;
+    source = NULL;
+}
+
+RowWriter::RowWriter()
+        : sink(NULL) {
+    /* empty */
+}
+
+RowWriter::~RowWriter() {
+    close();
+}
+
+bool RowWriter::open(const std::string& filename, int width, int height) {
+    close();
+    std::string format = getFormat(filename);
+    if (width <= 0 || height <= 0) {
+        return false;
+    } else if (format == "png") {
+        sink = new PngRowSink(width, height);
+    } else if (format == "ppm" || format == "pnm") {
+        sink = new PpmRowSink(width, height);
+    } else {
+        return false;
+    }
+    if (!sink->open(filename)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool RowWriter::writeRows(const int* pixels, int count) {
+    if (!sink || count < 0 || count > sink->height - sink->rowsWritten) {
+        return false;
+    }
+    try {
+        sink->writeRows(pixels, count);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    sink->rowsWritten += count;
+    return (bool) sink->output;
+}
+
+bool RowWriter::close() {
+    if (!sink) {
+        return false;
+    }
+    bool complete = sink->rowsWritten == sink->height;
+    if (complete) {
+        try {
+            sink->finish();
+        } catch (const std::bad_alloc&) {
+            complete = false;
+        }
+    }
+    sink->output.close();
+    complete = complete && !sink->output.fail();
+    delete sink;
+    sink = NULL;
+    return complete;
+}
+
+} // namespace imagecodec
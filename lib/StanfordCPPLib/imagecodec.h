@@ -0,0 +1,172 @@
+/*
+ * File: imagecodec.h
+ * ------------------
+ * This file declares functions for decoding common image file formats
+ * directly in the C++ process, without a round trip through the Java
+ * back-end.  Decoded pixels use the same 0xRRGGBB integer representation
+ * as <code>GBufferedImage</code>, so they can be placed straight into an
+ * image's pixel grid.
+ *
+ * Supported formats:
+ * - PNG (all standard color types and bit depths, including interlaced);
+ *   any alpha channel is discarded
+ * - JPEG (baseline, extended sequential and progressive Huffman-coded,
+ *   8-bit grayscale or YCbCr/RGB)
+ * - GIF (first frame only)
+ * - PBM/PGM/PPM ("P1" through "P6")
+ *
+ * Files in other formats, or using format variants not listed above
+ * (e.g. arithmetic-coded or CMYK JPEGs), are rejected by returning false
+ * so that the caller can fall back to the Java back-end's decoder.
+ *
+ * Images can also be encoded as 8-bit RGB PNG or binary PPM ("P6"), so a
+ * program that never starts the back-end can still write its results.
+ *
+ * RowReader and RowWriter read and write image files a band of rows at a
+ * time, for images too large to hold in memory whole.
+ *
+ * @version 2026/10/17
+ * - added RowReader and RowWriter
+ * - added encode and encodeFile
+ * @since 2026/10/16
+ */
+
+#ifndef _imagecodec_h
+#define _imagecodec_h
+
+#include <string>
+#include <vector>
+#include "grid.h"
+
+namespace imagecodec {
+
+/*
+ * Reads the image file with the given name and stores its pixels into the
+ * given grid as 0xRRGGBB values, indexed as grid[y][x].
+ * The grid is resized to the image's height and width.
+ * Returns true on success.  Returns false and leaves the grid unmodified
+ * if the file cannot be read or is not in a supported format.
+ */
+bool decodeFile(const std::string& filename, Grid<int>& pixels);
+
+/*
+ * Decodes an in-memory image file of the given length in bytes.
+ * Behaves like decodeFile in every other respect.
+ */
+bool decode(const unsigned char* data, int length, Grid<int>& pixels);
+
+/*
+ * Encodes the given grid of 0xRRGGBB values, indexed as grid[y][x], as an
+ * image file of the given format, "png" or "ppm" (or its alias "pnm"), and
+ * appends the file's bytes to out.
+ * Returns false and appends nothing if the format is not supported or the
+ * grid is empty.
+ */
+bool encode(const Grid<int>& pixels, const std::string& format,
+            std::vector<unsigned char>& out);
+
+/*
+ * Writes the given grid to the named file, in the format given by the
+ * file's extension.  Returns true on success.  Returns false if the
+ * extension is not a supported format, the grid is empty, or the file
+ * cannot be written.
+ */
+bool encodeFile(const std::string& filename, const Grid<int>& pixels);
+
+// the formats' row-by-row decoders and encoders, defined in imagecodec.cpp
+class RowSource;
+class RowSink;
+
+/*
+ * Class: RowReader
+ * ----------------
+ * Reads an image file from top to bottom, a band of rows at a time.
+ * Non-interlaced PNGs and binary PBM/PGM/PPM files ("P4" through "P6")
+ * are decoded as they are read, so only a few rows of them are ever held
+ * in memory.  Files in the other supported formats are decoded whole when
+ * opened and then handed out a band at a time.
+ */
+class RowReader {
+public:
+    RowReader();
+    ~RowReader();
+
+    /*
+     * Opens the image file with the given name and reads its header.
+     * Returns false if the file cannot be read or is not in a supported
+     * format.
+     */
+    bool open(const std::string& filename);
+
+    /*
+     * Returns the width and height of the open image, or 0 if none is open.
+     */
+    int getWidth() const;
+    int getHeight() const;
+
+    /*
+     * Stores the next count rows of the image, each getWidth() 0xRRGGBB
+     * values, one after another into pixels.  Returns false if fewer than
+     * count rows are left or the file turns out to be damaged; the reader
+     * should not be used again after that.
+     */
+    bool readRows(int* pixels, int count);
+
+    /*
+     * Closes the file.  The destructor also does this.
+     */
+    void close();
+
+private:
+    RowSource* source;
+
+    // forbid copying; the reader owns its file
+    RowReader(const RowReader&);
+    RowReader& operator =(const RowReader&);
+};
+
+/*
+ * Class: RowWriter
+ * ----------------
+ * Writes an image file from top to bottom, a band of rows at a time, in
+ * the same formats as encodeFile.  Rows are encoded and written as they
+ * are given, so only a few of them are ever held in memory.
+ */
+class RowWriter {
+public:
+    RowWriter();
+    ~RowWriter();
+
+    /*
+     * Creates the named file for an image of the given size, in the format
+     * given by the file's extension.  Returns false if the extension is
+     * not a supported format, the size is not positive, or the file cannot
+     * be created.
+     */
+    bool open(const std::string& filename, int width, int height);
+
+    /*
+     * Writes the next count rows of the image, each width 0xRRGGBB values,
+     * one after another in pixels.  Returns false if that would be more
+     * rows than the image has or the file cannot be written.
+     */
+    bool writeRows(const int* pixels, int count);
+
+    /*
+     * Finishes and closes the file.  Returns true if every row of the image
+     * was written and the file is complete.  The destructor also closes
+     * the file, without saying whether it succeeded.
+     */
+    bool close();
+
+private:
+    RowSink* sink;
+
+    // forbid copying; the writer owns its file
+    RowWriter(const RowWriter&);
+    RowWriter& operator =(const RowWriter&);
+};
+
+} // namespace imagecodec
+
+#endif
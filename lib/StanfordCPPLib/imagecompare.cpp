@@ -0,0 +1,235 @@
+/*
+ * File: imagecompare.cpp
+ * ----------------------
+ * This file implements the imagecompare.h interface.
+ *
+ * Each row is compared in runs, one per tile it crosses.  A run kernel
+ * compares the overlapping part of the two rows a block of pixels at a
+ * time: per byte, |a - b| is the OR of the two saturating differences, and
+ * a pixel differs if any byte is still nonzero after a saturating subtract
+ * of the tolerance.  Each band of tile rows belongs to one thread, so tile
+ * entries are updated without locking; only the running total is shared.
+ *
+ * @since 2026/10/17
+ */
+
+#include "imagecompare.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+#include "parallel.h"
+
+// the vectorized kernels use GCC/Clang target attributes and CPU detection
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SPL_IMAGECOMPARE_X86
+#  include <immintrin.h>
+#endif
+
+namespace imagecompare {
+
+Options::Options()
+        : tolerance(0),
+          maxDiffPixels(-1),
+          tileSize(64) {
+    /* Empty */
+}
+
+bool Result::isIdentical() const {
+    return diffPixels == 0;
+}
+
+static inline bool pixelsDiffer(int a, int b, int tolerance) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (abs(((a >> shift) & 0xFF) - ((b >> shift) & 0xFF)) > tolerance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * A run kernel compares a[start .. count-1] with b[start .. count-1],
+ * returns how many pixels differ, and sets first (if still -1) and last to
+ * the indexes of the first and last differing pixels.
+ */
+typedef int (*RunFunction)(const int*, const int*, int, int, int, int&, int&);
+
+static int compareRunScalar(const int* a, const int* b, int start, int count,
+                            int tolerance, int& first, int& last) {
+    int diffs = 0;
+    for (int i = start; i < count; i++) {
+        if (a[i] != b[i] && (tolerance == 0 || pixelsDiffer(a[i], b[i], tolerance))) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+            diffs++;
+        }
+    }
+    return diffs;
+}
+
+#ifdef SPL_IMAGECOMPARE_X86
+// records the differing pixels, one bit each, of the block starting at index
+static inline int addMask(unsigned int mask, int index, int& first, int& last) {
+    if (first < 0) {
+        first = index + __builtin_ctz(mask);
+    }
+    last = index + 31 - __builtin_clz(mask);
+    return __builtin_popcount(mask);
+}
+
+__attribute__((target("sse2")))
+static int compareRunSse(const int* a, const int* b, int start, int count,
+                         int tolerance, int& first, int& last) {
+    __m128i limit = _mm_set1_epi8((char) std::min(tolerance, 255));
+    int diffs = 0;
+    int i = start;
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+        __m128i same = _mm_cmpeq_epi32(_mm_subs_epu8(diff, limit), _mm_setzero_si128());
+        unsigned int mask = ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xF;
+        if (mask != 0) {
+            diffs += addMask(mask, i, first, last);
+        }
+    }
+    return diffs + compareRunScalar(a, b, i, count, tolerance, first, last);
+}
+
+__attribute__((target("avx2")))
+static int compareRunAvx2(const int* a, const int* b, int start, int count,
+                          int tolerance, int& first, int& last) {
+    __m256i limit = _mm256_set1_epi8((char) std::min(tolerance, 255));
+    int diffs = 0;
+    int i = start;
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+        __m256i same = _mm256_cmpeq_epi32(_mm256_subs_epu8(diff, limit), _mm256_setzero_si256());
+        unsigned int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(same)) & 0xFF;
+        if (mask != 0) {
+            diffs += addMask(mask, i, first, last);
+        }
+    }
+    return diffs + compareRunScalar(a, b, i, count, tolerance, first, last);
+}
+#endif // SPL_IMAGECOMPARE_X86
+
+// the run kernel for this CPU; picked the first time it is needed
+static RunFunction getRunKernel() {
+    static RunFunction kernel = []() -> RunFunction {
+#ifdef SPL_IMAGECOMPARE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return compareRunAvx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            return compareRunSse;
+        }
+#endif // SPL_IMAGECOMPARE_X86
+        return compareRunScalar;
+    }();
+    return kernel;
+}
+
+/* Adds count differing pixels in columns [first, last] of row to tile. */
+static void addDiffs(TileDiff& tile, int row, int first, int last, int count) {
+    if (tile.diffPixels == 0) {
+        tile.left = first;
+        tile.right = last;
+        tile.top = row;
+    } else {
+        tile.left = std::min(tile.left, first);
+        tile.right = std::max(tile.right, last);
+    }
+    tile.bottom = row;
+    tile.diffPixels += count;
+}
+
+Result compare(const Grid<int>& a, const Grid<int>& b, const Options& options) {
+    Result result;
+    result.width = std::max(a.numCols(), b.numCols());
+    result.height = std::max(a.numRows(), b.numRows());
+    result.tileSize = std::max(1, options.tileSize);
+    result.diffPixels = 0;
+    result.stoppedEarly = false;
+
+    int tileSize = result.tileSize;
+    int tolerance = std::max(0, options.tolerance);
+    int tilesAcross = (result.width + tileSize - 1) / tileSize;
+    int tilesDown = (result.height + tileSize - 1) / tileSize;
+    std::vector<TileDiff> tiles((size_t) tilesAcross * tilesDown);
+    for (int ty = 0; ty < tilesDown; ty++) {
+        for (int tx = 0; tx < tilesAcross; tx++) {
+            TileDiff& tile = tiles[(size_t) ty * tilesAcross + tx];
+            tile.x = tx * tileSize;
+            tile.y = ty * tileSize;
+            tile.diffPixels = 0;
+            tile.left = tile.top = tile.right = tile.bottom = -1;
+        }
+    }
+
+    RunFunction kernel = getRunKernel();
+    std::atomic<long long> total(0);
+    std::atomic<bool> stop(false);
+    parallel::forEachRange(0, tilesDown, 1, [&](int bandStart, int bandEnd) {
+        int rowEnd = std::min(result.height, bandEnd * tileSize);
+        for (int row = bandStart * tileSize; row < rowEnd && !stop; row++) {
+            TileDiff* tileRow = &tiles[(size_t) (row / tileSize) * tilesAcross];
+            // columns [0, overlap) exist in both rows; [overlap, longer) in only one
+            int aCols = row < a.numRows() ? a.numCols() : 0;
+            int bCols = row < b.numRows() ? b.numCols() : 0;
+            int overlap = std::min(aCols, bCols);
+            int longer = std::max(aCols, bCols);
+            const int* aRow = overlap > 0 ? a.rowPtr(row) : NULL;
+            const int* bRow = overlap > 0 ? b.rowPtr(row) : NULL;
+            long long rowDiffs = 0;
+            for (int tx = 0; tx < tilesAcross; tx++) {
+                int start = tx * tileSize;
+                int end = std::min(longer, start + tileSize);
+                if (start >= end) {
+                    break;
+                }
+                int first = -1;
+                int last = -1;
+                int diffs = 0;
+                if (start < overlap) {
+                    int compareEnd = std::min(end, overlap);
+                    diffs = kernel(aRow, bRow, start, compareEnd, tolerance, first, last);
+                }
+                if (end > overlap) {
+                    int oneSided = std::max(start, overlap);
+                    if (first < 0) {
+                        first = oneSided;
+                    }
+                    last = end - 1;
+                    diffs += end - oneSided;
+                }
+                if (diffs > 0) {
+                    addDiffs(tileRow[tx], row, first, last, diffs);
+                    rowDiffs += diffs;
+                }
+            }
+            if (rowDiffs > 0) {
+                long long found = total += rowDiffs;
+                if (options.maxDiffPixels >= 0 && found > options.maxDiffPixels) {
+                    stop = true;
+                }
+            }
+        }
+    });
+
+    result.diffPixels = total;
+    result.stoppedEarly = stop;
+    for (const TileDiff& tile : tiles) {
+        if (tile.diffPixels > 0) {
+            result.tiles.add(tile);
+        }
+    }
+    return result;
+}
+
+} // namespace imagecompare
@@ -0,0 +1,85 @@
+/*
+ * File: imagecompare.h
+ * --------------------
+ * This file declares functions for comparing two images' pixel grids, such
+ * as a rendered image against a known-good one.  A comparison reports how
+ * many pixels differ and where, as a count and bounding box for each tile
+ * of the image that has any differences, rather than as a diff image.
+ *
+ * Comparisons run in parallel bands of tiles (see parallel.h) and compare
+ * 4 or 8 pixels at a time with SSE2 or AVX2 when the CPU supports them.
+ *
+ * @since 2026/10/17
+ */
+
+#ifndef _imagecompare_h
+#define _imagecompare_h
+
+#include "grid.h"
+#include "vector.h"
+
+namespace imagecompare {
+
+/*
+ * Settings for a comparison.  The defaults give an exact comparison of
+ * every pixel, reported in 64x64 tiles.
+ */
+struct Options {
+    /*
+     * Two pixels are considered the same if none of their four bytes
+     * (alpha, red, green, blue) differ by more than this.  0 means exact.
+     */
+    int tolerance;
+
+    /*
+     * If not negative, the comparison stops soon after more than this many
+     * differing pixels have been found.  Counts and tiles are then partial.
+     */
+    long long maxDiffPixels;
+
+    /* The width and height of the tiles in the report, in pixels. */
+    int tileSize;
+
+    Options();
+};
+
+/*
+ * The differences found in one tile.  The bounding box is inclusive and is
+ * in image coordinates, with x being the column and y the row.
+ */
+struct TileDiff {
+    int x;              // left column of the tile
+    int y;              // top row of the tile
+    int diffPixels;     // differing pixels in the tile
+    int left;           // bounding box of the differing pixels
+    int top;
+    int right;
+    int bottom;
+};
+
+/*
+ * The outcome of a comparison.  If the images are not the same size, the
+ * result covers the larger width and height, and any pixel that is inside
+ * one image but not the other counts as differing.
+ */
+struct Result {
+    int width;
+    int height;
+    int tileSize;
+    long long diffPixels;       // total differing pixels found
+    bool stoppedEarly;          // true if maxDiffPixels was exceeded
+    Vector<TileDiff> tiles;     // tiles with differences, in row-major order
+
+    /* Returns true if no differing pixels were found. */
+    bool isIdentical() const;
+};
+
+/*
+ * Compares two pixel grids, indexed as grid[y][x], with the given options.
+ */
+Result compare(const Grid<int>& a, const Grid<int>& b,
+               const Options& options = Options());
+
+} // namespace imagecompare
+
+#endif
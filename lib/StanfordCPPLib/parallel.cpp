@@ -0,0 +1,175 @@
+/*
+ * File: parallel.cpp
+ * ------------------
+ * This file implements the parallel.h interface.
+ *
+ * Worker threads sleep on a condition variable between loops.  A loop is
+ * published as a Job; every participating thread, including the caller,
+ * repeatedly claims the next grain-sized subrange with an atomic counter
+ * until none are left, so uneven subranges balance out on their own.
+ *
+ * @since 2026/10/17
+ */
+
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+/*
+ * One call to forEachRange, as seen by the threads working on it.
+ */
+struct Job {
+    const std::function<void(int, int)>* body;
+    int end;
+    int grain;
+    int workers;                 // pool threads taking part (not the caller)
+    std::atomic<int> next;       // start of the next unclaimed subrange
+    std::atomic<bool> failed;
+    std::exception_ptr error;    // first exception thrown; guarded by Pool::lock
+};
+
+struct Pool {
+    std::mutex lock;
+    std::condition_variable jobPosted;
+    std::condition_variable workerDone;
+    std::mutex callLock;         // one forEachRange at a time
+    std::vector<std::thread> threads;
+    Job* job;
+    unsigned int generation;     // incremented for each job posted
+    int busyWorkers;
+    int threadCount;             // 0 until first needed
+};
+
+// true on pool threads, and on any thread while it runs a loop body
+static thread_local bool insideLoop = false;
+
+static void workerLoop(Pool* pool, int index);
+
+/*
+ * Returns the pool.  It is never freed because its detached threads may
+ * outlive static destructors.
+ */
+static Pool& getPool() {
+    static Pool* pool = new Pool();   // value-initialized: no job, no threads
+    return *pool;
+}
+
+static int getDefaultThreadCount() {
+    char* threads = getenv("SPL_THREADS");
+    if (threads != NULL && atoi(threads) > 0) {
+        return atoi(threads);
+    }
+    return std::max(1, (int) std::thread::hardware_concurrency());
+}
+
+/*
+ * Claims and runs subranges of the given job until there are none left.
+ */
+static void runJob(Pool& pool, Job& job) {
+    while (!job.failed) {
+        int start = job.next.fetch_add(job.grain);
+        if (start >= job.end) {
+            break;
+        }
+        try {
+            (*job.body)(start, std::min(start + job.grain, job.end));
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(pool.lock);
+            if (!job.failed) {
+                job.error = std::current_exception();
+                job.failed = true;
+            }
+        }
+    }
+}
+
+static void workerLoop(Pool* pool, int index) {
+    insideLoop = true;
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> guard(pool->lock);
+    while (true) {
+        pool->jobPosted.wait(guard, [&]() { return pool->generation != seen; });
+        seen = pool->generation;
+        Job* job = pool->job;
+        if (job == NULL || index >= job->workers) {
+            continue;   // not needed for this job, or it is already over
+        }
+        guard.unlock();
+        runJob(*pool, *job);
+        guard.lock();
+        if (--pool->busyWorkers == 0) {
+            pool->workerDone.notify_all();
+        }
+    }
+}
+
+void forEachRange(int begin, int end, int grain,
+                  const std::function<void(int start, int end)>& body) {
+    if (begin >= end) {
+        return;
+    }
+    grain = std::max(1, grain);
+    int threads = getThreadCount();
+    int chunks = (end - begin + grain - 1) / grain;
+    if (insideLoop || threads <= 1 || chunks <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    Pool& pool = getPool();
+    std::lock_guard<std::mutex> callGuard(pool.callLock);
+    Job job;
+    job.body = &body;
+    job.end = end;
+    job.grain = grain;
+    job.workers = std::min(threads, chunks) - 1;
+    job.next = begin;
+    job.failed = false;
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        while ((int) pool.threads.size() < job.workers) {
+            pool.threads.push_back(std::thread(workerLoop, &pool, (int) pool.threads.size()));
+            pool.threads.back().detach();
+        }
+        pool.job = &job;
+        pool.busyWorkers = job.workers;
+        pool.generation++;
+    }
+    pool.jobPosted.notify_all();
+
+    insideLoop = true;
+    runJob(pool, job);
+    insideLoop = false;
+
+    std::unique_lock<std::mutex> guard(pool.lock);
+    pool.workerDone.wait(guard, [&]() { return pool.busyWorkers == 0; });
+    pool.job = NULL;
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
+int getThreadCount() {
+    Pool& pool = getPool();
+    std::lock_guard<std::mutex> guard(pool.lock);
+    if (pool.threadCount == 0) {
+        pool.threadCount = getDefaultThreadCount();
+    }
+    return pool.threadCount;
+}
+
+void setThreadCount(int threads) {
+    Pool& pool = getPool();
+    std::lock_guard<std::mutex> guard(pool.lock);
+    pool.threadCount = threads > 0 ? threads : getDefaultThreadCount();
+}
+
+} // namespace parallel
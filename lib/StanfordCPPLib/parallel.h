@@ -0,0 +1,58 @@
+/*
+ * File: parallel.h
+ * ----------------
+ * This file exports functions for splitting a loop across a pool of worker
+ * threads.  The pool is created the first time it is needed and is shared
+ * by every parallel loop in the program.
+ *
+ * The number of threads defaults to the number of hardware threads, and can
+ * be changed with the SPL_THREADS environment variable or setThreadCount.
+ *
+ * @since 2026/10/17
+ */
+
+#ifndef _parallel_h
+#define _parallel_h
+
+#include <functional>
+
+namespace parallel {
+
+/*
+ * Function: forEachRange
+ * Usage: parallel::forEachRange(0, n, 16, [&](int start, int end) { ... });
+ * ------------------------------------------------------------------------
+ * Calls body(start, end) for consecutive subranges of [begin, end) that
+ * together cover it exactly once, each of at most grain items, spread over
+ * the pool's threads; the calling thread does its share as well.
+ * Returns once every subrange has been processed.
+ *
+ * Subranges may run in any order and on any thread, so body must only
+ * write to data that belongs to its own subrange.  If body throws, the
+ * remaining subranges are skipped and the first exception is rethrown here.
+ * A call made from inside another forEachRange body runs serially.
+ */
+void forEachRange(int begin, int end, int grain,
+                  const std::function<void(int start, int end)>& body);
+
+/*
+ * Function: getThreadCount
+ * Usage: int threads = parallel::getThreadCount();
+ * ------------------------------------------------
+ * Returns the number of threads, including the caller, that forEachRange
+ * uses.
+ */
+int getThreadCount();
+
+/*
+ * Function: setThreadCount
+ * Usage: parallel::setThreadCount(threads);
+ * -----------------------------------------
+ * Sets the number of threads that forEachRange uses; 1 runs every loop on
+ * the calling thread, and 0 restores the default.
+ */
+void setThreadCount(int threads);
+
+} // namespace parallel
+
+#endif
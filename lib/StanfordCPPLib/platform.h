@@ -5,6 +5,13 @@
  * the platform-specific parts of the StanfordCPPLib package.  This file is
  * logically part of the implementation and is not interesting to clients.
  *
+ * @version 2026/10/17
+ * - added isBatchMode, getBatchArgs
+ * - added gbufferedimage_updateAllPixels overload taking a pixel grid
+ * @version 2026/10/16
+ * - gbufferedimage_updateAllPixels accepts a const image
+ * - added gbufferedimage_updateRegion
+ * - added cpplib_flushPipe
  * @version 2015/11/07
  * - added GTable back-end methods
  * @version 2014/11/20
@@ -30,6 +37,7 @@
 #include <string>
 #include <vector>
 #include "gevents.h"
+#include "grid.h"
 #include "gwindow.h"
 #include "point.h"
 #include "sound.h"
@@ -58,6 +66,7 @@ public:
     void autograderunittest_setTestRuntime(const std::string& testName, int runtimeMS);
     void autograderunittest_setVisible(bool visible = true, bool styleCheck = false);
     void autograderunittest_setWindowDescriptionText(const std::string& text, bool styleCheck = false);
+    void cpplib_flushPipe();
     std::string cpplib_getCppLibraryVersion();
     std::string cpplib_getJavaBackEndVersion();
     void cpplib_setCppLibraryVersion();
@@ -87,7 +96,10 @@ public:
     void gbufferedimage_resize(GObject* gobj, double width, double height, bool retain = true);
     std::string gbufferedimage_save(const GObject* const gobj, const std::string& filename);
     void gbufferedimage_setRGB(GObject* gobj, double x, double y, int rgb);
-    void gbufferedimage_updateAllPixels(GObject* gobj, const std::string& base64);
+    void gbufferedimage_updateAllPixels(const GObject* const gobj, const std::string& base64);
+    void gbufferedimage_updateAllPixels(const GObject* const gobj, const Grid<int>& pixels);
+    void gbufferedimage_updateRegion(const GObject* const gobj, const Grid<int>& pixels,
+                                     int x, int y, int width, int height);
     void gbutton_constructor(GObject* gobj, std::string label);
     void gcheckbox_constructor(GObject* gobj, std::string label);
     bool gcheckbox_isSelected(GObject* gobj);
@@ -253,4 +265,18 @@ public:
 
 Platform *getPlatform();
 
+/*
+ * Returns true if the program was started with "--batch" as its first
+ * argument.  A batch program runs without the Java back-end, so it must not
+ * use graphics or the graphical console; cin and cout are the process's own
+ * standard streams.
+ */
+bool isBatchMode();
+
+/*
+ * Returns the arguments that followed "--batch", or an empty vector if the
+ * program is not in batch mode.
+ */
+std::vector<std::string> getBatchArgs();
+
 #endif
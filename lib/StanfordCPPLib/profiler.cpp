@@ -0,0 +1,277 @@
+/*
+ * File: profiler.cpp
+ * ------------------
+ * This file implements the profiler.h interface.
+ *
+ * Every finished interval updates its stage's totals under one lock; the
+ * intervals themselves are kept only if a trace file was asked for, up to
+ * MAX_TRACE_EVENTS of them so that a long session cannot use up memory.
+ *
+ * @since 2026/10/17
+ */
+
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace profiler {
+
+static const size_t MAX_TRACE_EVENTS = 1000000;
+
+struct StageStats {
+    long long count;
+    long long total;   // all times in microseconds
+    long long min;
+    long long max;
+};
+
+/*
+ * A finished interval ("X" event) or a counter's new total ("C" event)
+ * for the trace file.
+ */
+struct TraceEvent {
+    std::string name;
+    char phase;
+    long long start;
+    long long value;   // duration for an interval, total for a counter
+    int thread;
+};
+
+struct Profile {
+    std::mutex lock;
+    std::chrono::steady_clock::time_point epoch;
+    std::map<std::string, StageStats> stages;
+    std::map<std::string, long long> counters;
+    std::string tracePath;   // "" if no trace file is written
+    std::vector<TraceEvent> events;
+    size_t droppedEvents;
+};
+
+// small per-thread numbers for the trace, in order of each thread's first interval
+static std::atomic<int> threadCount(0);
+static thread_local int threadIndex = -1;
+
+static bool envFlag(const char* name) {
+    char* value = getenv(name);
+    return value != NULL && (value[0] == 't' || value[0] == 'T');
+}
+
+static void printReportAtExit() {
+    printReport();
+}
+
+/*
+ * Creates the profile if the environment asks for one; otherwise returns NULL.
+ */
+static Profile* createProfile() {
+    char* trace = getenv("JBEPROFILE_TRACE");
+    bool wantTrace = trace != NULL && trace[0] != '\0';
+    if (!envFlag("JBEPROFILE") && !wantTrace) {
+        return NULL;
+    }
+    Profile* profile = new Profile;
+    profile->epoch = std::chrono::steady_clock::now();
+    profile->tracePath = wantTrace ? trace : "";
+    profile->droppedEvents = 0;
+    atexit(printReportAtExit);
+    return profile;
+}
+
+/*
+ * Returns the profile, or NULL if profiling is off.  The profile is never
+ * freed, so that timers on threads still running at exit stay safe.
+ */
+static Profile* getProfile() {
+    static Profile* profile = createProfile();
+    return profile;
+}
+
+static long long microsSince(const Profile& profile) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - profile.epoch).count();
+}
+
+static int getThreadIndex() {
+    if (threadIndex < 0) {
+        threadIndex = threadCount++;
+    }
+    return threadIndex;
+}
+
+/*
+ * Adds an event to the trace, if there is one.  The profile's lock must be
+ * held by the caller.
+ */
+static void addTraceEvent(Profile& profile, const std::string& name, char phase,
+                          long long start, long long value) {
+    if (profile.tracePath.empty()) {
+        return;
+    }
+    if (profile.events.size() >= MAX_TRACE_EVENTS) {
+        profile.droppedEvents++;
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.phase = phase;
+    event.start = start;
+    event.value = value;
+    event.thread = getThreadIndex();
+    profile.events.push_back(event);
+}
+
+static void writeJsonString(FILE* out, const std::string& str) {
+    fputc('"', out);
+    for (size_t i = 0; i < str.length(); i++) {
+        unsigned char ch = (unsigned char) str[i];
+        if (ch == '"' || ch == '\\') {
+            fputc('\\', out);
+            fputc(ch, out);
+        } else if (ch < 0x20) {
+            fprintf(out, "\\u%04x", ch);
+        } else {
+            fputc(ch, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/*
+ * Writes the trace in the Chrome trace event format.  The profile's lock
+ * must be held by the caller.
+ */
+static bool writeTrace(const Profile& profile) {
+    FILE* out = fopen(profile.tracePath.c_str(), "w");
+    if (!out) {
+        return false;
+    }
+    fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", out);
+    for (size_t i = 0; i < profile.events.size(); i++) {
+        const TraceEvent& event = profile.events[i];
+        fputs("{\"name\": ", out);
+        writeJsonString(out, event.name);
+        fprintf(out, ", \"ph\": \"%c\", \"ts\": %lld, \"pid\": 1, \"tid\": %d",
+                event.phase, event.start, event.thread);
+        if (event.phase == 'X') {
+            fprintf(out, ", \"dur\": %lld}", event.value);
+        } else {
+            fprintf(out, ", \"args\": {\"bytes\": %lld}}", event.value);
+        }
+        fputs(i + 1 < profile.events.size() ? ",\n" : "\n", out);
+    }
+    fputs("]}\n", out);
+    return fclose(out) == 0;
+}
+
+bool isEnabled() {
+    return getProfile() != NULL;
+}
+
+void countBytes(const std::string& counter, long long bytes) {
+    Profile* profile = getProfile();
+    if (!profile) {
+        return;
+    }
+    long long now = microsSince(*profile);
+    std::lock_guard<std::mutex> guard(profile->lock);
+    long long& total = profile->counters[counter];
+    total += bytes;
+    addTraceEvent(*profile, counter, 'C', now, total);
+}
+
+void printReport() {
+    Profile* profile = getProfile();
+    if (!profile) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(profile->lock);
+
+    // slowest stages first
+    std::vector<std::pair<std::string, StageStats> > stages(profile->stages.begin(),
+                                                            profile->stages.end());
+    std::stable_sort(stages.begin(), stages.end(),
+                     [](const std::pair<std::string, StageStats>& a,
+                        const std::pair<std::string, StageStats>& b) {
+        return a.second.total > b.second.total;
+    });
+
+    // use stderr directly rather than cerr because graphical console may be unreachable
+    fputs("***\n", stderr);
+    fputs("*** STANFORD C++ LIBRARY PROFILE (times in ms; nested stages are included\n", stderr);
+    fputs("*** in the stages around them)\n", stderr);
+    fputs("***\n", stderr);
+    fprintf(stderr, "%-40s %8s %12s %10s %10s %10s\n",
+            "stage", "count", "total", "mean", "min", "max");
+    for (const std::pair<std::string, StageStats>& entry : stages) {
+        const StageStats& stats = entry.second;
+        fprintf(stderr, "%-40s %8lld %12.3f %10.3f %10.3f %10.3f\n",
+                entry.first.c_str(), stats.count, stats.total / 1000.0,
+                stats.total / 1000.0 / stats.count, stats.min / 1000.0, stats.max / 1000.0);
+    }
+    if (!profile->counters.empty()) {
+        fprintf(stderr, "\n%-40s %14s\n", "counter", "total");
+        for (const std::pair<const std::string, long long>& entry : profile->counters) {
+            fprintf(stderr, "%-40s %14lld\n", entry.first.c_str(), entry.second);
+        }
+    }
+    if (!profile->tracePath.empty()) {
+        if (writeTrace(*profile)) {
+            fprintf(stderr, "\nTrace written to %s", profile->tracePath.c_str());
+            if (profile->droppedEvents > 0) {
+                fprintf(stderr, " (the last %lu events were left out)",
+                        (unsigned long) profile->droppedEvents);
+            }
+            fputs(".\n", stderr);
+        } else {
+            fprintf(stderr, "\nCouldn't write trace file %s.\n", profile->tracePath.c_str());
+        }
+    }
+    fflush(stderr);
+}
+
+StageTimer::StageTimer(const char* stage)
+        : start(-1) {
+    Profile* profile = getProfile();
+    if (profile) {
+        this->stage = stage;
+        start = microsSince(*profile);
+    }
+}
+
+StageTimer::StageTimer(const std::string& stage)
+        : start(-1) {
+    Profile* profile = getProfile();
+    if (profile) {
+        this->stage = stage;
+        start = microsSince(*profile);
+    }
+}
+
+StageTimer::~StageTimer() {
+    if (start < 0) {
+        return;
+    }
+    Profile* profile = getProfile();
+    long long elapsed = microsSince(*profile) - start;
+    std::lock_guard<std::mutex> guard(profile->lock);
+    std::map<std::string, StageStats>::iterator it = profile->stages.find(stage);
+    if (it == profile->stages.end()) {
+        StageStats stats = { 1, elapsed, elapsed, elapsed };
+        profile->stages[stage] = stats;
+    } else {
+        StageStats& stats = it->second;
+        stats.count++;
+        stats.total += elapsed;
+        stats.min = std::min(stats.min, elapsed);
+        stats.max = std::max(stats.max, elapsed);
+    }
+    addTraceEvent(*profile, stage, 'X', start, elapsed);
+}
+
+} // namespace profiler
@@ -0,0 +1,86 @@
+/*
+ * File: profiler.h
+ * ----------------
+ * This file exports scoped timers and byte counters for finding out where
+ * a program's time goes: in its own code, in the library, or in talking to
+ * the Java back-end.  The library times its own slow stages (loading and
+ * saving images, Base64 decoding, each command that waits for a result from
+ * the back-end) and counts the bytes sent through the pipe to and from it.
+ *
+ * Profiling is off unless the JBEPROFILE environment variable starts with
+ * "t" (as with JBETRACE, which logs the pipe traffic itself).  When it is
+ * on, a table of every stage's count and total, mean, minimum, and maximum
+ * time is printed to stderr as the program exits.  If JBEPROFILE_TRACE
+ * names a file, profiling is turned on as well and every timed interval is
+ * also written there as a Chrome trace, which chrome://tracing and
+ * https://ui.perfetto.dev can display as a timeline.
+ *
+ * While profiling is off, a StageTimer costs one test of a flag.
+ *
+ * @since 2026/10/17
+ */
+
+#ifndef _profiler_h
+#define _profiler_h
+
+#include <string>
+
+namespace profiler {
+
+/*
+ * Function: isEnabled
+ * Usage: if (profiler::isEnabled()) { ... }
+ * -----------------------------------------
+ * Returns true if stages are being timed.
+ */
+bool isEnabled();
+
+/*
+ * Function: countBytes
+ * Usage: profiler::countBytes("pipe bytes sent", n);
+ * --------------------------------------------------
+ * Adds to the named counter, which is reported with its total.  Does
+ * nothing while profiling is off.
+ */
+void countBytes(const std::string& counter, long long bytes);
+
+/*
+ * Function: printReport
+ * Usage: profiler::printReport();
+ * -------------------------------
+ * Prints the table of stages and counters so far to stderr, and writes the
+ * trace file if there is one.  This is done automatically at exit.
+ */
+void printReport();
+
+/*
+ * Class: StageTimer
+ * -----------------
+ * Times the named stage from its construction to its destruction:
+ *
+ *     {
+ *         profiler::StageTimer timer("GBufferedImage::save");
+ *         ...
+ *     }
+ *
+ * Timers may be nested, and each stage's time includes that of the stages
+ * timed inside it.  Timers may be used on any thread.
+ */
+class StageTimer {
+public:
+    explicit StageTimer(const char* stage);
+    explicit StageTimer(const std::string& stage);
+    ~StageTimer();
+
+private:
+    std::string stage;
+    long long start;   // microseconds, or -1 if profiling is off
+
+    // forbid copying; each timer records its stage once
+    StageTimer(const StageTimer&);
+    StageTimer& operator =(const StageTimer&);
+};
+
+} // namespace profiler
+
+#endif
@@ -0,0 +1,346 @@
+/*
+ * File: batch.cpp
+ * ---------------
+ * Implements Fauxtoshop's batch mode, declared in batch.h.
+ */
+
+#include "batch.h"
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include "error.h"
+#include "filelib.h"
+#include "filters.h"
+#include "imagecache.h"
+#include "imagecodec.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "strlib.h"
+
+using namespace std;
+
+// the settings given on the command line
+struct BatchSettings {
+    string outDir;
+    string format;
+    unsigned long long seed;
+    bool stream;
+    string filters;
+    vector<string> inputs;
+};
+
+// an image file to process, and the file its result is written to
+struct BatchJob {
+    string input;
+    string output;
+};
+
+static void printUsage() {
+    cerr << "Usage: Fauxtoshop --batch [--out DIR] [--format png|ppm] [--seed N] [--threads N]"
+         << " [--stream] FILTERS INPUT..." << endl;
+    cerr << "FILTERS is a comma-separated list of scatter:RADIUS, edge:THRESHOLD, blur:RADIUS,"
+         << " and greenscreen:THRESHOLD:ROW:COL:STICKER." << endl;
+    cerr << "Each INPUT is an image file or a directory of them." << endl;
+}
+
+/* Returns true if str is an integer of at least 0, storing it into value. */
+static bool parseCount(const string& str, int& value) {
+    if (!stringIsInteger(str)) {
+        return false;
+    }
+    value = stringToInteger(str);
+    return value >= 0;
+}
+
+/* Returns true if str is an unsigned 64-bit integer, storing it into value. */
+static bool parseSeed(const string& str, unsigned long long& value) {
+    if (str.empty() || !isdigit(str[0])) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    value = strtoull(str.c_str(), &end, 10);
+    return *end == '\0' && errno == 0;
+}
+
+/*
+ * Reads the command-line arguments into settings.  Returns false, after
+ * saying what is wrong, if they are not valid.
+ */
+static bool parseArgs(const vector<string>& args, BatchSettings& settings) {
+    settings.outDir = "fauxtoshop-out";
+    settings.format = "png";
+    settings.seed = 0;
+    settings.stream = false;
+    size_t i = 0;
+    for (; i < args.size() && startsWith(args[i], "--"); i++) {
+        const string& option = args[i];
+        if (option == "--stream") {
+            settings.stream = true;
+            continue;
+        }
+        if (i + 1 == args.size()) {
+            cerr << "Option " << option << " needs a value." << endl;
+            return false;
+        }
+        const string& value = args[++i];
+        int threads;
+        if (option == "--out") {
+            settings.outDir = value;
+        } else if (option == "--format") {
+            settings.format = toLowerCase(value);
+            if (settings.format != "png" && settings.format != "ppm") {
+                cerr << "Unknown format \"" << value << "\"; use png or ppm." << endl;
+                return false;
+            }
+        } else if (option == "--seed") {
+            if (!parseSeed(value, settings.seed)) {
+                cerr << "The seed must be a non-negative integer." << endl;
+                return false;
+            }
+        } else if (option == "--threads") {
+            if (!parseCount(value, threads) || threads < 1) {
+                cerr << "The number of threads must be a positive integer." << endl;
+                return false;
+            }
+            parallel::setThreadCount(threads);
+        } else {
+            cerr << "Unknown option " << option << "." << endl;
+            return false;
+        }
+    }
+    if (args.size() - i < 2) {
+        cerr << "Both a list of filters and at least one input are needed." << endl;
+        return false;
+    }
+    settings.filters = args[i];
+    settings.inputs.assign(args.begin() + i + 1, args.end());
+    return true;
+}
+
+/*
+ * Adds a stage to pipeline for each filter in the comma-separated list.
+ * Returns false, after saying what is wrong, if a filter is not valid.
+ */
+static bool buildPipeline(const string& filters, unsigned long long seed,
+                          FilterPipeline& pipeline) {
+    for (const string& filter : stringSplit(filters, ",")) {
+        vector<string> parts = stringSplit(filter, ":", 4);
+        string name = parts.empty() ? "" : toLowerCase(parts[0]);
+        if (name != "scatter" && name != "edge" && name != "blur" && name != "greenscreen") {
+            cerr << "Unknown filter \"" << filter << "\"." << endl;
+            return false;
+        }
+        int value;
+        if (parts.size() != (name == "greenscreen" ? 5u : 2u) || !parseCount(parts[1], value)) {
+            cerr << "Bad settings in \"" << filter << "\"." << endl;
+            return false;
+        }
+        if (name == "scatter") {
+            pipeline.addStage(scatterStage(value, seed));
+        } else if (name == "edge") {
+            pipeline.addStage(edgeDetectStage(value));
+        } else if (name == "blur") {
+            pipeline.addStage(blurStage(gaussKernelForRadius(value)));
+        } else {
+            int row;
+            int col;
+            Grid<int> sticker;
+            if (!parseCount(parts[2], row) || !parseCount(parts[3], col)) {
+                cerr << "Bad sticker location in \"" << filter << "\"." << endl;
+                return false;
+            }
+            if (!imagecache::decodeFile(parts[4], sticker)) {
+                cerr << "Couldn't read sticker image " << parts[4] << "." << endl;
+                return false;
+            }
+            pipeline.addStage(greenScreenStage(sticker, value, row, col));
+        }
+    }
+    return true;
+}
+
+static bool isImageFile(const string& filename) {
+    string extension = toLowerCase(getExtension(filename));
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg"
+            || extension == ".gif" || extension == ".pbm" || extension == ".pgm"
+            || extension == ".ppm" || extension == ".pnm";
+}
+
+/*
+ * Adds a job for every image file in dir and its subdirectories, whose
+ * path relative to the input directory given on the command line starts
+ * with the given prefix.
+ */
+static void addDirectory(const string& dir, const string& prefix,
+                         const BatchSettings& settings, vector<BatchJob>& jobs) {
+    for (const string& name : listDirectory(dir)) {
+        if (startsWith(name, ".")) {
+            continue;
+        }
+        string path = dir + "/" + name;
+        if (isDirectory(path)) {
+            addDirectory(path, prefix + name + "/", settings, jobs);
+        } else if (isImageFile(name)) {
+            BatchJob job;
+            job.input = path;
+            job.output = settings.outDir + "/" + prefix + getRoot(name) + "." + settings.format;
+            jobs.push_back(job);
+        }
+    }
+}
+
+/*
+ * Returns a job for each image file named by an input.  Inputs that do not
+ * exist, and files whose result would have the same name as an earlier
+ * file's, are reported and skipped.
+ */
+static vector<BatchJob> findJobs(const BatchSettings& settings) {
+    vector<BatchJob> found;
+    for (const string& input : settings.inputs) {
+        if (isDirectory(input)) {
+            addDirectory(input, "", settings, found);
+        } else if (isFile(input)) {
+            BatchJob job;
+            job.input = input;
+            job.output = settings.outDir + "/" + getRoot(getTail(input)) + "." + settings.format;
+            found.push_back(job);
+        } else {
+            cerr << "Couldn't find " << input << "." << endl;
+        }
+    }
+    vector<BatchJob> jobs;
+    set<string> outputs;
+    for (const BatchJob& job : found) {
+        if (outputs.insert(job.output).second) {
+            jobs.push_back(job);
+        } else {
+            cerr << "Skipping " << job.input << ": another image's result is already going to "
+                 << job.output << "." << endl;
+        }
+    }
+    return jobs;
+}
+
+/* Creates any missing directories on the way to the file at path. */
+static void createParentDirectories(const string& path) {
+    for (size_t slash = path.find('/', 1); slash != string::npos;
+            slash = path.find('/', slash + 1)) {
+        if (path[slash - 1] != '/') {
+            createDirectory(path.substr(0, slash));
+        }
+    }
+}
+
+/*
+ * Reads, filters, and writes the image of one job.  Returns "" on success
+ * or else a description of what went wrong.
+ */
+static string processJob(const BatchJob& job, const FilterPipeline& pipeline) {
+    if (job.output == job.input) {
+        return "the result would replace the original";
+    }
+    Grid<int> image;
+    bool decoded;
+    {
+        profiler::StageTimer timer("batch: decode");
+        decoded = imagecodec::decodeFile(job.input, image);
+    }
+    if (!decoded) {
+        return "couldn't read this image";
+    }
+    Grid<int> result;
+    {
+        profiler::StageTimer timer("filter: chain");
+        result = pipeline.run(image);
+    }
+    try {
+        createParentDirectories(job.output);
+    } catch (const ErrorException& ex) {
+        return ex.getMessage();
+    }
+    profiler::StageTimer timer("batch: encode");
+    if (!imagecodec::encodeFile(job.output, result)) {
+        return "couldn't write " + job.output;
+    }
+    return "";
+}
+
+/*
+ * Like processJob, but reads, filters, and writes the image a band of rows
+ * at a time (see FilterPipeline::runStreaming).  A result that could not
+ * be finished is deleted.
+ */
+static string streamJob(const BatchJob& job, const FilterPipeline& pipeline) {
+    if (job.output == job.input) {
+        return "the result would replace the original";
+    }
+    imagecodec::RowReader reader;
+    if (!reader.open(job.input)) {
+        return "couldn't read this image";
+    }
+    try {
+        createParentDirectories(job.output);
+    } catch (const ErrorException& ex) {
+        return ex.getMessage();
+    }
+    imagecodec::RowWriter writer;
+    if (!writer.open(job.output, reader.getWidth(), reader.getHeight())) {
+        return "couldn't write " + job.output;
+    }
+    bool finished;
+    {
+        profiler::StageTimer timer("batch: stream");
+        finished = pipeline.runStreaming(reader, writer);
+    }
+    if (!writer.close() || !finished) {
+        deleteFile(job.output);
+        return "couldn't finish reading this image and writing " + job.output;
+    }
+    return "";
+}
+
+int runBatch(const vector<string>& args) {
+    BatchSettings settings;
+    FilterPipeline pipeline;
+    if (!parseArgs(args, settings) || !buildPipeline(settings.filters, settings.seed, pipeline)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    vector<BatchJob> jobs = findJobs(settings);
+    if (jobs.empty()) {
+        cerr << "No image files to process." << endl;
+        return EXIT_FAILURE;
+    }
+
+    mutex printLock;
+    atomic<int> failures(0);
+    auto process = [&](int start, int end) {
+        for (int i = start; i < end; i++) {
+            string problem = settings.stream ? streamJob(jobs[i], pipeline)
+                                             : processJob(jobs[i], pipeline);
+            lock_guard<mutex> guard(printLock);
+            if (problem.empty()) {
+                cout << jobs[i].input << " -> " << jobs[i].output << endl;
+            } else {
+                cerr << jobs[i].input << ": " << problem << endl;
+                failures++;
+            }
+        }
+    };
+    int count = (int) jobs.size();
+    if (count >= parallel::getThreadCount()) {
+        // a pipeline run inside a parallel loop runs on its caller's thread
+        parallel::forEachRange(0, count, 1, process);
+    } else {
+        process(0, count);
+    }
+    cout << count - failures << " of " << count << " images written to "
+         << settings.outDir << "." << endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,54 @@
+/*
+ * File: batch.h
+ * -------------
+ * Batch mode applies a chain of filters to many image files with no
+ * window, no prompts, and no Java back-end (see isBatchMode in
+ * platform.h).  It runs when Fauxtoshop is started as
+ *
+ *     Fauxtoshop --batch [options] FILTERS INPUT...
+ *
+ * FILTERS is a comma-separated list of the filters to apply, in order:
+ *
+ *     scatter:RADIUS
+ *     edge:THRESHOLD
+ *     blur:RADIUS
+ *     greenscreen:THRESHOLD:ROW:COL:STICKER   (STICKER is an image file)
+ *
+ * Each INPUT is an image file or a directory, whose image files are found
+ * recursively.  Options:
+ *
+ *     --out DIR      directory for the results, "fauxtoshop-out" by default.
+ *                    Results keep their path relative to the directory
+ *                    given as INPUT, with the new format's extension.
+ *     --format FMT   png (the default) or ppm
+ *     --seed N       seed for scatter, 0 by default, so that running the
+ *                    same batch again gives the same images
+ *     --threads N    number of worker threads (see parallel.h)
+ *     --stream       read, filter, and write each image a band of rows at
+ *                    a time, so that images too big for memory can be
+ *                    done; PNG and binary PNM files are decoded as they
+ *                    are read, other formats whole (see RowReader in
+ *                    imagecodec.h)
+ *
+ * Images are decoded, filtered, and encoded natively (see imagecodec.h),
+ * and the filters run as one FilterPipeline (see pipeline.h).  When there
+ * are at least as many files as threads, each thread works on whole files;
+ * otherwise the files are done one at a time with each spread over the
+ * threads.  With JBEPROFILE set, the time spent decoding, filtering, and
+ * encoding is reported at the end (see profiler.h).
+ */
+
+#ifndef _batch_h
+#define _batch_h
+
+#include <string>
+#include <vector>
+
+/*
+ * Runs batch mode with the given arguments, those after "--batch".
+ * Prints a line for each image written and a message for each one that
+ * could not be, and returns the program's exit status.
+ */
+int runBatch(const std::vector<std::string>& args);
+
+#endif
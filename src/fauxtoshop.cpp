@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <iostream>
 #include "console.h"
 #include "gwindow.h"
@@ -7,49 +8,51 @@
 #include "strlib.h"
 #include "gbufferedimage.h"
 #include "gevents.h"
-#include "math.h" //for sqrt and exp in the optional Gaussian kernel
+#include "ginteractors.h"
 #include "random.h"
+#include "platform.h"
+#include "batch.h"
+#include "filtercache.h"
+#include "filters.h"
+#include "pipeline.h"
+#include "profiler.h"
 
 using namespace std;
 
-static const int WHITE = 0xFFFFFF;
-static const int BLACK = 0x000000;
-static const int GREEN = 0x00FF00;
-static const double PI = 3.14159265;
-
 void doFauxtoshop(GWindow &gw, GBufferedImage &img);
 bool getImage(GBufferedImage &img, GWindow &gw);
-void pickFilter(GBufferedImage& img);
-void doFilter(GBufferedImage &img, int n);
+void pickFilter(GWindow &gw, GBufferedImage& img);
+void doFilter(GWindow &gw, GBufferedImage &img, int n);
 bool openImage(GWindow &gw, GBufferedImage &img);
 
-Grid<int> doScatter(Grid<int> &original);
-Grid<int> doEdgeDetection(Grid<int> &original);
-Grid<int> doGreenScreen(Grid<int> &original);
+Grid<int> doScatter(const Grid<int> &original);
+Grid<int> doEdgeDetection(GWindow &gw, GBufferedImage &img, const Grid<int> &original);
+Grid<int> pickEdgeThreshold(GWindow &gw, GBufferedImage &img, const Grid<int> &original);
+Grid<int> doGreenScreen(GBufferedImage &img, const Grid<int> &original);
+string describeGreenScreen(const StickerMask &mask, int threshold, int row, int col);
 void doCompare(GBufferedImage &img);
+Grid<int> doBlur(const Grid<int> &original);
+Grid<int> doChain(GBufferedImage &img, const Grid<int> &original);
+unsigned long long getScatterSeed();
 void getSecondImg(GBufferedImage &img);
-void getStickerLocation(Grid<int> &original, int &row, int &col);
-bool isRowOrColWithinStickerBounds(int stickerLength, int start, int curr);
-void overlaySticker(Grid<int> &background, Grid<int> &greenscreened, Grid<int> &sticker, int threshold, int stickerOriginX, int stickerOriginY);
-bool isOutsideGreenThreshold(int pixel, int threshold);
-int assignEdgeDetectionColors(int threshold, Grid<int> &original, int r, int c);
-int diffBtwnPixels(int pixelA, int pixelB);
+void getStickerLocation(GBufferedImage &img, const StickerMask &mask, int &row, int &col);
 int getThreshold(string prompt);
-int getRandCoord(int radius, int max, int current);
-int	setLow(int radius, int n);
-int	setHigh(int radius, int n, int max);
 
-bool convertStringToInts(Grid<int> &original, string str, int &row, int &col);
+bool convertStringToInts(const Grid<int> &original, string str, int &row, int &col);
 
 bool openImageFromFilename(GBufferedImage &img, string filename);
 bool saveImageToFilename(const GBufferedImage &img, string filename);
-void getMouseClickLocation(int &row, int &col);
+void getStickerClickLocation(GBufferedImage &img, const StickerMask &mask, int &row, int &col);
 
 /* 
  * This main declares a GWindow and a GBufferedImage for use
  * throughout the program and calls doFauxtoShop function.
+ * Started with --batch, it runs batch mode instead (see batch.h).
  */
 int main() {
+    if (isBatchMode()) {
+        return runBatch(getBatchArgs());
+    }
     GWindow gw;
     gw.setTitle("Fauxtoshop");
     gw.setVisible(true);
@@ -70,7 +73,7 @@ void doFauxtoshop(GWindow &gw, GBufferedImage &img) {
             return; 
         }
 
-        pickFilter(img); // Prompts user to pick a filter
+        pickFilter(gw, img); // Prompts user to pick a filter
 
         while (true) { // Asks user if they would like to save image
             string filename = getLine("Enter filename to save image (or blank to skip saving): ");
@@ -140,124 +143,137 @@ bool openImageFromFilename(GBufferedImage& img, string filename) {
 }
 
 /* Asks the user which filter they would like to apply to the image file */
-void pickFilter(GBufferedImage& img) {
+void pickFilter(GWindow& gw, GBufferedImage& img) {
     int n;
 	while (true) {
-        n = getInteger("Which image filter would you like to apply?\n\t1 - Scatter\n\t2 - Edge Detection\n\t3 - \"Green screen\" with another image\n\t4 - Compare image with another image\nYour choice: ");
-        if (n > 0 && n <= 4) {
+        n = getInteger("Which image filter would you like to apply?\n\t1 - Scatter\n\t2 - Edge Detection\n\t3 - \"Green screen\" with another image\n\t4 - Compare image with another image\n\t5 - Blur\n\t6 - Several of the above in a row\nYour choice: ");
+        if (n > 0 && n <= 6) {
                 break; // Break out of loop when user enters a valid number
         }
         cout << "You entered an invalid number. Let's try this again." << endl;
     }
-    doFilter(img, n);
+    doFilter(gw, img, n);
 }
 
-/* Starts the correct filter function */
-void doFilter(GBufferedImage& img, int n) {
-    Grid<int> original = img.toGrid();
-    Grid<int> filtered;
+/* Starts the correct filter function.
+ * Each filter looks its result up in the filter cache once it has its
+ * settings, and only computes it if it is not there (see filtercache.h).
+ */
+void doFilter(GWindow& gw, GBufferedImage& img, int n) {
+    // read the image's pixels in place; each filter's result is moved into it
+    const Grid<int>& original = img.toGridView();
     switch(n) {
-        case 1: filtered = doScatter(original);
-                img.fromGrid(filtered);
+        case 1: img.fromGrid(doScatter(original));
                 break;
-        case 2: filtered = doEdgeDetection(original);
-                img.fromGrid(filtered);
+        case 2: img.fromGrid(doEdgeDetection(gw, img, original));
                 break;
-        case 3: filtered = doGreenScreen(original);
-                img.fromGrid(filtered);
+        case 3: img.fromGrid(doGreenScreen(img, original));
                 break;
         case 4: doCompare(img);
                 break;
+        case 5: img.fromGrid(doBlur(original));
+                break;
+        case 6: img.fromGrid(doChain(img, original));
+                break;
         default: cout << "You entered an invalid number" << endl;
                  break;
     }
 }
 
 /* Applies the scatter filter to the image.
- * Prompts user for scatter radius. Iterates through Grid. 
+ * Prompts user for scatter radius. The scatter itself runs in parallel
+ * row bands (see filters.h), seeded from the random library so that it
+ * still follows setRandomSeed. The seed is part of the cache key, so a
+ * cached scatter is only reused when the same seed comes up again.
  */
-Grid<int> doScatter(Grid<int>& original) {
+Grid<int> doScatter(const Grid<int>& original) {
     int radius = getInteger("Enter degree of scatter [1 - 100]: ");
-    Grid<int> scattered(original.numRows(), original.numCols());
-    for (int r = 0; r < scattered.numRows(); r++) {
-        for (int c = 0; c < scattered.numCols(); c++) {
-            scattered[r][c] = original[getRandCoord(radius, scattered.numRows(), r)][getRandCoord(radius, scattered.numCols(), c)];
-	}
-    }
-    return scattered;
+    unsigned long long seed = getScatterSeed();
+    profiler::StageTimer timer("filter: scatter");
+    return filtercache::run("scatter radius=" + integerToString(radius) + " seed=" + std::to_string(seed),
+                            original, [&]() {
+        return scatterImage(original, radius, seed);
+    });
 }
 
-/*
- * Returns a random column or row within the radius of the current column or row.
- * Will not return a coordinate outside the bounds of the grid.
- */
-int getRandCoord(int radius, int max, int current) {
-    int low = setLow(radius, current);
-    int high = setHigh(radius, current, max);
-    return randomInteger(low, high);
+/* Returns a seed for the scatter filter drawn from the random library */
+unsigned long long getScatterSeed() {
+    return (unsigned long long) randomInteger(0, 0x7FFFFFFF) << 31
+            | (unsigned long long) randomInteger(0, 0x7FFFFFFF);
 }
 
-/* Sets the lower radius boundary so that it stays inbounds */
-int setLow(int radius, int n) {
-    if ((n - radius) < 0) {
-        return 0;
-    }
-    return n - radius;
-}
-
-/* Sets upper radius boundary so that it stays inbounds */
-int setHigh(int radius, int n, int max) {
-    if ((n + radius) >= max) {
-        return max - 1;
-    }
-        return n + radius;
-}
-
-/* Returns a Grid<int> with the edge detection filter applied to the Grid<int> argument passed in. */
-Grid<int> doEdgeDetection(Grid<int>& original) {
-    int threshold = getThreshold("Enter threshold for edge detection: ");
-    Grid<int> edged(original.numRows(), original.numCols());
-    // Loop through each pixel in the grid
-    for (int r = 0; r < edged.numRows(); r++) {
-        for (int c = 0; c < edged.numCols(); c++) {
-            edged[r][c] = assignEdgeDetectionColors(threshold, original, r, c);
+/* Returns a Grid<int> with the edge detection filter applied to the Grid<int> argument passed in.
+ * A pixel becomes black if any of its neighbors differs from it by more than
+ * the threshold in red, green, or blue, and white otherwise (see filters.h).
+ * If blank is entered for the threshold, the user picks it with a slider instead.
+ */
+Grid<int> doEdgeDetection(GWindow& gw, GBufferedImage& img, const Grid<int>& original) {
+    while (true) {
+        string entry = trim(getLine("Enter threshold for edge detection (or blank to use a slider): "));
+        if (entry == "") {
+            return pickEdgeThreshold(gw, img, original);
+        } else if (stringIsInteger(entry) && stringToInteger(entry) >= 0) {
+            int threshold = stringToInteger(entry);
+            profiler::StageTimer timer("filter: edge detection");
+            return filtercache::run("edge detection threshold=" + integerToString(threshold),
+                                    original, [&]() {
+                return edgeDetectImage(original, threshold);
+            });
         }
+        cout << "The threshold must be a non-negative integer. Let's try this again." << endl;
     }
-    return edged;
 }
 
-/* 
- * Returns black if the difference between the pixel and its neighbors
- * is greater than the threshold. If not, returns white.
+/* Shows a slider under the image for choosing the edge detection threshold,
+ * redrawing the edges in img as it is dragged, until the user clicks Done.
+ * Returns the edges for the chosen threshold. The neighbor differences are
+ * found only once, so each redraw is a single compare per pixel and the
+ * number of edge pixels comes from their histogram (see EdgeDifferences).
  */
-int assignEdgeDetectionColors(int threshold, Grid<int>& original, int r, int c) {
-    int pixel = original[r][c];
-    int neighborPixel; 
-    for (int row = r - 1; row <= r + 1; row++) {
-        for (int col = c - 1; col <= c + 1; col++) {
-            if (original.inBounds(row, col)) {
-                neighborPixel = original[row][col];
-                if (diffBtwnPixels(pixel, neighborPixel) > threshold) {
-                    return BLACK;
-                }
+Grid<int> pickEdgeThreshold(GWindow& gw, GBufferedImage& img, const Grid<int>& original) {
+    const int START_THRESHOLD = 40;
+    EdgeDifferences differences(original);   // original is img's own grid, replaced below
+    GSlider* slider = new GSlider(0, 255, START_THRESHOLD);
+    slider->setActionCommand("threshold");
+    GLabel* count = new GLabel("");
+    GButton* done = new GButton("Done");
+    done->setActionCommand("done");
+    gw.addToRegion(slider, "SOUTH");
+    gw.addToRegion(count, "SOUTH");
+    gw.addToRegion(done, "SOUTH");
+    cout << "Drag the slider below the image to change the threshold, then click Done." << endl;
+
+    int threshold = START_THRESHOLD;
+    while (true) {
+        count->setLabel(longToString(differences.countEdges(threshold)) + " edge pixels");
+        {
+            profiler::StageTimer timer("filter: edge threshold");
+            img.fromGrid(differences.toImage(threshold));
+        }
+        GActionEvent event = waitForEvent(ACTION_EVENT);
+        string command = event.getActionCommand();
+        // skip the slider moves that came in while the edges were being redrawn
+        while (command != "done") {
+            GActionEvent next = getNextEvent(ACTION_EVENT);
+            if (!next.isValid()) {
+                break;
             }
+            command = next.getActionCommand();
         }
+        if (command == "done") {
+            break;
+        }
+        threshold = slider->getValue();
     }
-    return WHITE;
-}
-
-
-// Returns the max difference between pairs of RGB values.
-int diffBtwnPixels(int pixelA, int pixelB) {
-    int redA, greenA, blueA, redB, greenB, blueB;
-    GBufferedImage::getRedGreenBlue(pixelA, redA, greenA, blueA);
-    GBufferedImage::getRedGreenBlue(pixelB, redB, greenB, blueB);
-
-    int diffA = abs(redA - redB);
-    int diffB = abs(greenA - greenB); 
-    int diffC = abs(blueA - blueB);
-
-    return max(max(diffA, diffB), diffC);
+    cout << "You chose a threshold of " << threshold << "." << endl;
+
+    gw.removeFromRegion(slider, "SOUTH");
+    gw.removeFromRegion(count, "SOUTH");
+    gw.removeFromRegion(done, "SOUTH");
+    delete slider;
+    delete count;
+    delete done;
+    return differences.toImage(threshold);
 }
 
 // Prompts the user for a positive, nonzero integer until it is input. Returns the integer.
@@ -273,9 +289,9 @@ int getThreshold(string prompt) {
     return threshold;
 } 
 
-// Implements green screen filter on grid<int> argument.
-Grid<int> doGreenScreen(Grid<int>& original) {
-    Grid<int> greenscreened(original.numRows(), original.numCols());
+// Implements green screen filter on grid<int> argument, which is img's own grid.
+// The sticker is keyed once (see StickerMask) and reused for every placement.
+Grid<int> doGreenScreen(GBufferedImage& img, const Grid<int>& original) {
     GBufferedImage sticker;
     int stickerRow;
     int stickerCol;
@@ -283,12 +299,25 @@ Grid<int> doGreenScreen(Grid<int>& original) {
     cout << "Now choose another file to add to your background image" << endl;
 
     getSecondImg(sticker); // Open the file input by the user
-    Grid<int> stickerGrid = sticker.toGrid(); // Convert sticker image to Grid<int>
+    const Grid<int>& stickerGrid = sticker.toGridView(); // View sticker image as Grid<int>
     int threshold = getThreshold("Now choose a tolerance threshold: ");
-    getStickerLocation(original, stickerRow, stickerCol);
-    overlaySticker(original, greenscreened, stickerGrid, threshold, stickerRow, stickerCol);
+    StickerMask mask(stickerGrid, threshold);
+    getStickerLocation(img, mask, stickerRow, stickerCol);
+    profiler::StageTimer timer("filter: green screen");
+    return filtercache::run(describeGreenScreen(mask, threshold, stickerRow, stickerCol),
+                            original, [&]() {
+        return greenScreenImage(original, mask, stickerRow, stickerCol);
+    });
+}
 
-    return greenscreened; 
+/* Returns the filter cache's description of placing the sticker at the given
+ * row and column, keyed with the given threshold. The sticker is described by
+ * the hash of its pixels, so the same picture matches whichever file it is in.
+ */
+string describeGreenScreen(const StickerMask& mask, int threshold, int row, int col) {
+    return "green screen sticker=" + filtercache::describe(mask.getSticker())
+            + " threshold=" + integerToString(threshold)
+            + " at " + integerToString(row) + "," + integerToString(col);
 }
 
 /* Convert image to Grid<int> */
@@ -308,18 +337,19 @@ void getSecondImg(GBufferedImage &img) {
 }
 
 /* Prompts user to enter the desired location for the sticker image.
- * If blank string is entered, allows the user to set the location with the mouse.
+ * If blank string is entered, allows the user to set the location with the mouse,
+ * previewing the sticker in img as it moves.
  */
-void getStickerLocation(Grid<int> &original, int &row, int &col) {
+void getStickerLocation(GBufferedImage &img, const StickerMask &mask, int &row, int &col) {
     while (true) {
         string location = getLine("Enter location to place image as \"(row,col)\" (or blank to use mouse): ");
         if (location == "") {
             cout << "Now click the background image to place new image:" << endl;
-            getMouseClickLocation(row, col);
+            getStickerClickLocation(img, mask, row, col);
             cout << "You chose (" << row << "," << col << ")" << endl;
             break;
         } else {
-            if (convertStringToInts(original, location, row, col)) {
+            if (convertStringToInts(img.toGridView(), location, row, col)) {
                 break;
             }
             cout << "Invalid entry. Make sure your entry is in bounds and in the correct format: \"(row,col)\"." << endl;
@@ -330,7 +360,7 @@ void getStickerLocation(Grid<int> &original, int &row, int &col) {
 /* Converts the location string input "(col,row)" into two ints, if valid.
  * Returns true if valid, assigning row and col the values. Else returns false.
  */
-bool convertStringToInts(Grid<int> &original, string str, int &row, int &col) {
+bool convertStringToInts(const Grid<int> &original, string str, int &row, int &col) {
    int indexOfComma = stringIndexOf(str, ","); // Find index of the comma
    int rowLen = indexOfComma - stringIndexOf(str, "(") -1; 
    int colLen = stringIndexOf(str, ")") - indexOfComma - 1;
@@ -348,76 +378,6 @@ bool convertStringToInts(Grid<int> &original, string str, int &row, int &col) {
    return false;
 }
 
-/* Overlays the sticker image on the original background image.
- * Assigns the filtered Grid<int> greenscreened the pixels of the new hybrid image. 
- * Ignores pixels on the sticker that fall within the green threshold.
- */
-
-void overlaySticker(Grid<int> &background, Grid<int> &greenscreened, Grid<int> &sticker, int threshold, int stickerOriginRow, int stickerOriginCol) {
-    int sRow = 0; // Sticker row
-
-    for (int bgRow = 0; bgRow < background.numRows(); bgRow++) {
-
-        int sCol = 0; // Sticker column
-        
-        for (int bgCol = 0; bgCol < background.numCols(); bgCol++) {
-
-            if (isRowOrColWithinStickerBounds(sticker.numRows(), stickerOriginRow, bgRow) && isRowOrColWithinStickerBounds(sticker.numCols(), stickerOriginCol, bgCol)) {
-                
-                if (isOutsideGreenThreshold(sticker[sRow][sCol], threshold)) { // if sticker pixel falls outside threshold, add sticker img pixel
-                        greenscreened[bgRow][bgCol] = sticker[sRow][sCol];
-                } else {
-                    greenscreened[bgRow][bgCol] = background[bgRow][bgCol]; // if sticker pixel is within green threshold, add background img pixel
-                }
-                sCol++;
-            } else {
-                greenscreened[bgRow][bgCol] = background[bgRow][bgCol]; // if outside bounds of sticker position, add background img pixel
-            }
-        }
-
-        if (isRowOrColWithinStickerBounds(sticker.numRows(), stickerOriginRow, bgRow)) { // If adding pixels from the sticker grid, increment sRow to loop
-                sRow++;
-        }
-    } 
-}
-
-/* Returns true if the row or col is within the bounds of where the sticker is to be overlaid */
-bool isRowOrColWithinStickerBounds(int stickerLength, int start, int curr) {
-    int max = start + stickerLength - 1;
-
-    if (curr >= start && curr < max) {
-        return true;
-    }
-    return false;
-}
-
-/* Returns true if column is within bounds, false if not */
-bool isColWithinStickerBounds(int numStickerRows, int startRow, int currRow) {
-    int maxRow = startRow + numStickerRows - 1;
-
-    if (currRow >= startRow && currRow < maxRow) {
-        return true;
-    }
-    return false;
-}
-/* Returns true if the pixel's shade of green falls outside of the threshold
- *
- * Compares the pixel's green values to the const GREEN green value.
- * If difference is greater than threshold, returns true. Else returns false
- */
-bool isOutsideGreenThreshold(int pixel, int threshold) {
-
-    int redA, greenA, blueA, redB, greenB, blueB;
-    GBufferedImage::getRedGreenBlue(pixel, redA, greenA, blueA);
-    GBufferedImage::getRedGreenBlue(GREEN, redB, greenB, blueB);
-
-    int diff = abs(greenA - greenB);
-    if (diff > threshold) {
-        return true;
-    }
-    return false;
-}
-
 /*  Attempts to save the image file to 'filename'.
  *
  * This function returns true when the image was successfully saved
@@ -431,16 +391,58 @@ bool saveImageToFilename(const GBufferedImage &img, string filename) {
 }
 
 /* 
- * Waits for a mouse click in the GWindow and reports click location.
+ * Waits for a mouse click in the GWindow and reports click location,
+ * drawing the sticker in img wherever the mouse is so the user can see
+ * where it will go.
  *
  * When this function returns, row and col are set to the row and
- * column where a mouse click was detected.
+ * column where a mouse click was detected, and img is as it was.
+ * Each move puts back the pixels the sticker covered and draws it over
+ * the new spot, so only those two rectangles of img change.
  */
-void getMouseClickLocation(int &row, int &col) {
+void getStickerClickLocation(GBufferedImage &img, const StickerMask &mask, int &row, int &col) {
+    const Grid<int>& shown = img.toGridView();
+    const Grid<int>& sticker = mask.getSticker();
+    Grid<int> covered;   // img's pixels under the sticker, at (coveredRow, coveredCol)
+    Grid<int> preview;
+    int coveredRow = 0;
+    int coveredCol = 0;
     GMouseEvent me;
-    do {
-        me = getNextEvent(MOUSE_EVENT);
-    } while (me.getEventType() != MOUSE_CLICKED);
+    while (true) {
+        me = waitForEvent(MOUSE_EVENT);
+        // skip the moves that came in while the sticker was being drawn
+        while (me.getEventType() != MOUSE_CLICKED) {
+            GMouseEvent next = getNextEvent(MOUSE_EVENT);
+            if (!next.isValid()) {
+                break;
+            }
+            me = next;
+        }
+        if (!covered.isEmpty()) {
+            img.setRGBRect(coveredCol, coveredRow, covered.numCols(), covered.numRows(), covered.data());
+            covered.resize(0, 0);
+        }
+        if (me.getEventType() == MOUSE_CLICKED) {
+            break;
+        }
+        coveredRow = me.getY();
+        coveredCol = me.getX();
+        if (!shown.inBounds(coveredRow, coveredCol)) {
+            continue;
+        }
+        int rows = min(sticker.numRows(), shown.numRows() - coveredRow);
+        int cols = min(sticker.numCols(), shown.numCols() - coveredCol);
+        covered.resize(rows, cols);
+        for (int r = 0; r < rows; r++) {
+            const int* from = shown.rowPtr(coveredRow + r) + coveredCol;
+            copy(from, from + cols, covered.rowPtr(r));
+        }
+        preview = covered;
+        OutputTile tile = { coveredRow, coveredCol, rows, cols, shown.numRows(), shown.numCols(),
+                            preview.data(), cols };
+        mask.draw(coveredRow, coveredCol, tile);
+        img.setRGBRect(coveredCol, coveredRow, cols, rows, preview.data());
+    }
     row = me.getY();
     col = me.getX();
 }
@@ -450,41 +452,76 @@ void doCompare(GBufferedImage &img) {
 
     GBufferedImage img2;
     getSecondImg(img2);
-    cout << "These images differ in " << img.countDiffPixels(img2) << " pixel locations!" << endl;
+    int diffs;
+    {
+        profiler::StageTimer timer("filter: compare");
+        diffs = img.countDiffPixels(img2);
+    }
+    cout << "These images differ in " << diffs << " pixel locations!" << endl;
 }
 
-/* 
- * Takes a radius and computes a 1-dimensional Gaussian blur kernel
- * with that radius. The 1-dimensional kernel can be applied to a
- * 2-dimensional image in two separate passes: first pass goes over
- * each row and does the horizontal convolutions, second pass goes
- * over each column and does the vertical convolutions. This is more
- * efficient than creating a 2-dimensional kernel and applying it in
- * one convolution pass.
- *
- * This code is based on the C# code posted by Stack Overflow user
- * "Cecil has a name" at this link:
- * http://stackoverflow.com/questions/1696113/how-do-i-gaussian-blur-an-image-without-using-any-in-built-gaussian-functions
- *
+/* Applies a Gaussian blur to the image.
+ * Prompts user for the blur radius and blurs with gaussKernelForRadius,
+ * first along rows and then along columns (see filters.h).
  */
-Vector<double> gaussKernelForRadius(int radius) {
-    if (radius < 1) {
-        Vector<double> empty;
-        return empty;
-    }
-    Vector<double> kernel(radius * 2 + 1);
-    double magic1 = 1.0 / (2.0 * radius * radius);
-    double magic2 = 1.0 / (sqrt(2.0 * PI) * radius);
-    int r = -radius;
-    double div = 0.0;
-    for (int i = 0; i < kernel.size(); i++) {
-        double x = r * r;
-        kernel[i] = magic2 * exp(-x * magic1);
-        r++;
-        div += kernel[i];
+Grid<int> doBlur(const Grid<int>& original) {
+    int radius = getInteger("Enter blur radius [1 - 100]: ");
+    profiler::StageTimer timer("filter: blur");
+    return filtercache::run("blur radius=" + integerToString(radius), original, [&]() {
+        return blurImage(original, gaussKernelForRadius(radius));
+    });
+}
+
+/* Applies several filters one after another, tile by tile, without making
+ * a full-size image in between (see pipeline.h).
+ * Prompts user for the filters to chain, then for each filter's settings.
+ */
+Grid<int> doChain(GBufferedImage& img, const Grid<int>& original) {
+    Vector<int> filters;
+    while (filters.isEmpty()) {
+        string chain = getLine("Enter the filters to apply in order, separated by spaces (1, 2, 3, or 5): ");
+        for (string token : stringSplit(trim(chain), " ")) {
+            if (token == "1" || token == "2" || token == "3" || token == "5") {
+                filters.add(stringToInteger(token));
+            } else if (token != "") {
+                cout << "\"" << token << "\" is not a filter that can be chained. Let's try this again." << endl;
+                filters.clear();
+                break;
+            }
+        }
     }
-    for (int i = 0; i < kernel.size(); i++) {
-        kernel[i] /= div;
+
+    FilterPipeline pipeline;
+    string description = "chain";
+    for (int n : filters) {
+        if (n == 1) {
+            int radius = getInteger("Enter degree of scatter [1 - 100]: ");
+            unsigned long long seed = getScatterSeed();
+            pipeline.addStage(scatterStage(radius, seed));
+            description += " | scatter radius=" + integerToString(radius) + " seed=" + std::to_string(seed);
+        } else if (n == 2) {
+            int threshold = getThreshold("Enter threshold for edge detection: ");
+            pipeline.addStage(edgeDetectStage(threshold));
+            description += " | edge detection threshold=" + integerToString(threshold);
+        } else if (n == 3) {
+            GBufferedImage sticker;
+            int stickerRow;
+            int stickerCol;
+            cout << "Now choose another file to add to your background image" << endl;
+            getSecondImg(sticker);
+            int threshold = getThreshold("Now choose a tolerance threshold: ");
+            StickerMask mask(sticker.toGridView(), threshold);
+            getStickerLocation(img, mask, stickerRow, stickerCol);
+            pipeline.addStage(greenScreenStage(mask, stickerRow, stickerCol));
+            description += " | " + describeGreenScreen(mask, threshold, stickerRow, stickerCol);
+        } else {
+            int radius = getInteger("Enter blur radius [1 - 100]: ");
+            pipeline.addStage(blurStage(gaussKernelForRadius(radius)));
+            description += " | blur radius=" + integerToString(radius);
+        }
     }
-    return kernel;
+    profiler::StageTimer timer("filter: chain");
+    return filtercache::run(description, original, [&]() {
+        return pipeline.run(original);
+    });
 }
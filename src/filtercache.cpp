@@ -0,0 +1,96 @@
+/*
+ * File: filtercache.cpp
+ * ---------------------
+ * Implements the filter cache, declared in filtercache.h.
+ */
+
+#include "filtercache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "profiler.h"
+
+namespace filtercache {
+
+static const long long DEFAULT_BUDGET_MB = 256;
+
+static GridCache* createCache() {
+    long long budget = DEFAULT_BUDGET_MB * 1024 * 1024;
+    char* budgetMB = getenv("FAUXTOSHOP_CACHE_MB");
+    if (budgetMB != NULL && budgetMB[0] != '\0' && atoll(budgetMB) >= 0) {
+        budget = atoll(budgetMB) * 1024 * 1024;
+    }
+    char* dir = getenv("FAUXTOSHOP_CACHE_DIR");
+    return new GridCache("filter cache", budget, dir != NULL ? dir : "");
+}
+
+GridCache& getCache() {
+    static GridCache* cache = createCache();
+    return *cache;
+}
+
+std::string describe(const Grid<int>& grid) {
+    char description[64];
+    snprintf(description, sizeof(description), "%016llx %dx%d",
+             hashCode64(grid), grid.numRows(), grid.numCols());
+    return description;
+}
+
+/* One step of the checksum below: mixes a word into one of its lanes. */
+static inline unsigned long long checksumStep(unsigned long long hash, unsigned long long word) {
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 29);
+}
+
+/*
+ * Returns a second hash of the grid's pixels, in hex, which is stored as the
+ * version of each result and checked whenever the result is found again.
+ * It is built differently from hashCode64, as multiply-and-XOR chains over
+ * 64-bit words in four interleaved lanes, so images whose hashCode64s
+ * collide are not expected to collide here as well.
+ */
+static std::string checksum(const Grid<int>& grid) {
+    const unsigned char* bytes = (const unsigned char*) grid.data();
+    size_t length = (size_t) grid.numRows() * grid.numCols() * sizeof(int);
+    unsigned long long lanes[4] = { 0, 1, 2, 3 };
+    size_t i = 0;
+    for (; i + sizeof(lanes) <= length; i += sizeof(lanes)) {
+        unsigned long long words[4];
+        memcpy(words, bytes + i, sizeof(words));
+        for (int lane = 0; lane < 4; lane++) {
+            lanes[lane] = checksumStep(lanes[lane], words[lane]);
+        }
+    }
+    unsigned long long tail[4] = { 0, 0, 0, 0 };
+    memcpy(tail, bytes + i, length - i);
+    unsigned long long hash = length;
+    for (int lane = 0; lane < 4; lane++) {
+        hash = checksumStep(hash, checksumStep(lanes[lane], tail[lane]));
+    }
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", hash);
+    return hex;
+}
+
+Grid<int> run(const std::string& filter, const Grid<int>& source,
+              const std::function<Grid<int>()>& compute) {
+    GridCache& cache = getCache();
+    if (cache.getBudget() == 0 && cache.getSpillDirectory().empty()) {
+        return compute();   // the cache is off; don't bother hashing
+    }
+    std::string key;
+    std::string check;
+    {
+        profiler::StageTimer timer("filter cache hash");
+        key = filter + " on " + describe(source);
+        check = checksum(source);
+    }
+    Grid<int> result;
+    if (!cache.lookup(key, check, result)) {
+        result = compute();
+        cache.store(key, check, result);
+    }
+    return result;
+}
+
+} // namespace filtercache
@@ -0,0 +1,56 @@
+/*
+ * File: filtercache.h
+ * -------------------
+ * The filter cache remembers the images Fauxtoshop's filters have made,
+ * so that running a filter again on the same image with the same settings
+ * (as when trying several settings on one image, one after another) gives
+ * back the earlier result instead of computing it again.
+ *
+ * Results are keyed on a description of the filter and its settings
+ * together with a 64-bit hash of the source image's pixels (see hashCode64
+ * in grid.h), so a result is found again whichever file or earlier filter
+ * the image came from.  Each result also records a second hash of its
+ * source, computed a different way, and is only given back if that one
+ * matches too, so a collision of the 64-bit hashes alone does not hand one
+ * image another's result, from memory or from disk.  Results are kept in a
+ * GridCache (see gridcache.h) named "filter cache", within a budget of
+ * 256 MB by default, which can be changed with the FAUXTOSHOP_CACHE_MB
+ * environment variable; 0 turns the cache off.  If FAUXTOSHOP_CACHE_DIR
+ * names a directory, results are also kept there, so later runs of
+ * Fauxtoshop can use them too.
+ */
+
+#ifndef _filtercache_h
+#define _filtercache_h
+
+#include <functional>
+#include <string>
+#include "grid.h"
+#include "gridcache.h"
+
+namespace filtercache {
+
+/*
+ * Returns a short description of the grid's contents: its 64-bit hash in
+ * hex and its size, such as "1f3a...c2 480x640".  Grids with the same
+ * description almost certainly hold the same pixels.
+ */
+std::string describe(const Grid<int>& grid);
+
+/*
+ * Returns the result of the filter described by filter applied to source:
+ * the stored one if there is one, and otherwise the one returned by
+ * compute, which is stored for next time.  filter must name the filter and
+ * every setting that changes its result, such as "blur radius=5".
+ */
+Grid<int> run(const std::string& filter, const Grid<int>& source,
+              const std::function<Grid<int>()>& compute);
+
+/*
+ * Returns the cache itself, to read its counters or change its budget.
+ */
+GridCache& getCache();
+
+} // namespace filtercache
+
+#endif
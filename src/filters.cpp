@@ -0,0 +1,1207 @@
+/*
+ * File: filters.cpp
+ * -----------------
+ * Implements the image filter kernels declared in filters.h.
+ */
+
+#include "filters.h"
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "parallel.h"
+
+// the vectorized kernels use GCC/Clang target attributes and CPU detection
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SPL_FILTERS_X86
+#  include <immintrin.h>
+#endif
+
+using namespace std;
+
+static const int WHITE = 0xFFFFFF;
+static const int BLACK = 0x000000;
+
+// rows are handed to threads in bands of about this many pixels
+static const int PIXELS_PER_BAND = 64 * 1024;
+
+/* Returns how many rows of the given width make up one parallel band. */
+static int rowsPerBand(int width) {
+    return max(1, PIXELS_PER_BAND / max(1, width));
+}
+
+/*
+ * Returns the counter'th output of the SplitMix64 generator started from
+ * seed.  Each output depends only on seed + counter * gamma, so it can be
+ * computed directly from a pixel's index, without stepping through the ones
+ * before it or sharing generator state between threads.
+ */
+static inline uint64_t splitMix64(uint64_t seed, uint64_t counter) {
+    uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Maps 32 random bits onto the range [low, high] by multiply-and-shift. */
+static inline int randomInRange(uint32_t bits, int low, int high) {
+    return low + (int) (((uint64_t) bits * (uint32_t) (high - low + 1)) >> 32);
+}
+
+/* Scatters the pixels of out, reading from in. */
+static void scatterTile(const InputTile& in, const OutputTile& out, int radius, uint64_t seed) {
+    int rows = in.imageRows;
+    int cols = in.imageCols;
+    radius = max(0, radius);
+    for (int r = out.top; r < out.top + out.rows; r++) {
+        int rowLow = max(0, r - radius);
+        int rowHigh = min(rows - 1, r + radius);
+        int* dst = out.rowPtr(r);
+        uint64_t counter = (uint64_t) r * cols;
+        for (int c = out.left; c < out.left + out.cols; c++) {
+            // high half of the random bits picks the row, low half the column
+            uint64_t bits = splitMix64(seed, counter + c);
+            int sourceRow = randomInRange((uint32_t) (bits >> 32), rowLow, rowHigh);
+            int sourceCol = randomInRange((uint32_t) bits, max(0, c - radius),
+                                          min(cols - 1, c + radius));
+            dst[c - out.left] = in.rowPtr(sourceRow)[sourceCol - in.left];
+        }
+    }
+}
+
+void scatterRows(const Grid<int>& original, Grid<int>& result, int radius,
+                 unsigned long long seed, int rowStart, int rowEnd) {
+    scatterTile(viewRows(original, 0, original.numRows()), viewRows(result, rowStart, rowEnd),
+                radius, seed);
+}
+
+Grid<int> scatterImage(const Grid<int>& original, int radius, unsigned long long seed) {
+    Grid<int> result(original.numRows(), original.numCols());
+    parallel::forEachRange(0, original.numRows(), rowsPerBand(original.numCols()),
+                           [&](int start, int end) {
+        scatterRows(original, result, radius, seed, start, end);
+    });
+    return result;
+}
+
+/* Returns the largest difference between the red, green, or blue parts of two pixels. */
+static inline int channelDiff(int pixelA, int pixelB) {
+    int red = abs(((pixelA >> 16) & 0xFF) - ((pixelB >> 16) & 0xFF));
+    int green = abs(((pixelA >> 8) & 0xFF) - ((pixelB >> 8) & 0xFF));
+    int blue = abs((pixelA & 0xFF) - (pixelB & 0xFF));
+    return max(max(red, green), blue);
+}
+
+/* Edge color of pixel (r, c) of in, looking only at the neighbors inside the image. */
+static int edgePixelClipped(const InputTile& in, int r, int c, int threshold) {
+    int pixel = in.rowPtr(r)[c - in.left];
+    for (int row = max(0, r - 1); row <= min(in.imageRows - 1, r + 1); row++) {
+        const int* neighbors = in.rowPtr(row);
+        for (int col = max(0, c - 1); col <= min(in.imageCols - 1, c + 1); col++) {
+            if (channelDiff(pixel, neighbors[col - in.left]) > threshold) {
+                return BLACK;
+            }
+        }
+    }
+    return WHITE;
+}
+
+/* Largest difference between pixel (r, c) of in and the neighbors inside the image. */
+static int diffPixelClipped(const InputTile& in, int r, int c) {
+    int pixel = in.rowPtr(r)[c - in.left];
+    int largest = 0;
+    for (int row = max(0, r - 1); row <= min(in.imageRows - 1, r + 1); row++) {
+        const int* neighbors = in.rowPtr(row);
+        for (int col = max(0, c - 1); col <= min(in.imageCols - 1, c + 1); col++) {
+            largest = max(largest, channelDiff(pixel, neighbors[col - in.left]));
+        }
+    }
+    return largest;
+}
+
+/* Largest difference between interior pixel c of row and its neighbors. */
+static inline int diffPixelInterior(const int* above, const int* row, const int* below, int c) {
+    int pixel = row[c];
+    const int* neighbors[3] = { above, row, below };
+    int largest = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int col = c - 1; col <= c + 1; col++) {
+            largest = max(largest, channelDiff(pixel, neighbors[i][col]));
+        }
+    }
+    return largest;
+}
+
+/* Edge color of interior pixel c of row, whose neighbors all exist. */
+static inline int edgePixelInterior(const int* above, const int* row, const int* below,
+                                    int c, int threshold) {
+    int pixel = row[c];
+    const int* neighbors[3] = { above, row, below };
+    for (int i = 0; i < 3; i++) {
+        for (int col = c - 1; col <= c + 1; col++) {
+            if (channelDiff(pixel, neighbors[i][col]) > threshold) {
+                return BLACK;
+            }
+        }
+    }
+    return WHITE;
+}
+
+/*
+ * An interior row kernel writes to out[0 .. count-1] the edge colors of
+ * pixels 1 .. count of a run of an interior row, given pointers to the run
+ * and to the runs above and below it, for as many pixels as it handles in
+ * whole blocks, and returns how many that was.  The threshold is already
+ * known to be in [0, 255].
+ */
+typedef int (*EdgeRowFunction)(const int*, const int*, const int*, int, int, int*);
+
+static int edgeRowScalar(const int*, const int*, const int*, int, int, int*) {
+    return 0;
+}
+
+/*
+ * A difference row kernel is like an interior row kernel, but writes each
+ * pixel's largest difference from its neighbors instead of its edge color.
+ */
+typedef int (*DiffRowFunction)(const int*, const int*, const int*, int, uint8_t*);
+
+static int diffRowScalar(const int*, const int*, const int*, int, uint8_t*) {
+    return 0;
+}
+
+/*
+ * A threshold row kernel writes the edge colors of count pixels given
+ * their largest differences, for as many pixels as it handles in whole
+ * blocks, and returns how many that was.  The bits form packs the edges
+ * into 64-bit words instead, handling whole words only.  The threshold is
+ * already known to be in [0, 254].
+ */
+typedef int (*ThresholdRowFunction)(const uint8_t*, int, int, int*);
+typedef int (*ThresholdBitsFunction)(const uint8_t*, int, int, uint64_t*);
+
+static int thresholdRowScalar(const uint8_t*, int, int, int*) {
+    return 0;
+}
+
+static int thresholdBitsScalar(const uint8_t*, int, int, uint64_t*) {
+    return 0;
+}
+
+/*
+ * A sticker bits kernel sets bit i of the 64-bit words to whether the
+ * green value of sticker pixel i is below limit, for the first count
+ * pixels, handling whole words only, and returns how many pixels that was.
+ */
+typedef int (*StickerBitsFunction)(const int*, int, int, uint64_t*);
+
+static int stickerBitsScalar(const int*, int, int, uint64_t*) {
+    return 0;
+}
+
+// blur weights are fixed point with this many fraction bits, summing to 1
+static const int WEIGHT_BITS = 14;
+
+/*
+ * A blur row kernel convolves width pixels with a kernel of 2 * pairCount
+ * taps, given as pairs of 16-bit weights packed into ints (the even tap in
+ * the low half), reading padded[x .. x + 2 * pairCount - 1] for output x.
+ * It writes as many pixels as it handles in whole blocks and returns how
+ * many that was.
+ */
+typedef int (*BlurRowFunction)(const int*, int, const int*, int, int*);
+
+static int blurRowScalar(const int*, int, const int*, int, int*) {
+    return 0;
+}
+
+/*
+ * A box row kernel box-blurs width pixels with the given radius, reading
+ * padded[x .. x + 2 * radius] for output x.  A running sum makes the cost
+ * per pixel the same for any radius.  Averages are sums times a float
+ * reciprocal of the window, rounded to nearest even, in every version.
+ */
+typedef void (*BoxRowFunction)(const int*, int, int, int*);
+
+static void boxRowScalar(const int* padded, int width, int radius, int* out) {
+    int window = 2 * radius + 1;
+    float scale = 1.0f / window;
+    int sums[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < window; i++) {
+        for (int b = 0; b < 4; b++) {
+            sums[b] += (padded[i] >> (8 * b)) & 0xFF;
+        }
+    }
+    for (int x = 0; x < width; x++) {
+        unsigned int pixel = 0;
+        for (int b = 0; b < 4; b++) {
+            long average = lrintf((float) sums[b] * scale);
+            pixel |= (unsigned int) min(average, 255L) << (8 * b);
+            sums[b] += ((padded[x + window] >> (8 * b)) & 0xFF) - ((padded[x] >> (8 * b)) & 0xFF);
+        }
+        out[x] = (int) pixel;
+    }
+}
+
+#ifdef SPL_FILTERS_X86
+/*
+ * The vectorized kernels compare 8 pixels against each neighbor at a time
+ * as bytes: |a - b| is the OR of the two saturating differences, the max
+ * over the 8 neighbors is kept, and a pixel is an edge if any of its red,
+ * green, or blue bytes still exceeds the threshold after a saturating
+ * subtract.  The alpha byte is masked off before that test.
+ */
+__attribute__((target("sse2")))
+static inline __m128i absDiff128(__m128i a, __m128i b) {
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+// per-byte largest differences of the 4 interior pixels starting at column c
+__attribute__((target("sse2")))
+static inline __m128i diffBlock128(const int* above, const int* row, const int* below, int c) {
+    __m128i pixel = _mm_loadu_si128((const __m128i*) (row + c));
+    __m128i diff = absDiff128(pixel, _mm_loadu_si128((const __m128i*) (row + c - 1)));
+    diff = _mm_max_epu8(diff, absDiff128(pixel, _mm_loadu_si128((const __m128i*) (row + c + 1))));
+    const int* neighbors[2] = { above, below };
+    for (int i = 0; i < 2; i++) {
+        for (int col = c - 1; col <= c + 1; col++) {
+            __m128i other = _mm_loadu_si128((const __m128i*) (neighbors[i] + col));
+            diff = _mm_max_epu8(diff, absDiff128(pixel, other));
+        }
+    }
+    return diff;
+}
+
+// edge colors of the 4 interior pixels starting at column c
+__attribute__((target("sse2")))
+static inline __m128i edgeBlock128(const int* above, const int* row, const int* below,
+                                   int c, __m128i limit) {
+    __m128i diff = diffBlock128(above, row, below, c);
+    __m128i rgb = _mm_set1_epi32(WHITE);
+    __m128i over = _mm_and_si128(_mm_subs_epu8(diff, limit), rgb);
+    return _mm_and_si128(_mm_cmpeq_epi32(over, _mm_setzero_si128()), rgb);
+}
+
+__attribute__((target("sse2")))
+static int edgeRowSse(const int* above, const int* row, const int* below,
+                      int count, int threshold, int* out) {
+    __m128i limit = _mm_set1_epi8((char) threshold);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_si128((__m128i*) (out + i), edgeBlock128(above, row, below, i + 1, limit));
+        _mm_storeu_si128((__m128i*) (out + i + 4), edgeBlock128(above, row, below, i + 5, limit));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i absDiff256(__m256i a, __m256i b) {
+    return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+}
+
+// per-byte largest differences of the 8 interior pixels starting at column c
+__attribute__((target("avx2")))
+static inline __m256i diffBlock256(const int* above, const int* row, const int* below, int c) {
+    __m256i pixel = _mm256_loadu_si256((const __m256i*) (row + c));
+    __m256i diff = absDiff256(pixel, _mm256_loadu_si256((const __m256i*) (row + c - 1)));
+    diff = _mm256_max_epu8(diff, absDiff256(pixel, _mm256_loadu_si256((const __m256i*) (row + c + 1))));
+    const int* neighbors[2] = { above, below };
+    for (int i = 0; i < 2; i++) {
+        for (int col = c - 1; col <= c + 1; col++) {
+            __m256i other = _mm256_loadu_si256((const __m256i*) (neighbors[i] + col));
+            diff = _mm256_max_epu8(diff, absDiff256(pixel, other));
+        }
+    }
+    return diff;
+}
+
+// edge colors of the 8 interior pixels starting at column c
+__attribute__((target("avx2")))
+static inline __m256i edgeBlock256(const int* above, const int* row, const int* below,
+                                   int c, __m256i limit) {
+    __m256i diff = diffBlock256(above, row, below, c);
+    __m256i rgb = _mm256_set1_epi32(WHITE);
+    __m256i over = _mm256_and_si256(_mm256_subs_epu8(diff, limit), rgb);
+    return _mm256_and_si256(_mm256_cmpeq_epi32(over, _mm256_setzero_si256()), rgb);
+}
+
+__attribute__((target("avx2")))
+static int edgeRowAvx2(const int* above, const int* row, const int* below,
+                       int count, int threshold, int* out) {
+    __m256i limit = _mm256_set1_epi8((char) threshold);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm256_storeu_si256((__m256i*) (out + i), edgeBlock256(above, row, below, i + 1, limit));
+        _mm256_storeu_si256((__m256i*) (out + i + 8), edgeBlock256(above, row, below, i + 9, limit));
+    }
+    if (i + 8 <= count) {
+        _mm256_storeu_si256((__m256i*) (out + i), edgeBlock256(above, row, below, i + 1, limit));
+        i += 8;
+    }
+    return i;
+}
+
+/*
+ * The difference kernels take the largest of each pixel's red, green, and
+ * blue differences by shifting the other two down onto the blue byte, and
+ * narrow the 32-bit results to bytes with saturating packs.
+ */
+__attribute__((target("sse2")))
+static inline __m128i pixelMax128(__m128i diff) {
+    diff = _mm_and_si128(diff, _mm_set1_epi32(WHITE));
+    diff = _mm_max_epu8(diff, _mm_max_epu8(_mm_srli_epi32(diff, 8), _mm_srli_epi32(diff, 16)));
+    return _mm_and_si128(diff, _mm_set1_epi32(0xFF));
+}
+
+__attribute__((target("sse2")))
+static int diffRowSse(const int* above, const int* row, const int* below,
+                      int count, uint8_t* out) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i words = _mm_packs_epi32(pixelMax128(diffBlock128(above, row, below, i + 1)),
+                                        pixelMax128(diffBlock128(above, row, below, i + 5)));
+        _mm_storel_epi64((__m128i*) (out + i), _mm_packus_epi16(words, words));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pixelMax256(__m256i diff) {
+    diff = _mm256_and_si256(diff, _mm256_set1_epi32(WHITE));
+    diff = _mm256_max_epu8(diff, _mm256_max_epu8(_mm256_srli_epi32(diff, 8),
+                                                 _mm256_srli_epi32(diff, 16)));
+    return _mm256_and_si256(diff, _mm256_set1_epi32(0xFF));
+}
+
+__attribute__((target("avx2")))
+static int diffRowAvx2(const int* above, const int* row, const int* below,
+                       int count, uint8_t* out) {
+    // the packs work within 128-bit lanes, leaving the 4-pixel groups in
+    // the order 0, 2, (zeros), 1, 3, (zeros); the permute puts them back
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 3, 6, 7);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i words = _mm256_packs_epi32(pixelMax256(diffBlock256(above, row, below, i + 1)),
+                                           pixelMax256(diffBlock256(above, row, below, i + 9)));
+        __m256i bytes = _mm256_packus_epi16(words, _mm256_setzero_si256());
+        bytes = _mm256_permutevar8x32_epi32(bytes, order);
+        _mm_storeu_si128((__m128i*) (out + i), _mm256_castsi256_si128(bytes));
+    }
+    return i;
+}
+
+// a pixel is an edge if its difference exceeds the threshold: edges are 0, others WHITE
+__attribute__((target("sse2")))
+static int thresholdRowSse(const uint8_t* diffs, int count, int threshold, int* out) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i limit = _mm_set1_epi32(threshold);
+    __m128i white = _mm_set1_epi32(WHITE);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (diffs + i));
+        __m128i words[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+        for (int w = 0; w < 2; w++) {
+            __m128i low = _mm_unpacklo_epi16(words[w], zero);
+            __m128i high = _mm_unpackhi_epi16(words[w], zero);
+            _mm_storeu_si128((__m128i*) (out + i + 8 * w),
+                             _mm_andnot_si128(_mm_cmpgt_epi32(low, limit), white));
+            _mm_storeu_si128((__m128i*) (out + i + 8 * w + 4),
+                             _mm_andnot_si128(_mm_cmpgt_epi32(high, limit), white));
+        }
+    }
+    return i;
+}
+
+// bytes compare unsigned as d >= threshold + 1, that is max(d, threshold + 1) == d
+__attribute__((target("sse2")))
+static int thresholdBitsSse(const uint8_t* diffs, int count, int threshold, uint64_t* words) {
+    __m128i limit = _mm_set1_epi8((char) (threshold + 1));
+    int i = 0;
+    for (; i + 64 <= count; i += 64) {
+        uint64_t bits = 0;
+        for (int part = 0; part < 4; part++) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) (diffs + i + 16 * part));
+            __m128i edges = _mm_cmpeq_epi8(_mm_max_epu8(bytes, limit), bytes);
+            bits |= (uint64_t) (uint16_t) _mm_movemask_epi8(edges) << (16 * part);
+        }
+        words[i / 64] = bits;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int thresholdRowAvx2(const uint8_t* diffs, int count, int threshold, int* out) {
+    __m256i limit = _mm256_set1_epi32(threshold);
+    __m256i white = _mm256_set1_epi32(WHITE);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i values = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (diffs + i)));
+        _mm256_storeu_si256((__m256i*) (out + i),
+                            _mm256_andnot_si256(_mm256_cmpgt_epi32(values, limit), white));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int thresholdBitsAvx2(const uint8_t* diffs, int count, int threshold, uint64_t* words) {
+    __m256i limit = _mm256_set1_epi8((char) (threshold + 1));
+    int i = 0;
+    for (; i + 64 <= count; i += 64) {
+        __m256i low = _mm256_loadu_si256((const __m256i*) (diffs + i));
+        __m256i high = _mm256_loadu_si256((const __m256i*) (diffs + i + 32));
+        uint32_t lowBits = (uint32_t) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_max_epu8(low, limit), low));
+        uint32_t highBits = (uint32_t) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_max_epu8(high, limit), high));
+        words[i / 64] = (uint64_t) highBits << 32 | lowBits;
+    }
+    return i;
+}
+// the sign bit of each compared lane becomes one bit of the word
+__attribute__((target("sse2")))
+static int stickerBitsSse(const int* sticker, int count, int limit, uint64_t* words) {
+    __m128i greenMask = _mm_set1_epi32(0xFF);
+    __m128i limits = _mm_set1_epi32(limit);
+    int i = 0;
+    for (; i + 64 <= count; i += 64) {
+        uint64_t bits = 0;
+        for (int j = 0; j < 64; j += 4) {
+            __m128i pixel = _mm_loadu_si128((const __m128i*) (sticker + i + j));
+            __m128i green = _mm_and_si128(_mm_srli_epi32(pixel, 8), greenMask);
+            __m128i keep = _mm_cmplt_epi32(green, limits);
+            bits |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(keep)) << j;
+        }
+        words[i / 64] = bits;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int stickerBitsAvx2(const int* sticker, int count, int limit, uint64_t* words) {
+    __m256i greenMask = _mm256_set1_epi32(0xFF);
+    __m256i limits = _mm256_set1_epi32(limit);
+    int i = 0;
+    for (; i + 64 <= count; i += 64) {
+        uint64_t bits = 0;
+        for (int j = 0; j < 64; j += 8) {
+            __m256i pixel = _mm256_loadu_si256((const __m256i*) (sticker + i + j));
+            __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixel, 8), greenMask);
+            __m256i keep = _mm256_cmpgt_epi32(limits, green);
+            bits |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(keep)) << j;
+        }
+        words[i / 64] = bits;
+    }
+    return i;
+}
+/*
+ * The blur kernels widen each pixel's four bytes to 16 bits, interleave
+ * them with the next tap's, and use pmaddwd to apply two weights per
+ * instruction, giving 32-bit sums for every byte of several pixels at once.
+ */
+__attribute__((target("sse2")))
+static int blurRowSse(const int* padded, int width, const int* pairs, int pairCount, int* out) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i half = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        __m128i sum0 = half;   // bytes of pixel x
+        __m128i sum1 = half;   // bytes of pixel x + 1
+        for (int i = 0; i < pairCount; i++) {
+            const int* taps = padded + x + 2 * i;
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) taps), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (taps + 1)), zero);
+            __m128i weights = _mm_set1_epi32(pairs[i]);
+            sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights));
+            sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights));
+        }
+        __m128i words = _mm_packs_epi32(_mm_srai_epi32(sum0, WEIGHT_BITS),
+                                        _mm_srai_epi32(sum1, WEIGHT_BITS));
+        _mm_storel_epi64((__m128i*) (out + x), _mm_packus_epi16(words, words));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static int blurRowAvx2(const int* padded, int width, const int* pairs, int pairCount, int* out) {
+    __m256i half = _mm256_set1_epi32(1 << (WEIGHT_BITS - 1));
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        // each 128-bit lane holds two pixels: x and x + 2, then x + 1 and x + 3
+        __m256i sumEven = half;
+        __m256i sumOdd = half;
+        for (int i = 0; i < pairCount; i++) {
+            const int* taps = padded + x + 2 * i;
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) taps));
+            __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (taps + 1)));
+            __m256i weights = _mm256_set1_epi32(pairs[i]);
+            sumEven = _mm256_add_epi32(sumEven, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights));
+            sumOdd = _mm256_add_epi32(sumOdd, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights));
+        }
+        __m256i words = _mm256_packs_epi32(_mm256_srai_epi32(sumEven, WEIGHT_BITS),
+                                           _mm256_srai_epi32(sumOdd, WEIGHT_BITS));
+        __m256i bytes = _mm256_packus_epi16(words, words);
+        bytes = _mm256_permute4x64_epi64(bytes, 0x08);   // low 8 bytes of each lane
+        _mm_storeu_si128((__m128i*) (out + x), _mm256_castsi256_si128(bytes));
+    }
+    return x;
+}
+// widens the four bytes of a pixel to 32-bit lanes
+__attribute__((target("sse2")))
+static inline __m128i widenPixel(int pixel) {
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+}
+
+__attribute__((target("sse2")))
+static void boxRowSse(const int* padded, int width, int radius, int* out) {
+    int window = 2 * radius + 1;
+    __m128 scale = _mm_set1_ps(1.0f / window);
+    __m128i sums = _mm_setzero_si128();
+    for (int i = 0; i < window; i++) {
+        sums = _mm_add_epi32(sums, widenPixel(padded[i]));
+    }
+    for (int x = 0; x < width; x++) {
+        __m128i average = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sums), scale));
+        __m128i words = _mm_packs_epi32(average, average);
+        out[x] = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        sums = _mm_add_epi32(sums, widenPixel(padded[x + window]));
+        sums = _mm_sub_epi32(sums, widenPixel(padded[x]));
+    }
+}
+#endif // SPL_FILTERS_X86
+
+/* The vectorized kernels for this CPU, or scalar stand-ins. */
+struct Kernels {
+    EdgeRowFunction edgeRow;
+    DiffRowFunction diffRow;
+    ThresholdRowFunction thresholdRow;
+    ThresholdBitsFunction thresholdBits;
+    StickerBitsFunction stickerBits;
+    BlurRowFunction blurRow;
+    BoxRowFunction boxRow;
+};
+
+static Kernels chooseKernels() {
+    Kernels kernels;
+    kernels.edgeRow = edgeRowScalar;
+    kernels.diffRow = diffRowScalar;
+    kernels.thresholdRow = thresholdRowScalar;
+    kernels.thresholdBits = thresholdBitsScalar;
+    kernels.stickerBits = stickerBitsScalar;
+    kernels.blurRow = blurRowScalar;
+    kernels.boxRow = boxRowScalar;
+#ifdef SPL_FILTERS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.edgeRow = edgeRowAvx2;
+        kernels.diffRow = diffRowAvx2;
+        kernels.thresholdRow = thresholdRowAvx2;
+        kernels.thresholdBits = thresholdBitsAvx2;
+        kernels.stickerBits = stickerBitsAvx2;
+        kernels.blurRow = blurRowAvx2;
+        kernels.boxRow = boxRowSse;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernels.edgeRow = edgeRowSse;
+        kernels.diffRow = diffRowSse;
+        kernels.thresholdRow = thresholdRowSse;
+        kernels.thresholdBits = thresholdBitsSse;
+        kernels.stickerBits = stickerBitsSse;
+        kernels.blurRow = blurRowSse;
+        kernels.boxRow = boxRowSse;
+    }
+#endif // SPL_FILTERS_X86
+    return kernels;
+}
+
+// picked the first time they are needed
+static const Kernels& getKernels() {
+    static Kernels kernels = chooseKernels();
+    return kernels;
+}
+
+/* Sets the edge colors of the pixels of out, reading from in. */
+static void edgeDetectTile(const InputTile& in, const OutputTile& out, int threshold) {
+    EdgeRowFunction kernel = getKernels().edgeRow;
+    int colStart = out.left;
+    int colEnd = out.left + out.cols;
+    // columns [interiorStart, interiorEnd) have all 8 neighbors in interior rows
+    int interiorStart = max(colStart, 1);
+    int interiorEnd = min(colEnd, in.imageCols - 1);
+    for (int r = out.top; r < out.top + out.rows; r++) {
+        int* dst = out.rowPtr(r);
+        if (threshold < 0) {
+            fill_n(dst, out.cols, BLACK);   // even a pixel compared with itself differs by more
+        } else if (r == 0 || r == in.imageRows - 1 || interiorStart >= interiorEnd) {
+            for (int c = colStart; c < colEnd; c++) {
+                dst[c - colStart] = edgePixelClipped(in, r, c, threshold);
+            }
+        } else {
+            for (int c = colStart; c < interiorStart; c++) {
+                dst[c - colStart] = edgePixelClipped(in, r, c, threshold);
+            }
+            int offset = interiorStart - 1 - in.left;
+            const int* above = in.rowPtr(r - 1) + offset;
+            const int* row = in.rowPtr(r) + offset;
+            const int* below = in.rowPtr(r + 1) + offset;
+            int count = interiorEnd - interiorStart;
+            int* interior = dst + (interiorStart - colStart);
+            int i = kernel(above, row, below, count, min(threshold, 255), interior);
+            for (; i < count; i++) {
+                interior[i] = edgePixelInterior(above, row, below, i + 1, threshold);
+            }
+            for (int c = interiorEnd; c < colEnd; c++) {
+                dst[c - colStart] = edgePixelClipped(in, r, c, threshold);
+            }
+        }
+    }
+}
+
+void edgeDetectRows(const Grid<int>& original, Grid<int>& result, int threshold,
+                    int rowStart, int rowEnd) {
+    edgeDetectTile(viewRows(original, 0, original.numRows()), viewRows(result, rowStart, rowEnd),
+                   threshold);
+}
+
+Grid<int> edgeDetectImage(const Grid<int>& original, int threshold) {
+    Grid<int> result(original.numRows(), original.numCols());
+    parallel::forEachRange(0, original.numRows(), rowsPerBand(original.numCols()),
+                           [&](int start, int end) {
+        edgeDetectRows(original, result, threshold, start, end);
+    });
+    return result;
+}
+
+Bitmap edgeDetectBitmap(const Grid<int>& original, int threshold) {
+    int rows = original.numRows();
+    int cols = original.numCols();
+    Bitmap result(rows, cols);
+    parallel::forEachRange(0, rows, rowsPerBand(cols), [&](int start, int end) {
+        // each row's colors go through a one-row buffer and are packed into bits
+        vector<int> colors(cols);
+        InputTile in = viewRows(original, 0, rows);
+        for (int r = start; r < end; r++) {
+            OutputTile out = { r, 0, 1, cols, rows, cols, colors.data(), cols };
+            edgeDetectTile(in, out, threshold);
+            uint64_t* words = result.rowWords(r);
+            for (int c = 0; c < cols; c++) {
+                words[c / 64] |= (uint64_t) (colors[c] == BLACK) << (c % 64);
+            }
+        }
+    });
+    return result;
+}
+
+/* Sets diffs[c] to the largest difference of pixel (r, c) of in, which spans the image. */
+static void diffRow(const InputTile& in, int r, uint8_t* diffs) {
+    int cols = in.imageCols;
+    if (r == 0 || r == in.imageRows - 1 || cols < 3) {
+        for (int c = 0; c < cols; c++) {
+            diffs[c] = (uint8_t) diffPixelClipped(in, r, c);
+        }
+        return;
+    }
+    diffs[0] = (uint8_t) diffPixelClipped(in, r, 0);
+    const int* above = in.rowPtr(r - 1);
+    const int* row = in.rowPtr(r);
+    const int* below = in.rowPtr(r + 1);
+    int count = cols - 2;
+    int i = getKernels().diffRow(above, row, below, count, diffs + 1);
+    for (; i < count; i++) {
+        diffs[i + 1] = (uint8_t) diffPixelInterior(above, row, below, i + 1);
+    }
+    diffs[cols - 1] = (uint8_t) diffPixelClipped(in, r, cols - 1);
+}
+
+EdgeDifferences::EdgeDifferences(const Grid<int>& original)
+        : differences(original.numRows(), original.numCols()), histogram(256, 0) {
+    int rows = original.numRows();
+    int cols = original.numCols();
+    mutex histogramLock;
+    parallel::forEachRange(0, rows, rowsPerBand(cols), [&](int start, int end) {
+        InputTile in = viewRows(original, 0, rows);
+        long long counts[256] = { 0 };
+        for (int r = start; r < end; r++) {
+            uint8_t* diffs = differences.rowPtr(r);
+            diffRow(in, r, diffs);
+            for (int c = 0; c < cols; c++) {
+                counts[diffs[c]]++;
+            }
+        }
+        lock_guard<mutex> guard(histogramLock);
+        for (int d = 0; d < 256; d++) {
+            histogram[d] += counts[d];
+        }
+    });
+}
+
+const Grid<uint8_t>& EdgeDifferences::getDifferences() const {
+    return differences;
+}
+
+const Vector<long long>& EdgeDifferences::getHistogram() const {
+    return histogram;
+}
+
+long long EdgeDifferences::countEdges(int threshold) const {
+    long long count = 0;
+    for (int d = max(0, threshold + 1); d < 256; d++) {
+        count += histogram[d];
+    }
+    return count;
+}
+
+Grid<int> EdgeDifferences::toImage(int threshold) const {
+    int rows = differences.numRows();
+    int cols = differences.numCols();
+    Grid<int> result(rows, cols);
+    if (threshold < 0 || threshold >= 255) {
+        result.fill(threshold < 0 ? BLACK : WHITE);
+        return result;
+    }
+    ThresholdRowFunction kernel = getKernels().thresholdRow;
+    parallel::forEachRange(0, rows, rowsPerBand(cols), [&](int start, int end) {
+        for (int r = start; r < end; r++) {
+            const uint8_t* diffs = differences.rowPtr(r);
+            int* dst = result.rowPtr(r);
+            for (int c = kernel(diffs, cols, threshold, dst); c < cols; c++) {
+                dst[c] = diffs[c] > threshold ? BLACK : WHITE;
+            }
+        }
+    });
+    return result;
+}
+
+Bitmap EdgeDifferences::toBitmap(int threshold) const {
+    int rows = differences.numRows();
+    int cols = differences.numCols();
+    Bitmap result(rows, cols);
+    if (threshold < 0 || threshold >= 255) {
+        result.fill(threshold < 0);
+        return result;
+    }
+    ThresholdBitsFunction kernel = getKernels().thresholdBits;
+    parallel::forEachRange(0, rows, rowsPerBand(cols), [&](int start, int end) {
+        for (int r = start; r < end; r++) {
+            const uint8_t* diffs = differences.rowPtr(r);
+            uint64_t* words = result.rowWords(r);
+            for (int c = kernel(diffs, cols, threshold, words); c < cols; c++) {
+                words[c / 64] |= (uint64_t) (diffs[c] > threshold) << (c % 64);
+            }
+        }
+    });
+    return result;
+}
+
+/* Returns the number of 0 bits below the lowest 1 bit of x, which is not 0. */
+static inline int countTrailingZeros(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    for (; !(x & 1); x >>= 1) {
+        n++;
+    }
+    return n;
+#endif
+}
+
+/*
+ * Returns the 64 bits of a row of wordCount words that start at bit first,
+ * with 0 for the bits past the end of the row.
+ */
+static inline uint64_t bitsFrom(const uint64_t* words, int wordCount, int first) {
+    int word = first / 64;
+    int shift = first % 64;
+    uint64_t bits = words[word] >> shift;
+    if (shift != 0 && word + 1 < wordCount) {
+        bits |= words[word + 1] << (64 - shift);
+    }
+    return bits;
+}
+
+StickerMask::StickerMask(const Grid<int>& sticker, int threshold)
+        : sticker(sticker), mask(sticker.numRows(), sticker.numCols()) {
+    // a sticker pixel is kept if 255 minus its green value exceeds the threshold
+    int limit = 255 - max(-1, min(threshold, 256));
+    int rows = sticker.numRows();
+    int cols = sticker.numCols();
+    StickerBitsFunction kernel = getKernels().stickerBits;
+    parallel::forEachRange(0, rows, rowsPerBand(cols), [&](int start, int end) {
+        for (int r = start; r < end; r++) {
+            const int* from = sticker.rowPtr(r);
+            uint64_t* words = mask.rowWords(r);
+            for (int c = kernel(from, cols, limit, words); c < cols; c++) {
+                words[c / 64] |= (uint64_t) (((from[c] >> 8) & 0xFF) < limit) << (c % 64);
+            }
+        }
+    });
+}
+
+const Grid<int>& StickerMask::getSticker() const {
+    return sticker;
+}
+
+const Bitmap& StickerMask::getMask() const {
+    return mask;
+}
+
+void StickerMask::draw(int originRow, int originCol, const OutputTile& out) const {
+    // The sticker covers one row and column less than its size (its last
+    // row and column are never drawn), and starts at row and column 0 of
+    // the sticker even where the origin is above or left of the image.
+    int stickerTop = max(0, originRow);
+    int stickerLeft = max(0, originCol);
+    int rowStart = max(out.top, stickerTop);
+    int colStart = max(out.left, stickerLeft);
+    int rowEnd = min(out.top + out.rows, originRow + sticker.numRows() - 1);
+    int colEnd = min(out.left + out.cols, originCol + sticker.numCols() - 1);
+    if (rowStart >= rowEnd || colStart >= colEnd) {
+        return;
+    }
+
+    int count = colEnd - colStart;
+    int wordCount = mask.wordsPerRow();
+    for (int r = rowStart; r < rowEnd; r++) {
+        int first = colStart - stickerLeft;
+        const int* from = sticker.rowPtr(r - stickerTop) + first;
+        const uint64_t* words = mask.rowWords(r - stickerTop);
+        int* dst = out.rowPtr(r) + (colStart - out.left);
+        for (int i = 0; i < count; i += 64) {
+            uint64_t bits = bitsFrom(words, wordCount, first + i);
+            if (count - i < 64) {
+                bits &= (1ULL << (count - i)) - 1;
+            }
+            // copy each run of 1 bits as a block
+            while (bits != 0) {
+                int runStart = countTrailingZeros(bits);
+                uint64_t rest = ~(bits >> runStart);
+                int runEnd = rest == 0 ? 64 : runStart + countTrailingZeros(rest);
+                copy(from + i + runStart, from + i + runEnd, dst + i + runStart);
+                bits = runEnd == 64 ? 0 : bits & (~0ULL << runEnd);
+            }
+        }
+    }
+}
+
+Grid<int> greenScreenImage(const Grid<int>& background, const Grid<int>& sticker,
+                           int threshold, int originRow, int originCol) {
+    return greenScreenImage(background, StickerMask(sticker, threshold), originRow, originCol);
+}
+
+Grid<int> greenScreenImage(const Grid<int>& background, const StickerMask& mask,
+                           int originRow, int originCol) {
+    Grid<int> result(background);
+    mask.draw(originRow, originCol, viewRows(result, 0, result.numRows()));
+    return result;
+}
+
+// larger blur radii use box blurs, whose cost does not depend on the radius
+static const int MAX_DIRECT_BLUR_RADIUS = 30;
+static const int BOX_BLUR_PASSES = 3;
+
+// rows filtered together before their results are written out transposed
+static const int TRANSPOSE_BLOCK = 16;
+
+/* Per-thread buffers for filtering one row. */
+struct RowScratch {
+    vector<int> padded;
+    vector<int> line;
+};
+
+/*
+ * Copies width pixels of row into padded, with pad copies of the first
+ * pixel before them and at least pad copies of the last one after, plus a
+ * few more so that vector loads can run past the end.
+ */
+static void padRow(const int* row, int width, int pad, vector<int>& padded) {
+    padded.resize(width + 2 * pad + 8);
+    fill_n(padded.begin(), pad, row[0]);
+    copy(row, row + width, padded.begin() + pad);
+    fill(padded.begin() + pad + width, padded.end(), row[width - 1]);
+}
+
+/*
+ * Applies filterRow to every row of in and returns the results transposed,
+ * so that a second call filters along the original columns while still
+ * reading memory row by row.  Rows are filtered in blocks so that each
+ * transposed write fills a run of TRANSPOSE_BLOCK consecutive pixels.
+ */
+template <typename RowFilter>
+static Grid<int> filterRowsTransposed(const Grid<int>& in, const RowFilter& filterRow) {
+    int rows = in.numRows();
+    int cols = in.numCols();
+    Grid<int> out(cols, rows);
+    int grain = (rowsPerBand(cols) + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK * TRANSPOSE_BLOCK;
+    parallel::forEachRange(0, rows, grain, [&](int start, int end) {
+        RowScratch scratch;
+        vector<int> block((size_t) TRANSPOSE_BLOCK * cols);
+        for (int blockStart = start; blockStart < end; blockStart += TRANSPOSE_BLOCK) {
+            int count = min(TRANSPOSE_BLOCK, end - blockStart);
+            for (int i = 0; i < count; i++) {
+                filterRow(in.rowPtr(blockStart + i), cols, &block[(size_t) i * cols], scratch);
+            }
+            for (int c = 0; c < cols; c++) {
+                int* dst = out.rowPtr(c) + blockStart;
+                for (int i = 0; i < count; i++) {
+                    dst[i] = block[(size_t) i * cols + c];
+                }
+            }
+        }
+    });
+    return out;
+}
+
+/*
+ * Converts a kernel to fixed-point weights that sum to exactly
+ * 1 << WEIGHT_BITS, padded with a zero weight to an even number of taps,
+ * and packs them in pairs for the blur row kernels.
+ */
+static vector<int> toWeightPairs(const Vector<double>& kernel) {
+    double total = 0;
+    for (double weight : kernel) {
+        total += weight;
+    }
+    vector<int> weights(kernel.size() + kernel.size() % 2, 0);
+    int sum = 0;
+    for (int i = 0; i < kernel.size(); i++) {
+        double scaled = kernel[i] / total * (1 << WEIGHT_BITS);
+        weights[i] = max(-32768, min(32767, (int) lround(scaled)));
+        sum += weights[i];
+    }
+    weights[kernel.size() / 2] += (1 << WEIGHT_BITS) - sum;   // absorb rounding in the center
+    vector<int> pairs(weights.size() / 2);
+    for (size_t i = 0; i < pairs.size(); i++) {
+        pairs[i] = (int) ((weights[2 * i] & 0xFFFF) | ((unsigned int) weights[2 * i + 1] << 16));
+    }
+    return pairs;
+}
+
+/* Scalar version of the blur row kernels, for one output pixel. */
+static int blurPixel(const int* taps, const int* pairs, int pairCount) {
+    unsigned int result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int sum = 1 << (WEIGHT_BITS - 1);
+        for (int i = 0; i < pairCount; i++) {
+            sum += (short) (pairs[i] & 0xFFFF) * (int) ((taps[2 * i] >> shift) & 0xFF);
+            sum += (short) (pairs[i] >> 16) * (int) ((taps[2 * i + 1] >> shift) & 0xFF);
+        }
+        result |= (unsigned int) max(0, min(255, sum >> WEIGHT_BITS)) << shift;
+    }
+    return (int) result;
+}
+
+/* Returns the variance of a kernel's weights around its center. */
+static double kernelVariance(const Vector<double>& kernel) {
+    int radius = kernel.size() / 2;
+    double total = 0;
+    double moment = 0;
+    for (int i = 0; i < kernel.size(); i++) {
+        total += kernel[i];
+        moment += kernel[i] * (i - radius) * (i - radius);
+    }
+    return moment / total;
+}
+
+/*
+ * Returns the radii of BOX_BLUR_PASSES box blurs that together have the
+ * given variance, as near as odd box widths allow.  See Kovesi, "Fast
+ * Almost-Gaussian Filtering" (2010).
+ */
+static vector<int> boxRadiiForVariance(double variance) {
+    int n = BOX_BLUR_PASSES;
+    int lower = (int) floor(sqrt(12 * variance / n + 1));
+    if (lower % 2 == 0) {
+        lower--;
+    }
+    double smaller = (12 * variance - n * lower * lower - 4 * n * lower - 3 * n) / (-4.0 * lower - 4);
+    int lowerCount = (int) lround(smaller);
+    vector<int> radii(n);
+    for (int i = 0; i < n; i++) {
+        radii[i] = (i < lowerCount ? lower - 1 : lower + 1) / 2;
+    }
+    return radii;
+}
+
+/*
+ * Filters width pixels of a row into out.  Pixels past the ends of the
+ * row are treated as copies of the end pixels.
+ */
+typedef function<void(const int* row, int width, int* out, RowScratch& scratch)> RowFilter;
+
+/*
+ * Returns the row filter that blurImage applies along rows and then along
+ * columns, and sets halo to how far from an output pixel it reads.
+ */
+static RowFilter makeBlurRowFilter(const Vector<double>& kernel, int& halo) {
+    int radius = kernel.size() / 2;
+    if (radius > MAX_DIRECT_BLUR_RADIUS) {
+        vector<int> radii = boxRadiiForVariance(kernelVariance(kernel));
+        BoxRowFunction boxRow = getKernels().boxRow;
+        halo = 0;
+        for (int boxRadius : radii) {
+            halo += boxRadius;
+        }
+        return [radii, boxRow](const int* row, int width, int* out, RowScratch& scratch) {
+            scratch.line.resize(width);
+            const int* in = row;
+            for (size_t i = 0; i < radii.size(); i++) {
+                padRow(in, width, radii[i], scratch.padded);
+                int* dst = i + 1 == radii.size() ? out : scratch.line.data();
+                boxRow(scratch.padded.data(), width, radii[i], dst);
+                in = dst;
+            }
+        };
+    }
+
+    vector<int> pairs = toWeightPairs(kernel);
+    BlurRowFunction blurRow = getKernels().blurRow;
+    halo = radius;
+    return [pairs, blurRow, radius](const int* row, int width, int* out, RowScratch& scratch) {
+        int pairCount = (int) pairs.size();
+        padRow(row, width, radius, scratch.padded);
+        const int* padded = scratch.padded.data();
+        for (int x = blurRow(padded, width, pairs.data(), pairCount, out); x < width; x++) {
+            out[x] = blurPixel(padded + x, pairs.data(), pairCount);
+        }
+    };
+}
+
+Grid<int> blurImage(const Grid<int>& original, const Vector<double>& kernel) {
+    if (original.isEmpty() || kernel.size() / 2 < 1) {
+        return original;
+    }
+    int halo;
+    RowFilter blur = makeBlurRowFilter(kernel, halo);
+    return filterRowsTransposed(filterRowsTransposed(original, blur), blur);
+}
+
+/*
+ * Applies a row filter along the rows and then the columns of in, keeping
+ * the part that falls inside out.  Rows are filtered across all of in,
+ * so results near in's edges are off wherever those are not the image's
+ * edges, but out lies far enough inside in that none of those are kept.
+ */
+static void filterTileSeparable(const RowFilter& filter, const InputTile& in, const OutputTile& out) {
+    static thread_local RowScratch scratch;
+    static thread_local vector<int> line;
+    static thread_local vector<int> transposed;
+    line.resize(max(in.rows, in.cols));
+    transposed.resize((size_t) out.cols * in.rows);
+    int colOffset = out.left - in.left;
+    for (int i = 0; i < in.rows; i++) {
+        filter(in.rowPtr(in.top + i), in.cols, line.data(), scratch);
+        for (int j = 0; j < out.cols; j++) {
+            transposed[(size_t) j * in.rows + i] = line[colOffset + j];
+        }
+    }
+    int rowOffset = out.top - in.top;
+    for (int j = 0; j < out.cols; j++) {
+        filter(&transposed[(size_t) j * in.rows], in.rows, line.data(), scratch);
+        for (int i = 0; i < out.rows; i++) {
+            out.rowPtr(out.top + i)[j] = line[rowOffset + i];
+        }
+    }
+}
+
+/* Copies the part of in that falls inside out. */
+static void copyTile(const InputTile& in, const OutputTile& out) {
+    for (int r = out.top; r < out.top + out.rows; r++) {
+        const int* from = in.rowPtr(r) + (out.left - in.left);
+        copy(from, from + out.cols, out.rowPtr(r));
+    }
+}
+
+FilterStage scatterStage(int radius, unsigned long long seed) {
+    FilterStage stage;
+    stage.name = "scatter";
+    stage.radius = max(0, radius);
+    stage.apply = [radius, seed](const InputTile& in, const OutputTile& out) {
+        scatterTile(in, out, radius, seed);
+    };
+    return stage;
+}
+
+FilterStage edgeDetectStage(int threshold) {
+    FilterStage stage;
+    stage.name = "edge detection";
+    stage.radius = 1;
+    stage.apply = [threshold](const InputTile& in, const OutputTile& out) {
+        edgeDetectTile(in, out, threshold);
+    };
+    return stage;
+}
+
+FilterStage greenScreenStage(const Grid<int>& sticker, int threshold,
+                             int originRow, int originCol) {
+    return greenScreenStage(StickerMask(sticker, threshold), originRow, originCol);
+}
+
+FilterStage greenScreenStage(const StickerMask& mask, int originRow, int originCol) {
+    FilterStage stage;
+    stage.name = "green screen";
+    stage.radius = 0;
+    // keyed once here, not again for each tile
+    shared_ptr<const StickerMask> copied = make_shared<StickerMask>(mask);
+    stage.apply = [copied, originRow, originCol](const InputTile& in, const OutputTile& out) {
+        copyTile(in, out);
+        copied->draw(originRow, originCol, out);
+    };
+    return stage;
+}
+
+FilterStage blurStage(const Vector<double>& kernel) {
+    FilterStage stage;
+    stage.name = "blur";
+    if (kernel.size() / 2 < 1) {
+        stage.radius = 0;
+        stage.apply = copyTile;
+        return stage;
+    }
+    RowFilter blur = makeBlurRowFilter(kernel, stage.radius);
+    stage.apply = [blur](const InputTile& in, const OutputTile& out) {
+        filterTileSeparable(blur, in, out);
+    };
+    return stage;
+}
+
+static const double PI = 3.14159265;
+
+/* 
+ * Takes a radius and computes a 1-dimensional Gaussian blur kernel
+ * with that radius. The 1-dimensional kernel can be applied to a
+ * 2-dimensional image in two separate passes: first pass goes over
+ * each row and does the horizontal convolutions, second pass goes
+ * over each column and does the vertical convolutions. This is more
+ * efficient than creating a 2-dimensional kernel and applying it in
+ * one convolution pass.
+ *
+ * This code is based on the C# code posted by Stack Overflow user
+ * "Cecil has a name" at this link:
+ * http://stackoverflow.com/questions/1696113/how-do-i-gaussian-blur-an-image-without-using-any-in-built-gaussian-functions
+ *
+ */
+Vector<double> gaussKernelForRadius(int radius) {
+    if (radius < 1) {
+        Vector<double> empty;
+        return empty;
+    }
+    Vector<double> kernel(radius * 2 + 1);
+    double magic1 = 1.0 / (2.0 * radius * radius);
+    double magic2 = 1.0 / (sqrt(2.0 * PI) * radius);
+    int r = -radius;
+    double div = 0.0;
+    for (int i = 0; i < kernel.size(); i++) {
+        double x = r * r;
+        kernel[i] = magic2 * exp(-x * magic1);
+        r++;
+        div += kernel[i];
+    }
+    for (int i = 0; i < kernel.size(); i++) {
+        kernel[i] /= div;
+    }
+    return kernel;
+}
@@ -0,0 +1,162 @@
+/*
+ * File: filters.h
+ * ---------------
+ * Image filter kernels used by Fauxtoshop.  These functions only compute;
+ * prompting the user for parameters is left to fauxtoshop.cpp.
+ *
+ * Kernels that work on whole images split them into bands of rows that are
+ * processed in parallel (see parallel.h).  Scatter and edge detection have
+ * a ...Rows form that fills in just the rows [rowStart, rowEnd) of a
+ * result grid that is already the size of the input, for callers that
+ * manage bands themselves.  Every filter also has a ...Stage form that
+ * does the same work one tile at a time as part of a FilterPipeline (see
+ * pipeline.h); a pipeline gives exactly the same result as applying its
+ * filters one after another.
+ */
+
+#ifndef _filters_h
+#define _filters_h
+
+#include <cstdint>
+#include "bitmap.h"
+#include "grid.h"
+#include "pipeline.h"
+#include "vector.h"
+
+/*
+ * Scatter: each result pixel is copied from a randomly chosen source pixel
+ * at most radius rows and radius columns away, clipped to the image.
+ * The choice for each pixel depends only on the seed and the pixel's
+ * position, so a given seed always gives the same image, whichever rows
+ * are computed together and however many threads are used.
+ */
+Grid<int> scatterImage(const Grid<int>& original, int radius, unsigned long long seed);
+void scatterRows(const Grid<int>& original, Grid<int>& result, int radius,
+                 unsigned long long seed, int rowStart, int rowEnd);
+FilterStage scatterStage(int radius, unsigned long long seed);
+
+/*
+ * Edge detection: a result pixel is BLACK (0x000000) if its red, green, or
+ * blue value differs by more than threshold from that of any of its up to
+ * 8 neighbors, and WHITE (0xFFFFFF) otherwise.  Interior rows are compared
+ * 8 or 16 pixels at a time with SSE2 or AVX2, whichever the CPU supports.
+ * edgeDetectBitmap gives the same result as a Bitmap, whose 1 bits are the
+ * BLACK pixels, using 1/32 of the memory.
+ */
+Grid<int> edgeDetectImage(const Grid<int>& original, int threshold);
+Bitmap edgeDetectBitmap(const Grid<int>& original, int threshold);
+void edgeDetectRows(const Grid<int>& original, Grid<int>& result, int threshold,
+                    int rowStart, int rowEnd);
+FilterStage edgeDetectStage(int threshold);
+
+/*
+ * Edge detection in two steps, for trying many thresholds on one image.
+ * The constructor finds each pixel's largest red, green, or blue
+ * difference from its neighbors, the value edge detection compares with
+ * the threshold, and a histogram of those differences.  After that, the
+ * result for any threshold takes one compare per pixel, 16 or 32 pixels
+ * at a time with SSE2 or AVX2, and the number of edge pixels it has is
+ * read from the histogram without looking at the image at all.
+ */
+class EdgeDifferences {
+public:
+    explicit EdgeDifferences(const Grid<int>& original);
+
+    /*
+     * Returns each pixel's largest difference from its neighbors, 0-255.
+     */
+    const Grid<uint8_t>& getDifferences() const;
+
+    /*
+     * Returns the histogram of the differences: element d is the number of
+     * pixels whose largest difference is d, for d from 0 to 255.
+     */
+    const Vector<long long>& getHistogram() const;
+
+    /*
+     * Returns the number of pixels that are edges (BLACK) at the given
+     * threshold, those whose difference is greater than it.
+     */
+    long long countEdges(int threshold) const;
+
+    /*
+     * Return the same result as edgeDetectImage and edgeDetectBitmap would
+     * for the original image and the given threshold.
+     */
+    Grid<int> toImage(int threshold) const;
+    Bitmap toBitmap(int threshold) const;
+
+private:
+    Grid<uint8_t> differences;
+    Vector<long long> histogram;
+};
+
+/*
+ * A sticker keyed for green screen at one threshold.  The constructor
+ * tests every sticker pixel once, 4 or 8 at a time with SSE2 or AVX2, and
+ * keeps the result as a Bitmap whose 1 bits are the pixels that are drawn.
+ * Drawing is then a masked copy of the sticker's rectangle alone: runs of
+ * kept pixels are copied whole and green ones skipped a word (64 pixels)
+ * at a time, so placing the same sticker again and again, as when it
+ * follows the mouse, costs nothing per placement for the rest of the image.
+ */
+class StickerMask {
+public:
+    StickerMask(const Grid<int>& sticker, int threshold);
+
+    /*
+     * Returns the sticker and the bitmap of its pixels that are drawn.
+     */
+    const Grid<int>& getSticker() const;
+    const Bitmap& getMask() const;
+
+    /*
+     * Draws the part of the sticker that falls inside out over the pixels
+     * out already holds, its top-left corner at originRow/originCol, as
+     * greenScreenImage describes.
+     */
+    void draw(int originRow, int originCol, const OutputTile& out) const;
+
+private:
+    Grid<int> sticker;
+    Bitmap mask;
+};
+
+/*
+ * Green screen: returns a copy of background with sticker drawn over it,
+ * its top-left corner at originRow/originCol, leaving out every sticker
+ * pixel whose green value is within threshold of 255.  The last row and
+ * column of the sticker are not drawn.  Only the part of the image under
+ * the sticker is visited after the copy, so the cost beyond copying
+ * grows with the sticker's size rather than the background's.  The forms
+ * that take a StickerMask reuse its work for a sticker and threshold
+ * that have already been keyed.
+ */
+Grid<int> greenScreenImage(const Grid<int>& background, const Grid<int>& sticker,
+                           int threshold, int originRow, int originCol);
+Grid<int> greenScreenImage(const Grid<int>& background, const StickerMask& mask,
+                           int originRow, int originCol);
+FilterStage greenScreenStage(const Grid<int>& sticker, int threshold,
+                             int originRow, int originCol);
+FilterStage greenScreenStage(const StickerMask& mask, int originRow, int originCol);
+
+/*
+ * Blur: convolves the image with the given 1-D kernel of 2 * radius + 1
+ * weights along its rows and then along its columns, treating pixels past
+ * the edges as copies of the edge pixels.  The weights are scaled to sum
+ * to 1 and rounded to 14-bit fixed point.  Each pass writes its result
+ * transposed, so both passes read the image row by row.
+ * For a radius above 30, three box blurs with the same overall variance as
+ * the kernel are used instead, whose cost does not depend on the radius.
+ */
+Grid<int> blurImage(const Grid<int>& original, const Vector<double>& kernel);
+FilterStage blurStage(const Vector<double>& kernel);
+
+/*
+ * Returns the 2 * radius + 1 weights of a Gaussian blur kernel with
+ * standard deviation radius, summing to 1, or an empty kernel if radius
+ * is less than 1.
+ */
+Vector<double> gaussKernelForRadius(int radius);
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * File: pipeline.cpp
+ * ------------------
+ * Implements the FilterPipeline class declared in pipeline.h.
+ */
+
+#include "pipeline.h"
+#include <algorithm>
+#include "error.h"
+#include "parallel.h"
+
+using namespace std;
+
+// a rectangle of the image, in image coordinates
+struct Rect {
+    int top;
+    int left;
+    int rows;
+    int cols;
+};
+
+/* Returns rect grown by radius on every side, clipped to the image. */
+static Rect grow(const Rect& rect, int radius, int imageRows, int imageCols) {
+    Rect grown;
+    grown.top = max(0, rect.top - radius);
+    grown.left = max(0, rect.left - radius);
+    grown.rows = min(imageRows, rect.top + rect.rows + radius) - grown.top;
+    grown.cols = min(imageCols, rect.left + rect.cols + radius) - grown.left;
+    return grown;
+}
+
+/* Returns a view of the given rectangle of storage that starts at its top-left corner. */
+template <typename PixelType>
+static TileView<PixelType> makeView(const Rect& rect, int imageRows, int imageCols,
+                                    PixelType* pixels, int stride) {
+    TileView<PixelType> view;
+    view.top = rect.top;
+    view.left = rect.left;
+    view.rows = rect.rows;
+    view.cols = rect.cols;
+    view.imageRows = imageRows;
+    view.imageCols = imageCols;
+    view.pixels = pixels;
+    view.stride = stride;
+    return view;
+}
+
+InputTile viewRows(const Grid<int>& grid, int rowStart, int rowEnd) {
+    Rect rect = { rowStart, 0, rowEnd - rowStart, grid.numCols() };
+    return makeView(rect, grid.numRows(), grid.numCols(),
+                    grid.data() + (size_t) rowStart * grid.numCols(), grid.numCols());
+}
+
+OutputTile viewRows(Grid<int>& grid, int rowStart, int rowEnd) {
+    Rect rect = { rowStart, 0, rowEnd - rowStart, grid.numCols() };
+    return makeView(rect, grid.numRows(), grid.numCols(),
+                    grid.data() + (size_t) rowStart * grid.numCols(), grid.numCols());
+}
+
+FilterPipeline::FilterPipeline()
+        : tileSize(128) {
+    /* Empty */
+}
+
+void FilterPipeline::addStage(const FilterStage& stage) {
+    if (stage.radius < 0) {
+        error("FilterPipeline::addStage: radius of stage \"" + stage.name + "\" is negative");
+    }
+    stages.push_back(stage);
+}
+
+int FilterPipeline::size() const {
+    return (int) stages.size();
+}
+
+int FilterPipeline::getHalo() const {
+    int halo = 0;
+    for (const FilterStage& stage : stages) {
+        halo += stage.radius;
+    }
+    return halo;
+}
+
+void FilterPipeline::setTileSize(int tileSize) {
+    if (tileSize < 1) {
+        error("FilterPipeline::setTileSize: tile size must be positive");
+    }
+    this->tileSize = tileSize;
+}
+
+Grid<int> FilterPipeline::run(const Grid<int>& image) const {
+    if (stages.empty() || image.isEmpty()) {
+        return image;
+    }
+    Grid<int> result(image.numRows(), image.numCols());
+    runRows(viewRows(image, 0, image.numRows()), viewRows(result, 0, result.numRows()));
+    return result;
+}
+
+bool FilterPipeline::runStreaming(imagecodec::RowReader& reader,
+                                  imagecodec::RowWriter& writer) const {
+    int rows = reader.getHeight();
+    int cols = reader.getWidth();
+    int halo = getHalo();
+    int bandRows = tileSize * parallel::getThreadCount();
+
+    // window holds rows [windowTop, windowTop + windowRows) of the image
+    vector<int> window;
+    int windowTop = 0;
+    int windowRows = 0;
+    vector<int> band;
+    for (int bandTop = 0; bandTop < rows; bandTop += bandRows) {
+        int bandEnd = min(rows, bandTop + bandRows);
+        int neededTop = max(0, bandTop - halo);
+        int neededEnd = min(rows, bandEnd + halo);
+
+        // drop the rows above the halo, then read up to the bottom of it
+        int dropped = neededTop - windowTop;
+        window.erase(window.begin(), window.begin() + (size_t) dropped * cols);
+        windowTop = neededTop;
+        windowRows -= dropped;
+        int added = neededEnd - (windowTop + windowRows);
+        window.resize((size_t) (windowRows + added) * cols);
+        if (!reader.readRows(window.data() + (size_t) windowRows * cols, added)) {
+            return false;
+        }
+        windowRows += added;
+
+        Rect windowRect = { windowTop, 0, windowRows, cols };
+        Rect bandRect = { bandTop, 0, bandEnd - bandTop, cols };
+        band.resize((size_t) bandRect.rows * cols);
+        runRows(makeView(windowRect, rows, cols, (const int*) window.data(), cols),
+                makeView(bandRect, rows, cols, band.data(), cols));
+        if (!writer.writeRows(band.data(), bandRect.rows)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Runs the stages to produce every pixel of dest, whose rows span the
+ * image.  source must hold the same rows grown by the halo, clipped to
+ * the image.
+ */
+void FilterPipeline::runRows(const InputTile& source, const OutputTile& dest) const {
+    int rows = dest.imageRows;
+    int cols = dest.imageCols;
+    if (stages.empty()) {
+        for (int row = dest.top; row < dest.top + dest.rows; row++) {
+            copy(source.rowPtr(row), source.rowPtr(row) + cols, dest.rowPtr(row));
+        }
+        return;
+    }
+    int stageCount = (int) stages.size();
+    int tilesAcross = (cols + tileSize - 1) / tileSize;
+    int tilesDown = (dest.rows + tileSize - 1) / tileSize;
+    parallel::forEachRange(0, tilesAcross * tilesDown, 1, [&](int start, int end) {
+        // rects[k] is the input of stage k and the output of stage k - 1
+        vector<Rect> rects(stageCount + 1);
+        vector<int> buffers[2];
+        for (int tile = start; tile < end; tile++) {
+            Rect& last = rects[stageCount];
+            last.top = dest.top + tile / tilesAcross * tileSize;
+            last.left = tile % tilesAcross * tileSize;
+            last.rows = min(tileSize, dest.top + dest.rows - last.top);
+            last.cols = min(tileSize, cols - last.left);
+            for (int k = stageCount - 1; k >= 0; k--) {
+                rects[k] = grow(rects[k + 1], stages[k].radius, rows, cols);
+            }
+
+            InputTile in = makeView(rects[0], rows, cols,
+                                    source.rowPtr(rects[0].top) + rects[0].left, source.stride);
+            for (int k = 0; k < stageCount; k++) {
+                const Rect& rect = rects[k + 1];
+                OutputTile out;
+                if (k == stageCount - 1) {
+                    out = makeView(rect, rows, cols, dest.rowPtr(rect.top) + rect.left, dest.stride);
+                } else {
+                    vector<int>& buffer = buffers[k % 2];
+                    buffer.resize((size_t) rect.rows * rect.cols);
+                    out = makeView(rect, rows, cols, buffer.data(), rect.cols);
+                }
+                stages[k].apply(in, out);
+                in = makeView(rect, rows, cols, (const int*) out.pixels, out.stride);
+            }
+        }
+    });
+}
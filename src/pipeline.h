@@ -0,0 +1,129 @@
+/*
+ * File: pipeline.h
+ * ----------------
+ * A filter pipeline runs a chain of filters over an image one tile at a
+ * time, instead of running each filter over the whole image and keeping
+ * every intermediate image in memory.
+ *
+ * Each stage declares its radius: how far from an output pixel it may
+ * read its input.  To produce a tile, the pipeline works backwards to find
+ * the rectangle each stage must produce, which is the next stage's
+ * rectangle grown by that stage's radius and clipped to the image, and
+ * then runs the stages forward through two small scratch buffers.  The
+ * first stage reads straight from the source image and the last writes
+ * straight into the result, so no full-size intermediate image is made.
+ * Tiles are processed in parallel (see parallel.h).
+ *
+ * runStreaming does the same for an image that is never held in memory
+ * whole: it reads a band of rows at a time from a decoder, keeping only
+ * the halo of rows around the band that the stages need, and writes each
+ * band of results straight to an encoder.
+ */
+
+#ifndef _pipeline_h
+#define _pipeline_h
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "grid.h"
+#include "imagecodec.h"
+
+/*
+ * A rectangle of pixels within an image, stored row by row.  top, left,
+ * rows, and cols give its position and size in image coordinates; pixel
+ * (row, col) of the image is at rowPtr(row)[col - left].  The size of the
+ * whole image is included so that stages can tell where its edges are.
+ */
+template <typename PixelType>
+struct TileView {
+    int top;
+    int left;
+    int rows;
+    int cols;
+    int imageRows;
+    int imageCols;
+    PixelType* pixels;
+    int stride;
+
+    PixelType* rowPtr(int row) const {
+        return pixels + (size_t) (row - top) * stride;
+    }
+};
+
+typedef TileView<const int> InputTile;
+typedef TileView<int> OutputTile;
+
+/*
+ * Returns a view of rows [rowStart, rowEnd) of grid, across its whole
+ * width.  This lets code written for tiles also run on whole images.
+ */
+InputTile viewRows(const Grid<int>& grid, int rowStart, int rowEnd);
+OutputTile viewRows(Grid<int>& grid, int rowStart, int rowEnd);
+
+/*
+ * One step of a pipeline.  apply must set every pixel of out, reading
+ * only pixels of in, which covers out grown by radius on every side,
+ * clipped to the image.  Stages run concurrently on different tiles, so
+ * apply must not modify shared state.
+ */
+struct FilterStage {
+    std::string name;
+    int radius;
+    std::function<void(const InputTile& in, const OutputTile& out)> apply;
+};
+
+class FilterPipeline {
+public:
+    /*
+     * Creates an empty pipeline, which returns images unchanged.
+     */
+    FilterPipeline();
+
+    /*
+     * Appends a stage to the end of the pipeline.
+     */
+    void addStage(const FilterStage& stage);
+
+    /*
+     * Returns the number of stages.
+     */
+    int size() const;
+
+    /*
+     * Returns the sum of the stages' radii: how far from an output pixel
+     * the pipeline as a whole may read.
+     */
+    int getHalo() const;
+
+    /*
+     * Sets the width and height of the output tiles, 128 by default.
+     * Each thread's scratch buffers hold two tiles grown by the halo.
+     */
+    void setTileSize(int tileSize);
+
+    /*
+     * Runs every stage over the given image and returns the result, which
+     * is the same as running the stages one after another over the whole
+     * image.
+     */
+    Grid<int> run(const Grid<int>& image) const;
+
+    /*
+     * Runs every stage over the image read by reader and writes the result
+     * to writer, which must have been opened with the reader's size.  The
+     * result is the same as run would give, but only a band of rows, a
+     * tile high for each thread, and the halo above and below it are in
+     * memory at once.  Returns false if reading or writing fails; the
+     * caller should still close writer.
+     */
+    bool runStreaming(imagecodec::RowReader& reader, imagecodec::RowWriter& writer) const;
+
+private:
+    std::vector<FilterStage> stages;
+    int tileSize;
+
+    void runRows(const InputTile& source, const OutputTile& dest) const;
+};
+
+#endif